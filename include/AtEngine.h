@@ -0,0 +1,96 @@
+/*
+ * AtEngine - non-blocking AT command scheduler for the SIM7600 UART
+ *
+ * Commands are queued with an expected response prefix, a timeout and a
+ * completion callback. poll() moves bytes from the UART into a fixed line
+ * buffer, matches complete lines against the command in flight and fires
+ * the callback on OK / ERROR / timeout. Nothing sleeps and nothing
+ * allocates.
+ *
+ * The UART is shared with TinyGSM, which runs its own blocking
+ * send/waitResponse exchanges. Both live on the uplink task, so they simply
+ * take turns: the owner must not enter TinyGSM (app.loop(), client
+ * traffic) while busy() is true. Lines that arrive while no command is in
+ * flight are handed to the URC handler, if one is set.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#define AT_QUEUE_DEPTH 8      // Commands waiting to be sent
+#define AT_COMMAND_MAX 64     // Longest command, without CR/LF
+#define AT_PREFIX_MAX 16      // Longest expected response prefix
+#define AT_LINE_MAX 128       // Longest response line kept; longer lines are truncated
+
+enum class AtResult : uint8_t {
+  Ok,
+  Error,
+  Timeout
+};
+
+// `payload` is the last line that matched the expected prefix ("" if none)
+typedef void (*AtCallback)(AtResult result, const char* payload, void* ctx);
+typedef void (*AtUrcHandler)(const char* line);
+// Command written -> final result line (or timeout), for latency profiling
+typedef void (*AtTimingHook)(AtResult result, uint32_t roundTripUs);
+
+class AtEngine {
+ public:
+  explicit AtEngine(Stream& stream);
+
+  // Queue a command; returns false if the queue is full or the text too long
+  bool submit(const char* command, const char* responsePrefix, uint32_t timeoutMs,
+              AtCallback callback, void* ctx = nullptr);
+
+  // Drive RX parsing, timeouts and the next transmit. Call often.
+  void poll();
+
+  // Submit and poll until complete - for boot-time sequences only
+  AtResult run(const char* command, const char* responsePrefix, uint32_t timeoutMs,
+               char* payloadOut = nullptr, size_t payloadSize = 0);
+
+  bool busy() const { return inFlight_; }
+  bool idle() const { return !inFlight_ && count_ == 0; }
+  size_t pending() const { return count_; }
+
+  void setUrcHandler(AtUrcHandler handler) { urcHandler_ = handler; }
+  void setTimingHook(AtTimingHook hook) { timingHook_ = hook; }
+
+  uint32_t completed() const { return completed_; }
+  uint32_t timeouts() const { return timeouts_; }
+  uint32_t overflows() const { return overflows_; }
+
+ private:
+  struct Command {
+    char text[AT_COMMAND_MAX];
+    char prefix[AT_PREFIX_MAX];
+    uint32_t timeoutMs;
+    AtCallback callback;
+    void* ctx;
+  };
+
+  void sendNext();
+  void handleLine(const char* line);
+  void finish(AtResult result);
+
+  Stream& stream_;
+  Command queue_[AT_QUEUE_DEPTH];
+  uint8_t head_;
+  uint8_t count_;
+
+  bool inFlight_;
+  uint32_t sentAt_;
+  uint32_t sentAtUs_;
+  char payload_[AT_LINE_MAX];
+
+  char rxLine_[AT_LINE_MAX];
+  size_t rxLen_;
+  bool rxTruncated_;
+
+  AtUrcHandler urcHandler_;
+  AtTimingHook timingHook_;
+  uint32_t completed_;
+  uint32_t timeouts_;
+  uint32_t overflows_;
+};
@@ -0,0 +1,43 @@
+/*
+ * CivilTime - proleptic Gregorian date <-> day number, integer only
+ *
+ * Day numbers count days since 1970-01-01, so `dayNumber * 86400 +
+ * secondsOfDay` is a Unix timestamp. Based on the days_from_civil /
+ * civil_from_days algorithms (valid far beyond any date this firmware sees).
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define SECONDS_PER_DAY 86400UL
+
+struct CivilDate {
+  uint16_t year;
+  uint8_t month;  // 1..12
+  uint8_t day;    // 1..31
+};
+
+static inline int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day) {
+  year -= month <= 2;
+  const int32_t era = (year >= 0 ? year : year - 399) / 400;
+  const uint32_t yearOfEra = (uint32_t)(year - era * 400);
+  const uint32_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + (int32_t)dayOfEra - 719468;
+}
+
+static inline CivilDate civilFromDays(int32_t days) {
+  days += 719468;
+  const int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+  const uint32_t dayOfEra = (uint32_t)(days - era * 146097);
+  const uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  const uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  const uint32_t mp = (5 * dayOfYear + 2) / 153;
+
+  CivilDate date;
+  date.day = (uint8_t)(dayOfYear - (153 * mp + 2) / 5 + 1);
+  date.month = (uint8_t)(mp < 10 ? mp + 3 : mp - 9);
+  date.year = (uint16_t)((int32_t)yearOfEra + era * 400 + (date.month <= 2));
+  return date;
+}
@@ -0,0 +1,81 @@
+/*
+ * CountingClient - transparent Client wrapper that counts bytes on the wire
+ *
+ * Sits between ESP_SSLClient and the modem socket, so the counters see
+ * exactly what crosses the cellular link: TLS handshakes, record headers,
+ * HTTP framing and payload. Everything else is forwarded unchanged.
+ * connects() counts TCP connections opened, i.e. TLS handshakes attempted.
+ * lastConnectUs() is how long the most recent connect() blocked - the TCP
+ * open below the TLS client, or TCP plus handshake when wrapped around it.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+
+class CountingClient : public Client {
+ public:
+  explicit CountingClient(Client& inner)
+      : inner_(inner), sent_(0), received_(0), connects_(0), lastConnectUs_(0) {}
+
+  int connect(IPAddress ip, uint16_t port) override {
+    uint32_t start = micros();
+    int result = inner_.connect(ip, port);
+    lastConnectUs_ = micros() - start;
+    connects_++;
+    return result;
+  }
+
+  int connect(const char* host, uint16_t port) override {
+    uint32_t start = micros();
+    int result = inner_.connect(host, port);
+    lastConnectUs_ = micros() - start;
+    connects_++;
+    return result;
+  }
+
+  size_t write(uint8_t b) override {
+    size_t n = inner_.write(b);
+    sent_ += n;
+    return n;
+  }
+
+  size_t write(const uint8_t* buf, size_t size) override {
+    size_t n = inner_.write(buf, size);
+    sent_ += n;
+    return n;
+  }
+
+  int available() override { return inner_.available(); }
+
+  int read() override {
+    int c = inner_.read();
+    if (c >= 0) received_++;
+    return c;
+  }
+
+  int read(uint8_t* buf, size_t size) override {
+    int n = inner_.read(buf, size);
+    if (n > 0) received_ += n;
+    return n;
+  }
+
+  int peek() override { return inner_.peek(); }
+  void flush() override { inner_.flush(); }
+  void stop() override { inner_.stop(); }
+  uint8_t connected() override { return inner_.connected(); }
+  operator bool() override { return (bool)inner_; }
+
+  uint32_t bytesSent() const { return sent_; }
+  uint32_t bytesReceived() const { return received_; }
+  uint32_t connects() const { return connects_; }
+  uint32_t lastConnectUs() const { return lastConnectUs_; }
+
+ private:
+  Client& inner_;
+  uint32_t sent_;
+  uint32_t received_;
+  uint32_t connects_;
+  uint32_t lastConnectUs_;
+};
@@ -0,0 +1,49 @@
+/*
+ * CountingStream - transparent Stream wrapper that counts bytes on the modem UART
+ *
+ * Wraps SerialAT for everything that talks to the SIM7600 (TinyGSM, the AT
+ * engine, the modem TLS client), so the counters include AT framing,
+ * socket commands and, on the ESP32 TLS path, the ciphertext itself.
+ * Bytes exchanged on the raw serial port before the wrapper is in use
+ * (reset, boot banner) are not counted.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+class CountingStream : public Stream {
+ public:
+  explicit CountingStream(Stream& inner) : inner_(inner), sent_(0), received_(0) {}
+
+  size_t write(uint8_t b) override {
+    size_t n = inner_.write(b);
+    sent_ += n;
+    return n;
+  }
+
+  size_t write(const uint8_t* buf, size_t size) override {
+    size_t n = inner_.write(buf, size);
+    sent_ += n;
+    return n;
+  }
+
+  int available() override { return inner_.available(); }
+
+  int read() override {
+    int c = inner_.read();
+    if (c >= 0) received_++;
+    return c;
+  }
+
+  int peek() override { return inner_.peek(); }
+  void flush() override { inner_.flush(); }
+
+  uint32_t bytesSent() const { return sent_; }
+  uint32_t bytesReceived() const { return received_; }
+
+ private:
+  Stream& inner_;
+  uint32_t sent_;
+  uint32_t received_;
+};
@@ -0,0 +1,139 @@
+/*
+ * CycleAggregator - per-scan and per-cycle audience counters over salted hashes
+ *
+ * The deduplication and counting core of the aggregation task, free of
+ * FreeRTOS, WiFi and the clock so the same code runs on the board and in
+ * the native replay benchmark:
+ *
+ *   sighting()   dedup against this and the previous cycle (HashGenerations),
+ *                RSSI histogram, proximity band, visit engine
+ *   scanEnded()  fold the scan into the cycle; true once scansPerCycle
+ *                scans are in
+ *   takeReport() snapshot the cycle as a CycleReport and start the next one
+ *
+ * A sighting is unique the first time its hash shows up within a cycle,
+ * and new (totalUnique) if the previous cycle did not have it either. A
+ * sighting a full dedup table cannot place is unknown: it only counts as
+ * an overflow, since calling it unique would count a repeat again on
+ * every scan. Times are monotonic seconds supplied by the caller. Single
+ * owner, no locking, no heap.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "HashSet64.h"
+#include "Pipeline.h"
+#include "ScanRecord.h"
+#include "VisitTracker.h"
+
+// One finished scan, as archived and logged
+struct ScanTotals {
+  uint32_t scanIndex;  // Scans since boot, 1-based
+  int16_t found;       // Detections, negative = scan error code
+  uint32_t unique;     // First sightings in the current cycle
+  uint32_t repeated;
+  uint8_t rssiHistogram[SCAN_RSSI_BINS];
+};
+
+template <size_t DedupCapacity, size_t VisitCapacity>
+class CycleAggregator {
+ public:
+  CycleAggregator(uint32_t scansPerCycle, uint32_t gapSeconds, uint32_t lingerSeconds, uint32_t windowSeconds)
+      : visits_(gapSeconds, lingerSeconds, windowSeconds), scansPerCycle_(scansPerCycle) {
+    clear();
+  }
+
+  void clear() {
+    dedup_.current().clear();
+    dedup_.rotate();
+    visits_.clear();
+    memset(&scan_, 0, sizeof(scan_));
+    memset(&cycle_, 0, sizeof(cycle_));
+    scansInCycle_ = 0;
+    totalUnique_ = 0;
+    totalScans_ = 0;
+    dedupOverflows_ = 0;
+  }
+
+  // Returns true on the first sighting of `hash` within the current cycle,
+  // false for a repeat or an overflow
+  bool sighting(uint64_t hash, int8_t rssi, uint8_t band, uint32_t nowS) {
+    scanRssiCount(scan_.rssiHistogram, rssi);
+    if (band < PROXIMITY_BANDS) cycle_.proximity[band]++;
+    visits_.record(hash, nowS);
+
+    HashInsert result = dedup_.current().insert(hash);
+    if (result == HashInsert::Present) {
+      scan_.repeated++;
+      return false;
+    }
+    if (result == HashInsert::Full) {
+      dedupOverflows_++;
+      return false;
+    }
+    if (!dedup_.previous().contains(hash)) {
+      totalUnique_++;
+    }
+    scan_.unique++;
+    return true;
+  }
+
+  // Close the scan: `scan` receives its totals, the per-scan counters
+  // restart. Returns true when the cycle is complete (call takeReport()).
+  bool scanEnded(int16_t found, uint32_t nowS, ScanTotals& scan) {
+    totalScans_++;
+    if (found > 0) {
+      cycle_.impressions += found;
+      cycle_.networks += found;
+      cycle_.unique += scan_.unique;
+      cycle_.repeated += scan_.repeated;
+    }
+    visits_.expire(nowS);
+
+    scan_.scanIndex = totalScans_;
+    scan_.found = found;
+    scan = scan_;
+    memset(&scan_, 0, sizeof(scan_));
+    return ++scansInCycle_ >= scansPerCycle_;
+  }
+
+  // Snapshot of the cycle so far; resets the cycle counters and swaps the
+  // dedup generations (no copy). scanErrors is the caller's to fill in.
+  void takeReport(CycleReport& out) {
+    out = cycle_;
+    out.cyclesMerged = 1;
+    visits_.takeStats(out.visits);
+    out.visitorsPresent = visits_.active();
+    out.totalUnique = totalUnique_;
+    out.totalScans = totalScans_;
+    out.scanErrors = 0;
+    out.dedupOverflows = dedupOverflows_;
+
+    dedup_.rotate();
+    memset(&cycle_, 0, sizeof(cycle_));
+    scansInCycle_ = 0;
+  }
+
+  // Takes effect for the running cycle: one already past the new length
+  // completes with its next scan
+  void setScansPerCycle(uint32_t scansPerCycle) { scansPerCycle_ = scansPerCycle; }
+
+  uint32_t totalScans() const { return totalScans_; }
+  uint32_t dedupOverflows() const { return dedupOverflows_; }
+  size_t visitorsTracked() const { return visits_.tracked(); }
+
+ private:
+  HashGenerations<DedupCapacity> dedup_;
+  VisitTracker<VisitCapacity> visits_;
+  ScanTotals scan_;
+  CycleReport cycle_;
+  uint32_t scansPerCycle_;
+  uint32_t scansInCycle_;
+  uint32_t totalUnique_;
+  uint32_t totalScans_;
+  uint32_t dedupOverflows_;
+};
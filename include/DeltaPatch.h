@@ -0,0 +1,95 @@
+/*
+ * DeltaPatch - streaming applier for firmware delta patches
+ *
+ * A patch rebuilds one exact target image from one exact source image
+ * (the firmware the device runs). Layout, little-endian:
+ *
+ *   header   "TDP1", source size + SHA-256, target size + SHA-256 (76 bytes)
+ *   ops      0x01 COPY    zigzag varint offset from the source cursor, varint length
+ *            0x02 INSERT  varint length, then that many literal bytes
+ *            0x00 END     the target is complete; nothing may follow
+ *
+ * COPY leaves the source cursor just past the bytes it copied, so running
+ * on through unchanged code is a zero offset, a patched constant an INSERT
+ * followed by a COPY that skips the bytes it replaced. Patches come from
+ * tools/make_delta.py.
+ *
+ * The applier pulls the patch, reads the source and pushes the target
+ * through caller callbacks, at most one DELTA_PATCH_BLOCK of target per
+ * step(), so neither image is ever held in RAM and the caller decides how
+ * much flash work happens per pass. Every length is checked against the
+ * header; the SHA-256 values are the caller's to verify (the source before
+ * the first step, the target over what was written).
+ *
+ * Pure logic, no Arduino dependency, no allocation. Single owner.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DELTA_PATCH_MAGIC 0x31504454UL  // "TDP1"
+#define DELTA_PATCH_HEADER_SIZE 76
+#define DELTA_PATCH_BLOCK 1024          // Target bytes per step (one write to flash)
+#define DELTA_PATCH_INPUT 128           // Read-ahead of op headers from the patch
+
+struct DeltaPatchHeader {
+  uint32_t sourceSize;
+  uint8_t sourceSha256[32];
+  uint32_t targetSize;
+  uint8_t targetSha256[32];
+};
+
+struct DeltaPatchIo {
+  size_t (*readPatch)(void* ctx, uint8_t* out, size_t length);  // Next patch bytes; fewer (0 at the end) is the end
+  bool (*readSource)(void* ctx, uint32_t offset, uint8_t* out, size_t length);
+  bool (*writeTarget)(void* ctx, const uint8_t* data, size_t length);
+  void* ctx;
+};
+
+enum class DeltaPatchStatus : uint8_t {
+  Running,
+  Done,         // END reached with exactly targetSize bytes written
+  BadPatch,     // Not a patch, truncated, or an op outside the header's bounds
+  SourceError,  // readSource() failed
+  WriteError    // writeTarget() failed
+};
+
+const char* deltaPatchStatusName(DeltaPatchStatus status);
+
+class DeltaPatch {
+ public:
+  DeltaPatch() : status_(DeltaPatchStatus::BadPatch) {}
+
+  // Reads the header; BadPatch unless it is one. header() is valid on Running.
+  DeltaPatchStatus begin(const DeltaPatchIo& io);
+
+  // Produces up to DELTA_PATCH_BLOCK target bytes
+  DeltaPatchStatus step();
+
+  const DeltaPatchHeader& header() const { return header_; }
+  DeltaPatchStatus status() const { return status_; }
+  uint32_t written() const { return written_; }
+  uint32_t patchBytes() const { return patchBytes_; }  // Consumed so far, header included
+
+ private:
+  bool nextOp();
+  bool readByte(uint8_t& out);
+  bool readVarint(uint32_t& out);
+  bool readExact(uint8_t* out, size_t length);
+
+  DeltaPatchIo io_;
+  DeltaPatchHeader header_;
+  DeltaPatchStatus status_;
+  uint8_t op_;
+  uint32_t opRemaining_;
+  uint32_t sourceCursor_;
+  uint32_t produced_;  // Target bytes the decoded ops account for
+  uint32_t written_;
+  uint32_t patchBytes_;
+  uint8_t input_[DELTA_PATCH_INPUT];
+  size_t inputPos_;
+  size_t inputLength_;
+  uint8_t block_[DELTA_PATCH_BLOCK];
+};
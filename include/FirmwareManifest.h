@@ -0,0 +1,44 @@
+/*
+ * FirmwareManifest - the update offered to one running firmware version
+ *
+ * Fleet-wide, under /firmware/updates/<running version key> in the RTDB
+ * (the version with the characters RTDB keys refuse replaced by '_'):
+ *
+ *   {"version":"1.1.0-PROD","path":"firmware/1.0.0-PROD_1.1.0-PROD.tdp",
+ *    "size":183422,"sha256":"<64 hex digits>"}
+ *
+ * `path` is the delta patch in Firebase Storage (DeltaPatch.h), `size` its
+ * length and `sha256` the hash of the image it must produce. No node
+ * (null) means no update for this version. Unknown members are ignored.
+ *
+ * Pure logic, no Arduino dependency, no allocation.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MANIFEST_VERSION_MAX 32
+#define MANIFEST_PATH_MAX 128
+
+struct FirmwareManifest {
+  char version[MANIFEST_VERSION_MAX];
+  char path[MANIFEST_PATH_MAX];  // Storage object, relative to the bucket
+  uint32_t size;                 // Patch bytes
+  uint8_t sha256[32];            // Target image
+};
+
+enum class ManifestStatus : uint8_t {
+  None,  // null: nothing offered
+  Ok,
+  Bad    // Not an object, or a member missing or malformed
+};
+
+ManifestStatus firmwareManifestParse(const char* json, FirmwareManifest& out);
+
+// `version` as an RTDB key: '.', '$', '#', '[', ']' and '/' become '_'
+void firmwareVersionKey(const char* version, char* out, size_t size);
+
+// First `bytes` of a hash as hex, for logs
+const char* sha256Hex(const uint8_t* hash, size_t bytes, char* out, size_t size);
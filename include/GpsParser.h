@@ -0,0 +1,53 @@
+/*
+ * GpsParser - allocation-free parsing of SIM7600 GPS output
+ *
+ * Handles both sources the firmware sees on the AT port:
+ *   +CGPSINFO: 3336.657000,N,07303.679980,E,021225,103045.0,512.3,0.0,
+ *   $GPGGA / $GNGGA and $GPRMC / $GNRMC sentences (AT+CGPSINFOCFG streaming)
+ *
+ * Coordinates are kept as signed degrees x 1e7 in integers (~1 cm
+ * resolution) and converted from ddmm.mmmmmm without floating point. Text
+ * is only produced at the edges via formatCoordinate(). Parsers read the
+ * const input in place: no copies, no String, no heap.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GPS_COORD_TEXT_MAX 16  // "-180.000000" + NUL, with headroom
+
+// GGA fix quality values (CGPSINFO carries none; a valid line counts as GPS_QUALITY_GPS)
+#define GPS_QUALITY_NONE 0
+#define GPS_QUALITY_GPS 1
+#define GPS_QUALITY_DGPS 2
+
+struct GpsFix {
+  int32_t latE7;       // Degrees x 1e7, negative = south
+  int32_t lonE7;       // Degrees x 1e7, negative = west
+  uint16_t hdopX100;   // Horizontal dilution x 100, 0 = unknown
+  uint8_t quality;     // GPS_QUALITY_*
+  uint8_t satellites;  // Satellites used, 0 = unknown
+
+  // UTC timestamp of the solution, 0 = not reported by this sentence
+  uint16_t year;
+  uint8_t month;
+  uint8_t day;
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+
+  bool valid;          // Position fields hold a real fix
+};
+
+// Parse a "+CGPSINFO:" response. Returns false (fix untouched) while the receiver has no position.
+bool parseCgpsInfo(const char* line, GpsFix& fix);
+
+// Parse a GGA or RMC sentence, checksum verified. Fields the sentence
+// carries are merged into `fix`; others are left as they were. Returns true
+// if the sentence was recognised and reported a valid position.
+bool parseNmea(const char* line, GpsFix& fix);
+
+// Signed degrees with six decimals, e.g. "33.610950". Returns `out`.
+const char* formatCoordinate(int32_t e7, char* out, size_t size);
@@ -0,0 +1,52 @@
+/*
+ * GpsTracker - settles a stream of GPS fixes into one billboard position
+ *
+ * A billboard does not move, so the published position is the mean of
+ * consistent fixes rather than the latest one:
+ *
+ *   SEARCHING  no usable fix yet
+ *   LOCKED     fixes arriving; mean of those within GPS_STABLE_RADIUS_M
+ *              of each other (an outlier restarts the mean)
+ *   STABLE     GPS_STABLE_SAMPLES consistent fixes; the position is
+ *              frozen and refreshes can back off. Only a fix further
+ *              than GPS_MOVED_RADIUS_M away (the unit was relocated)
+ *              drops back to LOCKED.
+ *
+ * Fixes with a known HDOP above GPS_MAX_HDOP_X100 are ignored. Pure
+ * logic: no AT commands, no Arduino dependencies.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "GpsParser.h"
+
+#define GPS_STABLE_RADIUS_M 30      // Fixes this close count as the same position
+#define GPS_STABLE_SAMPLES 10       // Consistent fixes before the position is frozen
+#define GPS_MOVED_RADIUS_M 250      // A stable position only moves for a jump this large
+#define GPS_MAX_HDOP_X100 500       // Ignore fixes worse than HDOP 5.0
+
+enum GpsTrackState : uint8_t {
+  GPS_TRACK_SEARCHING = 0,
+  GPS_TRACK_LOCKED,
+  GPS_TRACK_STABLE
+};
+
+struct GpsTracker {
+  uint8_t state;       // GpsTrackState
+  uint16_t samples;    // Fixes in the running mean
+  int64_t sumLatE7;
+  int64_t sumLonE7;
+  int32_t latE7;       // Published position (valid unless SEARCHING)
+  int32_t lonE7;
+};
+
+void gpsTrackerReset(GpsTracker& tracker);
+
+// Feed one fix. Returns true if the published position or state changed.
+bool gpsTrackerUpdate(GpsTracker& tracker, const GpsFix& fix);
+
+const char* gpsTrackStateName(uint8_t state);
+
+// Approximate ground distance (equirectangular; fine below a few km)
+float gpsDistanceMeters(int32_t latE7a, int32_t lonE7a, int32_t latE7b, int32_t lonE7b);
@@ -0,0 +1,122 @@
+/*
+ * HashSet64 - fixed-capacity open-addressing set of 64-bit hashes
+ *
+ * Used for per-cycle deduplication of salted MAC/BSSID hashes without
+ * touching the heap. Storage is a flat array sized at compile time; slots
+ * are tagged with a generation stamp so clear() is O(1) instead of a
+ * memset or a tree teardown.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Smallest power of two that keeps `maxEntries` at or below 75% load
+constexpr size_t hashSetPow2(size_t value, size_t cap = 1) {
+  return cap >= value ? cap : hashSetPow2(value, cap << 1);
+}
+
+constexpr size_t hashSetCapacityFor(size_t maxEntries) {
+  return hashSetPow2((maxEntries * 4) / 3 + 1);
+}
+
+constexpr uint8_t hashSetLog2(size_t value) {
+  return value <= 1 ? 0 : 1 + hashSetLog2(value >> 1);
+}
+
+enum class HashInsert : uint8_t {
+  Added,    // Key was not present and has been stored
+  Present,  // Key was already in the set
+  Full      // Table reached its load limit, key not stored
+};
+
+template <size_t Capacity>
+class HashSet64 {
+  static_assert(Capacity >= 8 && (Capacity & (Capacity - 1)) == 0,
+                "HashSet64 capacity must be a power of two >= 8");
+
+ public:
+  static const size_t kCapacity = Capacity;
+  static const size_t kMaxEntries = (Capacity * 3) / 4;
+
+  HashSet64() : generation_(1), count_(0) {
+    memset(stamps_, 0, sizeof(stamps_));
+  }
+
+  bool contains(uint64_t key) const {
+    size_t idx = slotFor(key);
+    while (stamps_[idx] == generation_) {
+      if (keys_[idx] == key) return true;
+      idx = (idx + 1) & kMask;
+    }
+    return false;
+  }
+
+  HashInsert insert(uint64_t key) {
+    size_t idx = slotFor(key);
+    while (stamps_[idx] == generation_) {
+      if (keys_[idx] == key) return HashInsert::Present;
+      idx = (idx + 1) & kMask;
+    }
+    if (count_ >= kMaxEntries) return HashInsert::Full;
+
+    keys_[idx] = key;
+    stamps_[idx] = generation_;
+    count_++;
+    return HashInsert::Added;
+  }
+
+  void clear() {
+    // Bumping the generation invalidates every slot at once; only on
+    // wrap-around do the stamps need a real reset.
+    if (++generation_ == 0) {
+      memset(stamps_, 0, sizeof(stamps_));
+      generation_ = 1;
+    }
+    count_ = 0;
+  }
+
+  size_t size() const { return count_; }
+  bool full() const { return count_ >= kMaxEntries; }
+
+ private:
+  static const size_t kMask = Capacity - 1;
+  static const uint8_t kShift = 64 - hashSetLog2(Capacity);
+
+  static size_t slotFor(uint64_t key) {
+    // Fibonacci hashing: take the well-mixed high bits of the product
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> kShift);
+  }
+
+  uint64_t keys_[Capacity];
+  uint16_t stamps_[Capacity];
+  uint16_t generation_;
+  size_t count_;
+};
+
+/*
+ * Two HashSet64 generations ("current" and "previous") with an O(1) swap.
+ * rotate() makes the current set the previous one and reuses the old
+ * previous storage as the new, empty current set.
+ */
+template <size_t Capacity>
+class HashGenerations {
+ public:
+  HashGenerations() : current_(0) {}
+
+  HashSet64<Capacity>& current() { return sets_[current_]; }
+  HashSet64<Capacity>& previous() { return sets_[current_ ^ 1]; }
+  const HashSet64<Capacity>& current() const { return sets_[current_]; }
+  const HashSet64<Capacity>& previous() const { return sets_[current_ ^ 1]; }
+
+  void rotate() {
+    current_ ^= 1;
+    sets_[current_].clear();
+  }
+
+ private:
+  HashSet64<Capacity> sets_[2];
+  uint8_t current_;
+};
@@ -0,0 +1,59 @@
+/*
+ * HeapWatchdog - restart on measured heap degradation instead of a timer
+ *
+ * Fed the free heap and the largest free block at a steady cadence. The
+ * largest block is the figure that matters: the TLS client and the
+ * Firebase client allocate their buffers in one piece, so a heap that has
+ * plenty free but only in small fragments fails the next reconnect. A
+ * restart is due once either figure has stayed below its floor for
+ * `strikes` samples in a row; a dip while a handshake holds its buffers
+ * recovers before that and is only counted.
+ *
+ * With the firmware on fixed buffers the floors should never be reached;
+ * the watchdog is what lets a device run for weeks without a scheduled
+ * restart and still recover if a library leaks.
+ *
+ * Pure logic, no Arduino dependency. Single owner.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+class HeapWatchdog {
+ public:
+  HeapWatchdog(uint32_t minLargestBlock, uint32_t minFree, uint8_t strikes)
+      : minLargestBlock_(minLargestBlock), minFree_(minFree), strikesNeeded_(strikes) {
+    reset();
+  }
+
+  void reset() {
+    strikes_ = 0;
+    degradedSamples_ = 0;
+    lowestLargestBlock_ = UINT32_MAX;
+  }
+
+  // One health sample; true when a restart is due
+  bool sample(uint32_t freeHeap, uint32_t largestBlock) {
+    if (largestBlock < lowestLargestBlock_) lowestLargestBlock_ = largestBlock;
+    if (largestBlock >= minLargestBlock_ && freeHeap >= minFree_) {
+      strikes_ = 0;
+      return false;
+    }
+    degradedSamples_++;
+    if (strikes_ < strikesNeeded_) strikes_++;
+    return strikes_ >= strikesNeeded_;
+  }
+
+  uint8_t strikes() const { return strikes_; }
+  uint32_t degradedSamples() const { return degradedSamples_; }      // Since boot, recovered or not
+  uint32_t lowestLargestBlock() const { return lowestLargestBlock_; }  // UINT32_MAX before the first sample
+
+ private:
+  uint32_t minLargestBlock_;
+  uint32_t minFree_;
+  uint8_t strikesNeeded_;
+  uint8_t strikes_;
+  uint32_t degradedSamples_;
+  uint32_t lowestLargestBlock_;
+};
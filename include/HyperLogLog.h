@@ -0,0 +1,97 @@
+/*
+ * HyperLogLog - fixed-memory estimate of distinct 64-bit hashes
+ *
+ * 2^Precision one-byte registers, each holding the longest run of leading
+ * zeros seen among hashes routed to it. Standard error is about
+ * 1.04 / sqrt(2^Precision): 2.3% at 11 (2 KB), 3.3% at 10 (1 KB), with
+ * linear counting below 2.5x the register count. Input must already be
+ * well mixed (MacHash output is).
+ *
+ * Sketches of the same precision built from the same hash function merge
+ * by taking the per-register maximum, so the backend can union hours into
+ * days, restarts into one day and billboards into a campaign. encode()
+ * packs registers to 6 bits and base64s them for upload.
+ *
+ * add() is one shift, one count-leading-zeros and one compare: no heap,
+ * no locking. Registers only ever grow, so a reader racing a writer sees
+ * a valid (slightly older) sketch.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+template <uint8_t Precision>
+class HyperLogLog {
+  static_assert(Precision >= 4 && Precision <= 16, "HyperLogLog precision must be 4..16");
+
+ public:
+  static const size_t kRegisters = (size_t)1 << Precision;
+  static const size_t kPackedBytes = kRegisters * 6 / 8;
+  static const size_t kEncodedChars = (kPackedBytes + 2) / 3 * 4;  // Base64, no terminator
+
+  HyperLogLog() { clear(); }
+
+  void add(uint64_t hash) {
+    // Top bits pick the register, the rest supply the rank
+    size_t index = (size_t)(hash >> (64 - Precision));
+    uint64_t rest = hash << Precision;
+    uint8_t rank = rest ? (uint8_t)(__builtin_clzll(rest) + 1) : (uint8_t)(64 - Precision + 1);
+    if (rank > registers_[index]) registers_[index] = rank;
+  }
+
+  void merge(const HyperLogLog& other) {
+    for (size_t i = 0; i < kRegisters; i++) {
+      if (other.registers_[i] > registers_[i]) registers_[i] = other.registers_[i];
+    }
+  }
+
+  void clear() { memset(registers_, 0, sizeof(registers_)); }
+
+  uint32_t estimate() const {
+    float sum = 0.0f;
+    size_t zeros = 0;
+    for (size_t i = 0; i < kRegisters; i++) {
+      sum += ldexpf(1.0f, -(int)registers_[i]);
+      if (registers_[i] == 0) zeros++;
+    }
+
+    const float m = (float)kRegisters;
+    float estimate = alpha() * m * m / sum;
+    if (estimate <= 2.5f * m && zeros != 0) {
+      estimate = m * logf(m / (float)zeros);
+    }
+    return (uint32_t)(estimate + 0.5f);
+  }
+
+  // Base64 of the registers packed MSB-first at 6 bits each. Returns the
+  // characters written (NUL-terminated), or 0 if `size` is too small.
+  size_t encode(char* out, size_t size) const {
+    static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    if (size < kEncodedChars + 1) return 0;
+
+    // Four 6-bit registers are exactly three packed bytes, i.e. four base64
+    // digits: the packing and the base64 step cancel and each register
+    // becomes one digit. Precision >= 4 keeps kRegisters a multiple of 4.
+    for (size_t i = 0; i < kRegisters; i++) {
+      out[i] = kAlphabet[registers_[i] & 0x3F];
+    }
+    out[kEncodedChars] = '\0';
+    return kEncodedChars;
+  }
+
+  const uint8_t* registers() const { return registers_; }
+
+ private:
+  static float alpha() {
+    if (kRegisters == 16) return 0.673f;
+    if (kRegisters == 32) return 0.697f;
+    if (kRegisters == 64) return 0.709f;
+    return 0.7213f / (1.0f + 1.079f / (float)kRegisters);
+  }
+
+  uint8_t registers_[kRegisters];
+};
@@ -0,0 +1,151 @@
+/*
+ * JsonScan - reading the flat JSON objects the device GETs from the RTDB
+ *
+ * Enough JSON for nodes the firmware reads back (/devices/<id>/config, the
+ * firmware manifest): walk the members of one object and pick out scalar
+ * values in place, with no tree and no allocation. Values of members the
+ * caller does not know are skipped whatever their type:
+ *
+ *   JsonMembers members(json);
+ *   while (members.next(key, keyLength, value)) { ... }
+ *   if (!members.ok()) { malformed }
+ *
+ * Pure logic, no Arduino dependency.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+static inline const char* jsonSkipSpace(const char* p) {
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+  return p;
+}
+
+// `literal` (true, false, null) at `p`, followed by a delimiter
+static inline bool jsonIsLiteral(const char* p, const char* literal) {
+  size_t length = strlen(literal);
+  if (strncmp(p, literal, length) != 0) return false;
+  char next = p[length];
+  return next == '\0' || next == ',' || next == '}' || next == ']' || next == ' ' || next == '\t' || next == '\r' ||
+         next == '\n';
+}
+
+// Past the closing quote of the string that starts at `p`, NULL if unterminated
+static inline const char* jsonSkipString(const char* p) {
+  for (p++; *p; p++) {
+    if (*p == '\\') {
+      if (*++p == '\0') return NULL;
+    } else if (*p == '"') {
+      return p + 1;
+    }
+  }
+  return NULL;
+}
+
+// Past one value of any type, NULL if malformed
+static inline const char* jsonSkipValue(const char* p) {
+  if (*p == '"') return jsonSkipString(p);
+  if (*p == '{' || *p == '[') {
+    int depth = 0;
+    while (*p) {
+      if (*p == '"') {
+        p = jsonSkipString(p);
+        if (!p) return NULL;
+        continue;
+      }
+      if (*p == '{' || *p == '[') {
+        depth++;
+      } else if ((*p == '}' || *p == ']') && --depth == 0) {
+        return p + 1;
+      }
+      p++;
+    }
+    return NULL;
+  }
+  const char* start = p;
+  while (*p && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+  return p == start ? NULL : p;
+}
+
+// A string value without escapes into `out`; false for any other value or
+// one that does not fit
+static inline bool jsonReadString(const char* p, char* out, size_t size) {
+  if (*p != '"') return false;
+  size_t length = 0;
+  for (p++; *p != '"'; p++) {
+    if (*p == '\0' || *p == '\\' || length + 1 >= size) return false;
+    out[length++] = *p;
+  }
+  out[length] = '\0';
+  return true;
+}
+
+// A key from JsonMembers::next() equals `name`
+static inline bool jsonKeyIs(const char* key, size_t keyLength, const char* name) {
+  return strlen(name) == keyLength && strncmp(name, key, keyLength) == 0;
+}
+
+class JsonMembers {
+ public:
+  // `json` is the whole document; anything but one object is malformed
+  explicit JsonMembers(const char* json) : p_(jsonSkipSpace(json)), ok_(false), first_(true) {
+    if (*p_ != '{') {
+      p_ = NULL;
+      return;
+    }
+    p_ = jsonSkipSpace(p_ + 1);
+  }
+
+  // The next member: its key (not terminated) and the start of its value.
+  // false at the end of the object or on malformed input (see ok()).
+  bool next(const char*& key, size_t& keyLength, const char*& value) {
+    if (!p_) return false;
+    if (!first_) {
+      // Past the previous member's value, whatever the caller read of it
+      p_ = jsonSkipValue(p_);
+      if (!p_) return false;
+      p_ = jsonSkipSpace(p_);
+      if (*p_ == ',') {
+        p_ = jsonSkipSpace(p_ + 1);
+      } else {
+        return finish();
+      }
+    } else if (*p_ == '}') {
+      return finish();
+    }
+    first_ = false;
+
+    if (*p_ != '"') return fail();
+    key = p_ + 1;
+    const char* keyEnd = jsonSkipString(p_);
+    if (!keyEnd) return fail();
+    keyLength = keyEnd - 1 - key;
+    p_ = jsonSkipSpace(keyEnd);
+    if (*p_ != ':') return fail();
+    p_ = jsonSkipSpace(p_ + 1);
+    if (*p_ == '\0') return fail();
+    value = p_;
+    return true;
+  }
+
+  // After next() returned false: the object was well formed and nothing follows it
+  bool ok() const { return ok_; }
+
+ private:
+  bool finish() {
+    ok_ = *p_ == '}' && *jsonSkipSpace(p_ + 1) == '\0';
+    p_ = NULL;
+    return false;
+  }
+
+  bool fail() {
+    p_ = NULL;
+    return false;
+  }
+
+  const char* p_;
+  bool ok_;
+  bool first_;
+};
@@ -0,0 +1,89 @@
+/*
+ * JsonWriter - append-only JSON text in a caller-owned fixed buffer
+ *
+ * Upload bodies are built in one preallocated buffer instead of growing a
+ * String: no heap traffic, no fragmentation, and the worst case is known
+ * at compile time. Values are printf-formatted by the caller; the writer
+ * only tracks the length, inserts member separators and fails cleanly.
+ *
+ * Failure is sticky: once an append does not fit, the text is truncated
+ * at the last complete append and every later call fails too, so a
+ * builder can chain appends and check ok() once at the end.
+ *
+ * No Arduino dependency, no locking: one writer per buffer.
+ */
+
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+
+class JsonWriter {
+ public:
+  JsonWriter(char* buffer, size_t size) : buffer_(buffer), size_(size) { reset(); }
+
+  void reset() {
+    length_ = 0;
+    failed_ = size_ == 0;
+    if (size_ != 0) buffer_[0] = '\0';
+  }
+
+  // printf at the end of the text
+  __attribute__((format(printf, 2, 3))) bool append(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    bool fits = vappend(format, args);
+    va_end(args);
+    return fits;
+  }
+
+  // Like append(), preceded by ',' unless it is the first member of the enclosing object or array
+  __attribute__((format(printf, 2, 3))) bool member(const char* format, ...) {
+    size_t start = length_;
+    if (length_ != 0 && buffer_[length_ - 1] != '{' && buffer_[length_ - 1] != '[' && !append(",")) return false;
+    va_list args;
+    va_start(args, format);
+    bool fits = vappend(format, args);
+    va_end(args);
+    if (!fits) {
+      length_ = start;  // Drop the separator with the member
+      buffer_[start] = '\0';
+    }
+    return fits;
+  }
+
+  // In-place encoders write at tail(), up to remaining() bytes including
+  // the NUL, then report the characters written (0 = did not fit)
+  char* tail() { return buffer_ + length_; }
+  size_t remaining() const { return size_ - length_; }
+  bool advance(size_t written) {
+    if (failed_ || written == 0 || written >= size_ - length_) return fail();
+    length_ += written;
+    return true;
+  }
+
+  bool ok() const { return !failed_; }
+  size_t length() const { return length_; }
+  const char* c_str() const { return buffer_; }
+
+ private:
+  bool vappend(const char* format, va_list args) {
+    if (failed_) return false;
+    int written = vsnprintf(buffer_ + length_, size_ - length_, format, args);
+    if (written < 0 || (size_t)written >= size_ - length_) return fail();
+    length_ += written;
+    return true;
+  }
+
+  bool fail() {
+    failed_ = true;
+    if (size_ != 0) buffer_[length_] = '\0';
+    return false;
+  }
+
+  char* buffer_;
+  size_t size_;
+  size_t length_;
+  bool failed_;
+};
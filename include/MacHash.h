@@ -0,0 +1,50 @@
+/*
+ * MacHash - salted one-way hashing of 6-byte MAC/BSSID addresses
+ *
+ * FNV-1a 64-bit applied word-at-a-time: the 48-bit MAC and the 32-bit
+ * salt are each folded in with a single xor/multiply step instead of ten
+ * byte-wise rounds. Because a wide xor followed by the FNV prime only
+ * propagates bits upwards, the result is passed through a 64-bit avalanche
+ * finalizer so every output bit depends on every input bit.
+ *
+ * No heap, no String - safe to call from the scan loop and WiFi callbacks.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAC_HASH_HEX_LEN 16  // Characters in a formatted hash (no terminator)
+
+static inline uint64_t macHashAvalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static inline uint64_t macHashSalted(const uint8_t* macAddr, uint32_t salt) {
+  const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+  const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+  uint64_t mac = 0;
+  memcpy(&mac, macAddr, 6);  // Little-endian load, alignment-safe
+
+  uint64_t hash = FNV_OFFSET_BASIS;
+  hash ^= mac;
+  hash *= FNV_PRIME;
+  hash ^= salt;
+  hash *= FNV_PRIME;
+
+  return macHashAvalanche(hash);
+}
+
+// Writes MAC_HASH_HEX_LEN hex digits plus terminator into `out`
+static inline char* formatMacHash(uint64_t hash, char (&out)[MAC_HASH_HEX_LEN + 1]) {
+  snprintf(out, sizeof(out), "%016llx", (unsigned long long)hash);
+  return out;
+}
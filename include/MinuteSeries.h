@@ -0,0 +1,97 @@
+/*
+ * MinuteSeries - per-minute time-series buckets between aggregation and upload
+ *
+ * The aggregation task fills one open MinuteBucket: sightings, a small
+ * HyperLogLog for distinct devices, the RSSI distribution (ScanRecord
+ * bins) and scan outcomes. When a scan ends in a later minute, the bucket
+ * is closed - one sketch estimate and one ring push, independent of how
+ * many buckets are queued - and the next minute starts empty.
+ *
+ * Closed buckets wait in an SpscRing until the uplink task pops them in
+ * batches. Memory is fixed at Capacity buckets (about 30 B each) no matter
+ * how long the link is down; a full ring drops the newest closed bucket
+ * and counts it, so the consumer's half of the ring is never touched.
+ *
+ * Buckets are keyed by Unix minute. A scan lands in the bucket that was
+ * open when it began, so one straddling a boundary counts for the earlier
+ * minute. Nothing is bucketed before the clock is synced (minute 0).
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "HyperLogLog.h"
+#include "ScanRecord.h"
+#include "SpscRing.h"
+
+#define MINUTE_UNIQUE_PRECISION 7  // 128-register sketch per open minute (~9%, linear counting to ~320)
+
+struct MinuteBucket {
+  uint32_t minute;                         // Unix minute (epoch / 60) the bucket covers
+  uint16_t impressions;                    // Sightings, saturating
+  uint16_t unique;                         // Distinct devices (estimate)
+  uint16_t rssiHistogram[SCAN_RSSI_BINS];  // Sightings per RSSI bin, saturating
+  uint8_t scans;
+  uint8_t scanErrors;
+};
+
+template <size_t Capacity>
+class MinuteSeries {
+ public:
+  MinuteSeries() : open_(false), dropped_(0) {}
+
+  // Producer side: one task feeds sightings and scan ends
+  void sighting(uint64_t hash, int8_t rssi) {
+    if (!open_) return;
+    saturatingIncrement(bucket_.impressions);
+    saturatingIncrement(bucket_.rssiHistogram[scanRssiBin(rssi)]);
+    sketch_.add(hash);
+  }
+
+  // After each scan: count it, then close the bucket if `minute` has
+  // moved on and open the next one (minute 0 = clock not set)
+  void scanEnded(bool failed, uint32_t minute) {
+    if (open_) {
+      if (bucket_.scans < 0xFF) bucket_.scans++;
+      if (failed && bucket_.scanErrors < 0xFF) bucket_.scanErrors++;
+      if (minute == bucket_.minute) return;
+      close();
+    }
+    if (minute != 0) start(minute);
+  }
+
+  // Consumer side: oldest closed buckets first
+  size_t pop(MinuteBucket* out, size_t max) { return ring_.pop(out, max); }
+  size_t pending() const { return ring_.size(); }
+
+  uint32_t dropped() const { return dropped_; }
+  static size_t capacity() { return Capacity; }
+
+ private:
+  static void saturatingIncrement(uint16_t& counter) {
+    if (counter < 0xFFFF) counter++;
+  }
+
+  void start(uint32_t minute) {
+    memset(&bucket_, 0, sizeof(bucket_));
+    bucket_.minute = minute;
+    sketch_.clear();
+    open_ = true;
+  }
+
+  void close() {
+    uint32_t unique = sketch_.estimate();
+    bucket_.unique = unique > 0xFFFF ? 0xFFFF : (uint16_t)unique;
+    if (!ring_.push(bucket_)) dropped_++;
+    open_ = false;
+  }
+
+  SpscRing<MinuteBucket, Capacity> ring_;
+  MinuteBucket bucket_;
+  HyperLogLog<MINUTE_UNIQUE_PRECISION> sketch_;
+  bool open_;
+  volatile uint32_t dropped_;
+};
@@ -0,0 +1,86 @@
+/*
+ * ModemTlsClient - Client backed by the SIM7600's own SSL stack (AT+CCH*)
+ *
+ * Alternative to ESP_SSLClient over TinyGsmClient: the modem runs the TLS
+ * handshake and record layer, so only plaintext HTTP crosses the UART and
+ * no BearSSL buffers live in ESP32 heap. FirebaseClient sees an ordinary
+ * Client and cannot tell the difference.
+ *
+ * Uses one CCH session in manual receive mode (AT+CCHSET=0,1): received
+ * data stays cached in the modem until read with AT+CCHRECV, and arrivals
+ * are announced by "+CCHEVENT: <id>,RECV EVENT". Writes are collected in
+ * a local buffer and pushed with one AT+CCHSEND per MODEM_TLS_TX_BUFFER
+ * bytes - on flush(), when the buffer fills, or before the first read.
+ *
+ * Every exchange is blocking and runs on the uplink task, which already
+ * takes turns on the UART with the AT engine (see serviceUplink()). URCs
+ * the AT engine reads in between must be forwarded to handleUrc(); lost
+ * ones are covered by polling the receive cache every MODEM_TLS_POLL_MS.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+
+#define MODEM_TLS_SESSION 0            // CCH session index (0-1)
+#define MODEM_TLS_SSL_CONTEXT 0        // AT+CSSLCFG context index (0-9)
+#define MODEM_TLS_TX_BUFFER 1024       // Bytes per AT+CCHSEND (modem max 2048)
+#define MODEM_TLS_RX_BUFFER 1024       // Bytes per AT+CCHRECV
+#define MODEM_TLS_OPEN_TIMEOUT_MS 30000 // DNS + TCP + handshake inside the modem
+#define MODEM_TLS_IO_TIMEOUT_MS 10000  // Prompt / send / receive response
+#define MODEM_TLS_POLL_MS 200          // Receive cache poll when no RECV EVENT was seen
+
+class ModemTlsClient : public Client {
+ public:
+  explicit ModemTlsClient(Stream& stream);
+
+  // Configure the SSL context and start the SSL service (AT+CCHSTART).
+  // Called by connect() if needed; harmless to call again.
+  bool begin();
+
+  // URCs read by someone else on the shared UART
+  void handleUrc(const char* line);
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+
+  uint32_t opens() const { return opens_; }
+  uint32_t openFailures() const { return openFailures_; }
+
+ private:
+  bool command(const char* text, const char* expect, uint32_t timeoutMs, char* lineOut = nullptr,
+               size_t lineSize = 0);
+  bool waitFor(const char* expect, uint32_t timeoutMs, char* lineOut, size_t lineSize, bool* okSeen);
+  int readLine(char* line, size_t size, uint32_t deadline);
+  bool waitPrompt(uint32_t deadline);
+  bool sendBuffered();
+  bool receive();
+
+  Stream& stream_;
+  bool started_;
+  bool connected_;
+  bool peerClosed_;
+  bool rxEvent_;
+  uint32_t lastPoll_;
+
+  uint8_t tx_[MODEM_TLS_TX_BUFFER];
+  size_t txLen_;
+
+  uint8_t rx_[MODEM_TLS_RX_BUFFER];
+  size_t rxLen_;
+  size_t rxPos_;
+
+  uint32_t opens_;
+  uint32_t openFailures_;
+};
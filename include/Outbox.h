@@ -0,0 +1,64 @@
+/*
+ * Outbox - persistent store-and-forward queue of cycle reports on the SD card
+ *
+ * Every completed cycle is appended as a fixed-size OutboxEntry to a ring
+ * file (OUTBOX_PATH) that survives reboots. The uplink drains it in
+ * batches of up to OUTBOX_BATCH entries per request, with at most
+ * OUTBOX_MAX_IN_FLIGHT requests outstanding on the shared client. Each
+ * batch is acknowledged or failed individually; the head of the ring only
+ * moves past contiguous acknowledged batches, so nothing is dropped until
+ * the server has it. Failed or timed-out batches are re-sent unchanged
+ * after OUTBOX_RETRY_MS - uploads are keyed per entry, so a duplicate
+ * delivery just overwrites the same key.
+ *
+ * When the ring is full the oldest entry is overwritten (counted in
+ * outboxOverwritten()).
+ *
+ * Single owner: uplink task. The file is separate from the SD task's
+ * files; concurrent access to the card is serialised by the FAT driver.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define OUTBOX_PATH "/outbox.bin"
+#define OUTBOX_CAPACITY 2048          // Entries kept (~28 h at 50 s cycles)
+#define OUTBOX_BATCH 24               // Entries per upload request
+#define OUTBOX_MAX_IN_FLIGHT 2        // Concurrent upload requests on aClient
+#define OUTBOX_ACK_TIMEOUT_MS 30000   // In-flight batch with no callback is treated as failed
+#define OUTBOX_RETRY_MS 15000         // Delay before a failed batch is re-sent
+
+struct __attribute__((packed)) OutboxEntry {
+  uint32_t timestamp;    // Unix seconds at cycle close, 0 = clock not synced yet
+  uint32_t uptimeMs;     // millis() at cycle close
+  uint32_t bootId;       // Identifies the boot that produced it (salt epoch)
+  uint32_t cycle;        // Report number within that boot
+  uint32_t impressions;
+  uint32_t networks;
+  uint32_t unique;
+  uint32_t repeated;
+};
+
+static_assert(sizeof(OutboxEntry) == 32, "OutboxEntry layout changed");
+
+// Open or create the ring file and recover head/tail. Returns false without a card.
+bool outboxBegin();
+
+// Persist one entry at the tail
+bool outboxPush(const OutboxEntry& entry);
+
+// Reserve the next batch to send (a failed batch due for retry first, else
+// fresh entries). Returns the batch id, or -1 if nothing can be sent now.
+// `firstSeq` identifies this send; pass it back to ack/fail so a late
+// callback from an older send of the same slot is ignored.
+int outboxNextBatch(uint32_t nowMs, OutboxEntry (&out)[OUTBOX_BATCH], size_t* count, uint32_t* firstSeq);
+
+void outboxAck(int batch, uint32_t firstSeq);
+void outboxFail(int batch, uint32_t firstSeq, uint32_t nowMs);
+
+size_t outboxPending();          // Entries not yet acknowledged
+size_t outboxInFlight();         // Batches awaiting a callback
+uint32_t outboxDelivered();      // Entries acknowledged since boot
+uint32_t outboxOverwritten();    // Entries lost to a full ring
@@ -0,0 +1,73 @@
+/*
+ * Pipeline - message types exchanged between the FreeRTOS tasks
+ *
+ *   scanTask (core 0)  --ScanEvent-->   aggregationTask (core 1)
+ *   aggregationTask    --CycleReport--> uplinkTask (core 1)
+ *   any task           --LogMessage-->  sdTask (core 1)
+ *
+ * Everything is plain fixed-size data so it can be copied through a
+ * FreeRTOS queue by value.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Proximity.h"
+#include "VisitTracker.h"
+
+#define LOG_MESSAGE_MAX 160  // Bytes per queued SD log line, including timestamp
+
+enum ScanEventType : uint8_t {
+  SCAN_EVENT_SIGHTING = 0,  // One salted hash seen during the current scan
+  SCAN_EVENT_END = 1        // Scan (or probe window) finished
+};
+
+struct ScanEvent {
+  uint64_t hash;        // SCAN_EVENT_SIGHTING: salted MAC/BSSID hash
+  uint64_t sketchHash;  // SCAN_EVENT_SIGHTING: fleet-keyed hash for the unique sketches, 0 = clock not synced
+  int16_t found;  // SCAN_EVENT_END: detections in this scan, negative = scan error
+  int8_t rssi;
+  uint8_t type;   // ScanEventType
+  uint8_t band;   // SCAN_EVENT_SIGHTING: ProximityBand, classified in the scan task
+};
+
+// Snapshot of one completed SCANS_PER_UPLOAD cycle
+struct CycleReport {
+  // Per-cycle counters
+  uint32_t impressions;
+  uint32_t networks;
+  uint32_t unique;
+  uint32_t repeated;
+  uint32_t proximity[PROXIMITY_BANDS];  // Sightings per distance band
+  uint32_t cyclesMerged;  // >1 when the uplink fell behind and cycles were folded together
+  VisitStats visits;      // Visits closed / started since the previous report
+  uint32_t visitorsPresent;  // Devices with a visit in progress at the snapshot
+
+  // Cumulative counters at time of the snapshot
+  uint32_t totalUnique;
+  uint32_t totalScans;
+  uint32_t scanErrors;
+  uint32_t dedupOverflows;
+};
+
+// Fold a later cycle into an earlier one: counts add up, snapshots take the later value
+static inline void cycleReportMerge(CycleReport& into, const CycleReport& from) {
+  into.impressions += from.impressions;
+  into.networks += from.networks;
+  into.unique += from.unique;
+  into.repeated += from.repeated;
+  for (size_t i = 0; i < PROXIMITY_BANDS; i++) into.proximity[i] += from.proximity[i];
+  into.cyclesMerged += from.cyclesMerged;
+  visitStatsMerge(into.visits, from.visits);
+  into.visitorsPresent = from.visitorsPresent;
+  into.totalUnique = from.totalUnique;
+  into.totalScans = from.totalScans;
+  into.scanErrors = from.scanErrors;
+  into.dedupOverflows = from.dedupOverflows;
+}
+
+struct LogMessage {
+  char text[LOG_MESSAGE_MAX];  // Empty string = flush request (see requestLogFlush())
+};
@@ -0,0 +1,82 @@
+/*
+ * PipelineConfig - sizing of the scan -> aggregation -> upload pipeline
+ *
+ * The part of the firmware configuration that decides what the pipeline
+ * allocates and how it counts, kept apart from src/main.cpp so the native
+ * benchmark (test/test_pipeline_bench) measures the very structures a
+ * board runs instead of a copy of the numbers. Every value can be
+ * overridden from build_flags (-D NAME=value), e.g. to try a larger dedup
+ * table in the benchmark before it reaches a board.
+ *
+ * SCAN_INTERVAL_MS, SCANS_PER_UPLOAD and PROXIMITY_* are defaults only:
+ * /devices/<id>/config overrides them at run time (see RemoteConfig.h).
+ */
+
+#pragma once
+
+#include "HashSet64.h"
+#include "Outbox.h"
+
+// Cycle
+#ifndef SCAN_INTERVAL_MS
+#define SCAN_INTERVAL_MS 5000        // WiFi scan every 5 seconds
+#endif
+#ifndef SCANS_PER_UPLOAD
+#define SCANS_PER_UPLOAD 10          // Scans per cycle (one outbox entry; the report cadence adapts, see UPLOAD_INTERVAL_*)
+#endif
+
+// Dedup table: scans are no longer truncated, so it is sized for a dense site rather than a scan limit
+#ifndef DEDUP_DEVICES_PER_CYCLE
+#define DEDUP_DEVICES_PER_CYCLE 256  // Distinct hashes per cycle the dedup table holds; beyond = counted as overflow only
+#endif
+#define DEDUP_TABLE_CAPACITY hashSetCapacityFor(DEDUP_DEVICES_PER_CYCLE)
+
+// Unique-device sketches (HyperLogLog), per local hour and day
+#ifndef HLL_SKETCH_KEY
+#define HLL_SKETCH_KEY 0x9E3779B9UL  // Fleet-wide: sketches only merge across billboards sharing this key
+#endif
+#ifndef HLL_HOUR_PRECISION
+#define HLL_HOUR_PRECISION 10        // 1 KB per hour sketch, ~3.3% error
+#endif
+#ifndef HLL_DAY_PRECISION
+#define HLL_DAY_PRECISION 11         // 2 KB per day sketch, ~2.3% error
+#endif
+
+// Visit analytics (dwell time, pass-by vs lingering, new vs returning)
+#ifndef VISIT_TRACKER_CAPACITY
+#define VISIT_TRACKER_CAPACITY 512   // Devices remembered at once (~32 B each)
+#endif
+#ifndef VISIT_GAP_S
+#define VISIT_GAP_S 90               // Unseen this long = visit over
+#endif
+#ifndef VISIT_LINGER_S
+#define VISIT_LINGER_S 60            // Visits this long or longer count as lingering, shorter as pass-by
+#endif
+#ifndef VISIT_WINDOW_S
+#define VISIT_WINDOW_S 3600          // Sliding window: a device back within it counts as returning
+#endif
+
+// Proximity bands (defaults; per-billboard calibration overrides them from NVS "proximity")
+#ifndef PROXIMITY_RSSI_AT_1M
+#define PROXIMITY_RSSI_AT_1M -40     // dBm received from a typical device 1 m away
+#endif
+#ifndef PROXIMITY_PATH_LOSS_X10
+#define PROXIMITY_PATH_LOSS_X10 30   // Path-loss exponent x10 (3.0: street level with some clutter)
+#endif
+#ifndef PROXIMITY_VIEWING_M
+#define PROXIMITY_VIEWING_M 25       // "In viewing range": close enough to read the board
+#endif
+#ifndef PROXIMITY_NEARBY_M
+#define PROXIMITY_NEARBY_M 80        // "Nearby": within this distance; weaker signals count as far
+#endif
+
+// Per-minute time series (impressions, unique estimate, RSSI bins, scan errors per bucket)
+#ifndef MINUTE_SERIES_CAPACITY
+#define MINUTE_SERIES_CAPACITY 128   // Closed buckets held in RAM (~2 h offline, power of two)
+#endif
+#ifndef MINUTE_FLUSH_BATCH
+#define MINUTE_FLUSH_BATCH 15        // Buckets per series upload: one 15-minute block
+#endif
+
+// One upload body, built in place: report fields, the stage profile (< 512 B) and one outbox batch (worst-case entry < 140 B)
+#define UPLOAD_JSON_MAX (2048 + OUTBOX_BATCH * 160)
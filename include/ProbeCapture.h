@@ -0,0 +1,32 @@
+/*
+ * ProbeCapture - promiscuous-mode 802.11 probe-request capture
+ *
+ * Counts nearby phones rather than nearby routers. The WiFi driver callback
+ * only copies the transmitter address and RSSI of each probe request into a
+ * lock-free ring; hashing with the ephemeral salt happens on the consumer
+ * side via hashMAC(), so raw MACs never leave the ring.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PROBE_RING_CAPACITY 512        // Sightings buffered between WiFi task and consumer
+#define PROBE_CHANNEL_DWELL_MS 250     // Time spent on each hop channel
+#define PROBE_HOP_CHANNELS {1, 6, 11}  // Channels phones probe on most often
+
+struct ProbeSighting {
+  uint8_t mac[6];   // Transmitter address - consumed and hashed immediately
+  int8_t rssi;
+  uint8_t channel;
+};
+
+bool probeCaptureBegin();
+void probeCaptureEnd();
+void probeCaptureHop(uint32_t nowMs);
+size_t probeCaptureDrain(ProbeSighting* out, size_t max);
+
+uint32_t probeCaptureFrames();   // Probe requests accepted into the ring
+uint32_t probeCaptureDropped();  // Probe requests lost because the ring was full
+size_t probeCaptureBacklog();    // Sightings currently waiting in the ring
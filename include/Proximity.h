@@ -0,0 +1,57 @@
+/*
+ * Proximity - classifies sightings into distance bands by RSSI
+ *
+ * Each billboard carries a calibration: the received power of a typical
+ * device at 1 m and a path-loss exponent for its surroundings, plus the
+ * outer edges of the bands in metres:
+ *
+ *   VIEWING  within viewingM: close enough to read the board
+ *   NEARBY   within nearbyM
+ *   FAR      anything weaker
+ *
+ * The log-distance path-loss model (rssi = rssiAt1m - 10 n log10(d)) is
+ * evaluated once per calibration to turn the band edges into RSSI
+ * thresholds, which are expanded into a 256-entry table indexed by the
+ * raw int8 RSSI. Classifying a sample is one byte load: no floating
+ * point, no branches, no allocation.
+ *
+ * Pure logic, no Arduino dependency. Rebuild the table only while no
+ * task classifies, or accept a scan's worth of mixed old/new bands.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define PROXIMITY_BANDS 3
+
+enum ProximityBand : uint8_t {
+  PROXIMITY_VIEWING = 0,
+  PROXIMITY_NEARBY,
+  PROXIMITY_FAR
+};
+
+struct ProximityCalibration {
+  int8_t rssiAt1m;      // dBm received from a typical device 1 m away
+  uint8_t pathLossX10;  // Path-loss exponent x10: 20 free space, ~27-35 street level
+  uint16_t viewingM;    // Outer edge of the viewing band
+  uint16_t nearbyM;     // Outer edge of the nearby band
+};
+
+struct ProximityTable {
+  uint8_t band[256];    // ProximityBand by (uint8_t)rssi
+  int8_t viewingRssi;   // Weakest RSSI still in the viewing band
+  int8_t nearbyRssi;    // Weakest RSSI still nearby
+};
+
+// Plausible values only: 1 m power -90..0 dBm, exponent 1.0..6.0, 1 <= viewing < nearby
+bool proximityCalibrationValid(const ProximityCalibration& calibration);
+
+// Derive the thresholds and fill the table (floating point, once per calibration)
+void proximityTableBuild(ProximityTable& table, const ProximityCalibration& calibration);
+
+static inline uint8_t proximityClassify(const ProximityTable& table, int8_t rssi) {
+  return table.band[(uint8_t)rssi];
+}
+
+const char* proximityBandName(uint8_t band);
@@ -0,0 +1,74 @@
+/*
+ * RemoteConfig - runtime tunables read from /devices/<id>/config
+ *
+ * The config node is one flat JSON object. Every member is optional and
+ * unknown members are ignored, so the dashboard can add keys ahead of
+ * the firmware:
+ *
+ *   {"scan_interval_ms":5000,"scans_per_upload":10,"upload_interval_max_s":900,
+ *    "restart_interval_h":12,"profiling":true,
+ *    "rssi_1m":-40,"loss_x10":27,"viewing_m":25,"nearby_m":80}
+ *
+ * A missing member (or null) keeps the value in use - the cached NVS copy
+ * or a serial toggle - so a node naming a single key changes only that
+ * key; to go back to a default, write it. A member that is out of range
+ * or has the wrong type is rejected and keeps its current value too.
+ * Some checks span several members:
+ *
+ *   - one cycle (scan interval x scans) must fit in the longest report
+ *     interval, or the three scheduling members are rejected together
+ *   - the proximity calibration must pass proximityCalibrationValid(),
+ *     or its four members are rejected together
+ *
+ * Pure logic, no Arduino dependency, no allocation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "Proximity.h"
+
+struct RuntimeConfig {
+  uint32_t scanIntervalMs;
+  uint32_t scansPerUpload;      // Scans per cycle
+  uint32_t uploadIntervalMaxS;  // Longest gap between reports on a quiet site
+  uint32_t restartIntervalH;    // Scheduled restart, 0 = never
+  ProximityCalibration proximity;
+  bool profiling;
+};
+
+// RemoteConfigResult::changed bits
+enum RemoteConfigField : uint16_t {
+  CONFIG_SCAN_INTERVAL = 1 << 0,
+  CONFIG_SCANS_PER_UPLOAD = 1 << 1,
+  CONFIG_UPLOAD_INTERVAL_MAX = 1 << 2,
+  CONFIG_RESTART_INTERVAL = 1 << 3,
+  CONFIG_PROXIMITY = 1 << 4,
+  CONFIG_PROFILING = 1 << 5
+};
+
+struct RemoteConfigResult {
+  bool valid;         // Payload was an object or null; otherwise `next` = current
+  uint16_t changed;   // RemoteConfigField bits where `next` differs from current
+  uint8_t known;      // Members recognised
+  uint8_t rejected;   // Members (or member groups) left at the current value
+};
+
+#define CONFIG_SCAN_INTERVAL_MIN_MS 1000
+#define CONFIG_SCAN_INTERVAL_MAX_MS 600000
+#define CONFIG_SCANS_PER_UPLOAD_MAX 120
+#define CONFIG_UPLOAD_INTERVAL_MIN_S 60
+#define CONFIG_UPLOAD_INTERVAL_MAX_S 86400
+#define CONFIG_RESTART_INTERVAL_MAX_H 168
+
+// The config node's JSON (an object, or "null" when the node does not
+// exist) on top of `current`, validated against it. Fills `next` in every
+// case.
+RemoteConfigResult remoteConfigParse(const char* json, const RuntimeConfig& current, RuntimeConfig& next);
+
+// Every member in range and the cross-member checks hold (e.g. an NVS copy)
+bool remoteConfigValid(const RuntimeConfig& config);
+
+// RemoteConfigField bits where `a` and `b` differ
+uint16_t remoteConfigDiff(const RuntimeConfig& a, const RuntimeConfig& b);
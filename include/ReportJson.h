@@ -0,0 +1,38 @@
+/*
+ * ReportJson - upload body members for cycles, visits, proximity and minute buckets
+ *
+ * Each function appends one multi-location member ("<path>":<value>) to an
+ * open object in a JsonWriter, with the path relative to /devices/<id>.
+ * Paths carry the date and the boot id, so a body can mix days and boots
+ * and a re-sent member simply overwrites the same key.
+ *
+ * Pure formatting: the caller supplies dates, boot ids and time zone
+ * offsets, so the encoders run unchanged in the native benchmark. Like
+ * JsonWriter::member(), each returns false once the body is out of room.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "JsonWriter.h"
+#include "MinuteSeries.h"
+#include "Outbox.h"
+#include "Proximity.h"
+#include "VisitTracker.h"
+
+// "<prefix><date>/<boot>-<cycle>": compact [ts, impressions, networks,
+// unique, repeated] or named fields; `timestamp` 0 files it under "undated"
+bool reportJsonCycle(JsonWriter& json, const char* keyPrefix, const OutboxEntry& entry, uint32_t timestamp,
+                     bool compact);
+
+// "data/<date>/visits/<boot>": one boot's visit analytics for the day
+bool reportJsonVisits(JsonWriter& json, const char* date, uint32_t bootId, const VisitStats& visits);
+
+// "data/<date>/proximity/<boot>": one boot's sightings per distance band for the day
+bool reportJsonProximity(JsonWriter& json, const char* date, uint32_t bootId,
+                         const uint32_t (&bands)[PROXIMITY_BANDS]);
+
+// "series/<date>/<boot>/<HHMM>": [impressions, unique, scans, scan_errors, rssi bins...],
+// date and HHMM in local time `offsetS` seconds east of UTC
+bool reportJsonMinute(JsonWriter& json, uint32_t bootId, const MinuteBucket& bucket, int32_t offsetS);
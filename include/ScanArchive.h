@@ -0,0 +1,39 @@
+/*
+ * ScanArchive - per-day binary scan files on the SD card
+ *
+ * Appends ScanRecords (see ScanRecord.h) to /scans/YYYY-MM-DD.bin in
+ * batches of up to SCAN_ARCHIVE_BATCH records (512 bytes per write), then
+ * rewrites the 64-byte header with the new record count and hour index.
+ * Records start after that header, so a full batch covers the last 448
+ * bytes of one 512-byte sector and the first 64 of the next; timed and
+ * day-change flushes write partial batches anyway, so the write size, not
+ * sector alignment, is what the batching buys. The header is the commit point: after a power cut,
+ * records past header.recordCount are simply overwritten.
+ *
+ * Single owner: all calls must come from the SD task.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ScanRecord.h"
+
+#define SCAN_ARCHIVE_DIR "/scans"
+#define SCAN_ARCHIVE_UNDATED_FILE "/scans/undated.bin"
+#define SCAN_ARCHIVE_BATCH 16                // Records per write (16 x 32 B = 512 B, not sector-aligned)
+#define SCAN_ARCHIVE_FLUSH_INTERVAL_MS 60000 // Max age of a buffered record
+
+bool scanArchiveBegin();
+
+// Buffer one record; writes out when the batch fills or the day changes
+void scanArchiveAppend(const ScanRecord& record);
+
+// Apply the time threshold. Call periodically from the owning task.
+void scanArchiveService(uint32_t nowMs);
+
+// Write buffered records and the updated header
+bool scanArchiveFlush();
+
+uint32_t scanArchiveRecordsWritten();
+uint32_t scanArchiveRecordsDropped();
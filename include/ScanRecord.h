@@ -0,0 +1,71 @@
+/*
+ * ScanRecord - fixed-size binary scan archive format
+ *
+ * One file per UTC day, /scans/YYYY-MM-DD.bin:
+ *
+ *   ScanFileHeader   64 bytes, rewritten on every flush
+ *   ScanRecord[]     32 bytes each, appended in time order
+ *
+ * All fields are little-endian and packed, matching the ESP32 in-memory
+ * layout, so a day can be read back with a single fread into an array.
+ * header.hourCounts[] is the record index: records for hour h start at
+ * sizeof(ScanFileHeader) + sum(hourCounts[0..h-1]) * recordSize.
+ *
+ * Records written before the clock is synced have timestamp 0 and go to
+ * SCAN_ARCHIVE_UNDATED_FILE instead.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "CivilTime.h"
+
+#define SCAN_FILE_MAGIC 0x4E435354UL  // "TSCN"
+#define SCAN_FILE_VERSION 1
+#define SCAN_RSSI_BINS 8              // 10 dB bins: <= -91, -90..-81, ..., -40..-31, >= -30
+
+#define SCAN_RECORD_FLAG_PROBE 0x01   // Counts are probe-request devices, not BSSIDs
+
+struct __attribute__((packed)) ScanFileHeader {
+  uint32_t magic;           // SCAN_FILE_MAGIC
+  uint16_t version;         // SCAN_FILE_VERSION
+  uint16_t recordSize;      // sizeof(ScanRecord) when written
+  int32_t dayNumber;        // Days since 1970-01-01, 0 for the undated file
+  uint32_t recordCount;
+  uint16_t hourCounts[24];  // Records per UTC hour (undated file: all in hour 0)
+};
+
+struct __attribute__((packed)) ScanRecord {
+  uint32_t timestamp;       // Unix seconds at scan end, 0 = clock not synced
+  uint32_t uptimeMs;        // millis() at scan end
+  uint32_t scanIndex;       // Scans since boot, 1-based
+  uint32_t saltEpoch;       // Identifies the boot's hashing salt; dedup across epochs is meaningless
+  int16_t found;            // Detections, negative = scan error code
+  uint16_t unique;          // First sightings in the current cycle
+  uint16_t repeated;
+  uint8_t flags;            // SCAN_RECORD_FLAG_*
+  uint8_t reserved;
+  uint8_t rssiHistogram[SCAN_RSSI_BINS];  // Sightings per bin, saturating at 255
+};
+
+static_assert(sizeof(ScanFileHeader) == 64, "ScanFileHeader layout changed");
+static_assert(sizeof(ScanRecord) == 32, "ScanRecord layout changed");
+
+static inline uint8_t scanRssiBin(int8_t rssi) {
+  int bin = (rssi + 100) / 10;
+  if (bin < 0) return 0;
+  if (bin >= SCAN_RSSI_BINS) return SCAN_RSSI_BINS - 1;
+  return (uint8_t)bin;
+}
+
+static inline void scanRssiCount(uint8_t (&histogram)[SCAN_RSSI_BINS], int8_t rssi) {
+  uint8_t& bin = histogram[scanRssiBin(rssi)];
+  if (bin < 0xFF) bin++;
+}
+
+static inline void scanFileName(int32_t dayNumber, char* out, size_t size) {
+  CivilDate date = civilFromDays(dayNumber);
+  snprintf(out, size, "/scans/%04u-%02u-%02u.bin", date.year, date.month, date.day);
+}
@@ -0,0 +1,42 @@
+/*
+ * SdLogger - buffered append-only log file on the SD card
+ *
+ * Lines are copied into a preallocated RAM ring and the log file stays
+ * open. The ring is written out in whole SD_LOG_BLOCK_SIZE sectors, aligned
+ * to the file offset, once SD_LOG_FLUSH_THRESHOLD bytes are buffered; a
+ * partial tail is only written when SD_LOG_FLUSH_INTERVAL_MS passes or on
+ * an explicit sdLogFlush() (e.g. before a restart). Compared with
+ * open/println/close per line this avoids a FAT directory update and a
+ * read-modify-write of the last sector for every message.
+ *
+ * Single owner: all calls must come from one task (the SD task).
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SD_LOG_BLOCK_SIZE 512          // SD sector
+#define SD_LOG_BUFFER_SIZE 4096        // RAM ring, multiple of SD_LOG_BLOCK_SIZE
+#define SD_LOG_FLUSH_THRESHOLD 2048    // Buffered bytes that trigger a sector write
+#define SD_LOG_FLUSH_INTERVAL_MS 30000 // Max age of a buffered line before it is written
+
+// Open (or create) the log file for appending. Returns false if the card refuses.
+bool sdLogBegin(const char* path);
+
+// Buffer one line; CRLF is appended. Writes out sectors only when the ring is full.
+void sdLogAppend(const char* line);
+
+// Apply the size and time thresholds. Call periodically from the owning task.
+void sdLogService(uint32_t nowMs);
+
+// Write everything buffered, partial sector included, and sync the file.
+bool sdLogFlush();
+
+// Flush and close the file
+void sdLogEnd();
+
+size_t sdLogBuffered();
+uint32_t sdLogBlockWrites();   // Write calls issued to the card
+uint32_t sdLogBytesDropped();  // Lost to a full ring or a failed write
@@ -0,0 +1,61 @@
+/*
+ * SpscRing - lock-free single-producer / single-consumer ring buffer
+ *
+ * One task (or WiFi driver callback) pushes, exactly one other task pops.
+ * Storage is a fixed array; push() never blocks or allocates and simply
+ * reports failure when the ring is full so the producer can count a drop.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, size_t Capacity>
+class SpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "SpscRing capacity must be a power of two");
+
+ public:
+  SpscRing() : head_(0), tail_(0) {}
+
+  // Producer side
+  bool push(const T& item) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t tail = tail_.load(std::memory_order_acquire);
+    if (head - tail >= Capacity) return false;
+
+    items_[head & kMask] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side: copies up to `max` items into `out`, returns the count
+  size_t pop(T* out, size_t max) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    uint32_t head = head_.load(std::memory_order_acquire);
+    size_t n = 0;
+
+    while (tail != head && n < max) {
+      out[n++] = items_[tail & kMask];
+      tail++;
+    }
+    tail_.store(tail, std::memory_order_release);
+    return n;
+  }
+
+  // Approximate when called from neither side
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  static size_t capacity() { return Capacity; }
+
+ private:
+  static const uint32_t kMask = Capacity - 1;
+
+  T items_[Capacity];
+  std::atomic<uint32_t> head_;  // Written by producer only
+  std::atomic<uint32_t> tail_;  // Written by consumer only
+};
@@ -0,0 +1,67 @@
+/*
+ * StageProfiler - min/avg/p99/max latency histograms for pipeline stages
+ *
+ * Each stage keeps a count, sum, min and max plus a log-linear histogram:
+ * values 0..3 get a bucket each, every power of two above is split into
+ * four equal buckets, so a bucket spans at most 25% of its value across
+ * the whole uint32 range in PROFILE_BUCKETS 16-bit counters (~270 B per
+ * stage). Recording is a count-leading-zeros, a shift and an increment.
+ * A counter about to saturate halves the whole histogram, which keeps the
+ * shape and hence the percentiles.
+ *
+ * Units are the caller's: CPU cycles for short compute stages (frequency
+ * scaling does not change them), microseconds for I/O waits. The p99 of a
+ * summary is the upper edge of the bucket holding the 99th percentile,
+ * capped at the observed max.
+ *
+ * Pure logic, no Arduino dependency, no locking: the caller serialises
+ * writers and the reader.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PROFILE_BUCKETS 124  // 4 single-value buckets + 4 per power of two from 2^2 to 2^31
+
+struct ProfileStage {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint16_t histogram[PROFILE_BUCKETS];
+};
+
+struct ProfileSummary {
+  uint32_t count;
+  uint32_t min;
+  uint32_t avg;
+  uint32_t p99;
+  uint32_t max;
+};
+
+static inline uint8_t profileBucket(uint32_t value) {
+  if (value < 4) return (uint8_t)value;
+  uint8_t exponent = 31 - __builtin_clz(value);  // >= 2
+  return (uint8_t)((exponent - 1) * 4 + ((value >> (exponent - 2)) & 3));
+}
+
+// Largest value that lands in `bucket`
+uint32_t profileBucketUpper(uint8_t bucket);
+
+void profileReset(ProfileStage& stage);
+void profileSummarize(const ProfileStage& stage, ProfileSummary& out);
+
+static inline void profileRecord(ProfileStage& stage, uint32_t value) {
+  if (stage.count == 0 || value < stage.min) stage.min = value;
+  if (value > stage.max) stage.max = value;
+  stage.count++;
+  stage.sum += value;
+
+  uint16_t& bucket = stage.histogram[profileBucket(value)];
+  if (bucket == 0xFFFF) {
+    for (size_t i = 0; i < PROFILE_BUCKETS; i++) stage.histogram[i] >>= 1;
+  }
+  bucket++;
+}
@@ -0,0 +1,69 @@
+/*
+ * TimeService - wall clock derived from a monotonic timer, synced from network time
+ *
+ * The modem RTC (set by NITZ via AT+CTZU, or by AT+CNTP) is read once at
+ * boot and then only every TIME_RESYNC_INTERVAL_MS. In between, time is
+ * extrapolated from the monotonic microsecond counter (esp_timer), so a
+ * timestamp costs no AT round trip and no allocation.
+ *
+ * Drift correction: each resync compares network time elapsed against
+ * monotonic time elapsed since the start of the drift window. Readings
+ * have 1 s resolution, so a window must span TIME_DRIFT_MIN_WINDOW_S
+ * before it is trusted (error below ~50 ppm); estimates are smoothed and
+ * applied to the extrapolation. The anchor only moves when the clock is
+ * off by more than the reading resolution, so timestamps never jitter
+ * back and forth around a sync.
+ *
+ * Pure integer code, no Arduino dependency: callers pass the monotonic
+ * time in. The caller serialises access when several tasks read it.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIME_TEXT_MAX 24                  // "2025-12-02 10:30:45 UTC" + NUL
+#define TIME_DATE_TEXT_MAX 11             // "2025-12-02" + NUL
+#define TIME_NO_DAY -1                    // Day number before the first sync
+#define TIME_MIN_VALID_EPOCH 1704067200UL // 2024-01-01: anything older is an unset modem RTC
+#define TIME_DRIFT_MIN_WINDOW_S 21600     // Shortest window a drift estimate is taken from (6 h)
+#define TIME_DRIFT_MAX_PPM 500            // Larger apparent drift = network time was stepped
+#define TIME_STEP_THRESHOLD_MS 1000       // Re-anchor only beyond the reading resolution
+
+struct TimeSync {
+  uint64_t baseUs;       // Monotonic time of the anchor
+  uint64_t baseMs;       // Unix milliseconds at baseUs, 0 = never synced
+  uint64_t windowUs;     // Monotonic time at the start of the drift window
+  uint32_t windowEpoch;  // Network time at the start of the drift window, 0 = none yet
+  int32_t driftPpm;      // Monotonic clock error: true elapsed = elapsed * (1 + ppm / 1e6)
+  int32_t lastOffsetMs;  // Correction the last sync found (network - extrapolated)
+  int16_t tzQuarters;    // Local time zone from the network, quarter hours east of UTC
+  uint8_t driftValid;    // driftPpm holds at least one measurement
+  uint32_t syncs;        // Network readings applied (0 = running on a restored estimate)
+};
+
+// Parse +CCLK: "yy/MM/dd,hh:mm:ss+zz" into Unix seconds (UTC) and the
+// time zone in quarter hours. Rejects malformed lines and unset clocks.
+bool parseCclk(const char* line, uint32_t* epoch, int16_t* tzQuarters);
+
+// Feed one network time reading taken at nowUs
+void timeSyncApply(TimeSync& sync, uint32_t epoch, int16_t tzQuarters, uint64_t nowUs);
+
+// Seed the clock from a saved estimate (warm restart): the drift carries
+// over, the drift window restarts with the next network reading
+void timeSyncRestore(TimeSync& sync, uint32_t epoch, int32_t driftPpm, bool driftValid, int16_t tzQuarters,
+                     uint64_t nowUs);
+
+// Unix milliseconds at nowUs, 0 until the first sync
+uint64_t timeNowMs(const TimeSync& sync, uint64_t nowUs);
+
+// Local calendar day (days since 1970-01-01) of a Unix timestamp
+int32_t timeLocalDay(const TimeSync& sync, uint32_t epoch);
+
+// Local hour (hours since 1970-01-01 00:00 local); `/ 24` is timeLocalDay()
+int32_t timeLocalHour(const TimeSync& sync, uint32_t epoch);
+
+// "YYYY-MM-DD HH:MM:SS UTC" and "YYYY-MM-DD"; return `out`
+const char* formatUtc(uint32_t epoch, char* out, size_t size);
+const char* formatDay(int32_t day, char* out, size_t size);
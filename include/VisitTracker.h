@@ -0,0 +1,281 @@
+/*
+ * VisitTracker - incremental dwell-time and visit analytics over salted hashes
+ *
+ * A fixed table of Capacity devices, each with first/last seen, visit
+ * start and sighting count, plus an open-addressing index (hash -> entry).
+ * Entries sit on one of two lists ordered by last sighting:
+ *
+ *   active  visit in progress; moved to the head on every sighting
+ *   idle    visit closed (unseen for gapSeconds); kept until windowSeconds
+ *           after the last sighting, so a comeback counts as "returning"
+ *
+ * Expiry only ever looks at the list tails, which hold the oldest last
+ * sightings: a visit closes when its entry falls off the active tail, and
+ * the device is forgotten when it falls off the idle tail. A full table
+ * evicts the idle tail first (LRU), then the active tail. Every sighting
+ * is O(1) amortised and no report walks the table.
+ *
+ * Closed visits are folded into VisitStats (dwell histogram, pass-by vs
+ * lingering, new vs returning), which the owner takes and resets per
+ * report. Times are monotonic seconds supplied by the caller. Single
+ * owner, no locking, no heap.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "HashSet64.h"
+
+#define VISIT_DWELL_BINS 7  // <30 s, <1 min, <2 min, <5 min, <10 min, <30 min, longer
+
+struct VisitStats {
+  uint32_t newVisitors;        // Visits by a device not seen within the window
+  uint32_t returningVisitors;  // Visits by a device back within the window
+  uint32_t visitsClosed;
+  uint32_t passBy;             // Closed visits shorter than the linger threshold
+  uint32_t lingering;
+  uint32_t dwellTotalS;        // Sum over closed visits
+  uint32_t evictions;          // Devices dropped by a full table before their window ended
+  uint32_t dwellHistogram[VISIT_DWELL_BINS];
+};
+
+static inline uint8_t visitDwellBin(uint32_t dwellS) {
+  static const uint16_t kEdges[VISIT_DWELL_BINS - 1] = {30, 60, 120, 300, 600, 1800};
+  uint8_t bin = 0;
+  while (bin < VISIT_DWELL_BINS - 1 && dwellS >= kEdges[bin]) bin++;
+  return bin;
+}
+
+static inline void visitStatsMerge(VisitStats& into, const VisitStats& from) {
+  into.newVisitors += from.newVisitors;
+  into.returningVisitors += from.returningVisitors;
+  into.visitsClosed += from.visitsClosed;
+  into.passBy += from.passBy;
+  into.lingering += from.lingering;
+  into.dwellTotalS += from.dwellTotalS;
+  into.evictions += from.evictions;
+  for (size_t i = 0; i < VISIT_DWELL_BINS; i++) into.dwellHistogram[i] += from.dwellHistogram[i];
+}
+
+enum class VisitSighting : uint8_t {
+  New,        // First visit within the window
+  Returning,  // New visit after a closed one
+  Continuing  // Same visit
+};
+
+template <size_t Capacity>
+class VisitTracker {
+  static_assert(Capacity >= 8 && Capacity < 0xFFFF, "VisitTracker capacity must be 8..65534");
+
+ public:
+  static const size_t kCapacity = Capacity;
+
+  VisitTracker(uint32_t gapSeconds, uint32_t lingerSeconds, uint32_t windowSeconds) {
+    configure(gapSeconds, lingerSeconds, windowSeconds);
+    clear();
+  }
+
+  // Thresholds can change at any time; a window shorter than the gap is raised to it
+  void configure(uint32_t gapSeconds, uint32_t lingerSeconds, uint32_t windowSeconds) {
+    gap_ = gapSeconds;
+    linger_ = lingerSeconds;
+    window_ = windowSeconds < gapSeconds ? gapSeconds : windowSeconds;
+  }
+
+  void clear() {
+    memset(index_, 0xFF, sizeof(index_));
+    for (size_t i = 0; i < Capacity; i++) entries_[i].next = (uint16_t)(i + 1 < Capacity ? i + 1 : kNone);
+    free_ = 0;
+    lists_[kActive] = List();
+    lists_[kIdle] = List();
+    memset(&stats_, 0, sizeof(stats_));
+  }
+
+  VisitSighting record(uint64_t hash, uint32_t nowS) {
+    expire(nowS);
+
+    size_t slot = findSlot(hash);
+    if (index_[slot] != kNone) {
+      Entry& entry = entries_[index_[slot]];
+      uint16_t id = index_[slot];
+      entry.lastSeen = nowS;
+      if (entry.sightings < 0xFFFF) entry.sightings++;
+
+      unlink(id);
+      pushHead(kActive, id);
+      if (entry.list == kActive) return VisitSighting::Continuing;
+
+      // Back after a closed visit
+      entry.list = kActive;
+      entry.visitStart = nowS;
+      if (entry.visits < 0xFFFF) entry.visits++;
+      stats_.returningVisitors++;
+      return VisitSighting::Returning;
+    }
+
+    uint16_t id = allocate();
+    slot = findSlot(hash);  // Eviction may have shifted the probe chain
+    Entry& entry = entries_[id];
+    entry.hash = hash;
+    entry.firstSeen = nowS;
+    entry.lastSeen = nowS;
+    entry.visitStart = nowS;
+    entry.sightings = 1;
+    entry.visits = 1;
+    entry.list = kActive;
+    index_[slot] = id;
+    pushHead(kActive, id);
+    stats_.newVisitors++;
+    return VisitSighting::New;
+  }
+
+  // Close visits unseen for the gap and forget devices past the window.
+  // Called by record(); call it on idle ticks too so visits close on time.
+  void expire(uint32_t nowS) {
+    uint16_t id;
+    while ((id = lists_[kActive].tail) != kNone && nowS - entries_[id].lastSeen > gap_) {
+      closeVisit(entries_[id]);
+      unlink(id);
+      entries_[id].list = kIdle;
+      pushHead(kIdle, id);
+    }
+    while ((id = lists_[kIdle].tail) != kNone && nowS - entries_[id].lastSeen > window_) {
+      release(id);
+    }
+  }
+
+  // Counters since the last call; resets them
+  void takeStats(VisitStats& out) {
+    out = stats_;
+    memset(&stats_, 0, sizeof(stats_));
+  }
+
+  size_t active() const { return lists_[kActive].count; }
+  size_t tracked() const { return lists_[kActive].count + lists_[kIdle].count; }
+
+ private:
+  static const uint16_t kNone = 0xFFFF;
+  static const uint8_t kActive = 0;
+  static const uint8_t kIdle = 1;
+  static const size_t kIndexSize = hashSetCapacityFor(Capacity);
+  static const size_t kMask = kIndexSize - 1;
+  static const uint8_t kShift = 64 - hashSetLog2(kIndexSize);
+
+  struct Entry {
+    uint64_t hash;
+    uint32_t firstSeen;
+    uint32_t lastSeen;
+    uint32_t visitStart;
+    uint16_t sightings;
+    uint16_t visits;
+    uint16_t prev;
+    uint16_t next;
+    uint8_t list;
+  };
+
+  struct List {
+    List() : head(kNone), tail(kNone), count(0) {}
+    uint16_t head;
+    uint16_t tail;
+    uint16_t count;
+  };
+
+  static size_t homeSlot(uint64_t hash) { return (size_t)((hash * 0x9E3779B97F4A7C15ULL) >> kShift); }
+
+  size_t findSlot(uint64_t hash) const {
+    // Slot holding `hash`, or the empty slot where it would go
+    size_t slot = homeSlot(hash);
+    while (index_[slot] != kNone && entries_[index_[slot]].hash != hash) slot = (slot + 1) & kMask;
+    return slot;
+  }
+
+  void closeVisit(const Entry& entry) {
+    uint32_t dwell = entry.lastSeen - entry.visitStart;
+    stats_.visitsClosed++;
+    stats_.dwellTotalS += dwell;
+    stats_.dwellHistogram[visitDwellBin(dwell)]++;
+    if (dwell < linger_) {
+      stats_.passBy++;
+    } else {
+      stats_.lingering++;
+    }
+  }
+
+  uint16_t allocate() {
+    if (free_ == kNone) {
+      // Full: forget the least recently seen idle device, else cut the oldest visit short
+      uint16_t victim = lists_[kIdle].tail;
+      if (victim == kNone) {
+        victim = lists_[kActive].tail;
+        closeVisit(entries_[victim]);
+      }
+      stats_.evictions++;
+      release(victim);
+    }
+    uint16_t id = free_;
+    free_ = entries_[id].next;
+    return id;
+  }
+
+  void release(uint16_t id) {
+    unlink(id);
+    removeIndex(findSlot(entries_[id].hash));
+    entries_[id].next = free_;
+    free_ = id;
+  }
+
+  void removeIndex(size_t hole) {
+    // Linear-probing delete with backward shift: no tombstones to sweep later
+    size_t slot = hole;
+    for (;;) {
+      slot = (slot + 1) & kMask;
+      if (index_[slot] == kNone) break;
+      size_t home = homeSlot(entries_[index_[slot]].hash);
+      bool stays = hole <= slot ? (home > hole && home <= slot) : (home > hole || home <= slot);
+      if (!stays) {
+        index_[hole] = index_[slot];
+        hole = slot;
+      }
+    }
+    index_[hole] = kNone;
+  }
+
+  void pushHead(uint8_t list, uint16_t id) {
+    List& l = lists_[list];
+    Entry& entry = entries_[id];
+    entry.prev = kNone;
+    entry.next = l.head;
+    if (l.head != kNone) entries_[l.head].prev = id;
+    l.head = id;
+    if (l.tail == kNone) l.tail = id;
+    l.count++;
+  }
+
+  void unlink(uint16_t id) {
+    Entry& entry = entries_[id];
+    List& l = lists_[entry.list];
+    if (entry.prev != kNone) {
+      entries_[entry.prev].next = entry.next;
+    } else {
+      l.head = entry.next;
+    }
+    if (entry.next != kNone) {
+      entries_[entry.next].prev = entry.prev;
+    } else {
+      l.tail = entry.prev;
+    }
+    l.count--;
+  }
+
+  Entry entries_[Capacity];
+  uint16_t index_[kIndexSize];
+  uint16_t free_;
+  List lists_[2];
+  uint32_t gap_;
+  uint32_t linger_;
+  uint32_t window_;
+  VisitStats stats_;
+};
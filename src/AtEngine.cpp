@@ -0,0 +1,155 @@
+/*
+ * AtEngine - non-blocking AT command scheduler (see AtEngine.h)
+ */
+
+#include "AtEngine.h"
+
+#include <string.h>
+
+#define AT_RUN_POLL_MS 5  // Poll cadence inside run()
+
+AtEngine::AtEngine(Stream& stream)
+    : stream_(stream),
+      head_(0),
+      count_(0),
+      inFlight_(false),
+      sentAt_(0),
+      sentAtUs_(0),
+      rxLen_(0),
+      rxTruncated_(false),
+      urcHandler_(nullptr),
+      timingHook_(nullptr),
+      completed_(0),
+      timeouts_(0),
+      overflows_(0) {
+  payload_[0] = '\0';
+  rxLine_[0] = '\0';
+}
+
+bool AtEngine::submit(const char* command, const char* responsePrefix, uint32_t timeoutMs,
+                      AtCallback callback, void* ctx) {
+  if (count_ >= AT_QUEUE_DEPTH) return false;
+  if (strlen(command) >= AT_COMMAND_MAX) return false;
+
+  const char* prefix = responsePrefix ? responsePrefix : "";
+  if (strlen(prefix) >= AT_PREFIX_MAX) return false;
+
+  Command& slot = queue_[(head_ + count_) % AT_QUEUE_DEPTH];
+  strcpy(slot.text, command);
+  strcpy(slot.prefix, prefix);
+  slot.timeoutMs = timeoutMs;
+  slot.callback = callback;
+  slot.ctx = ctx;
+  count_++;
+  return true;
+}
+
+void AtEngine::poll() {
+  // 1. Assemble complete lines from whatever the UART has buffered
+  while (stream_.available() > 0) {
+    int c = stream_.read();
+    if (c < 0) break;
+
+    if (c == '\n') {
+      rxLine_[rxLen_] = '\0';
+      if (rxLen_ > 0 && rxLine_[rxLen_ - 1] == '\r') {
+        rxLine_[--rxLen_] = '\0';
+      }
+      if (rxTruncated_) overflows_++;
+      if (rxLen_ > 0) handleLine(rxLine_);
+      rxLen_ = 0;
+      rxTruncated_ = false;
+    } else if (rxLen_ < AT_LINE_MAX - 1) {
+      rxLine_[rxLen_++] = (char)c;
+    } else {
+      rxTruncated_ = true;
+    }
+  }
+
+  // 2. Expire the command in flight
+  if (inFlight_ && millis() - sentAt_ >= queue_[head_].timeoutMs) {
+    timeouts_++;
+    finish(AtResult::Timeout);
+  }
+
+  // 3. Transmit the next command once the line is free
+  if (!inFlight_ && count_ > 0) {
+    sendNext();
+  }
+}
+
+AtResult AtEngine::run(const char* command, const char* responsePrefix, uint32_t timeoutMs,
+                       char* payloadOut, size_t payloadSize) {
+  struct RunState {
+    bool done;
+    AtResult result;
+    char* out;
+    size_t size;
+  } state = {false, AtResult::Timeout, payloadOut, payloadSize};
+
+  AtCallback onDone = [](AtResult result, const char* payload, void* ctx) {
+    RunState* s = (RunState*)ctx;
+    s->done = true;
+    s->result = result;
+    if (s->out && s->size > 0) {
+      strncpy(s->out, payload, s->size - 1);
+      s->out[s->size - 1] = '\0';
+    }
+  };
+
+  if (!submit(command, responsePrefix, timeoutMs, onDone, &state)) {
+    return AtResult::Error;
+  }
+
+  while (!state.done) {
+    poll();
+    delay(AT_RUN_POLL_MS);
+  }
+  return state.result;
+}
+
+void AtEngine::sendNext() {
+  const Command& cmd = queue_[head_];
+  payload_[0] = '\0';
+  stream_.write((const uint8_t*)cmd.text, strlen(cmd.text));
+  stream_.write((const uint8_t*)"\r\n", 2);
+  inFlight_ = true;
+  sentAt_ = millis();
+  sentAtUs_ = micros();
+}
+
+void AtEngine::handleLine(const char* line) {
+  if (!inFlight_) {
+    if (urcHandler_) urcHandler_(line);
+    return;
+  }
+
+  const Command& cmd = queue_[head_];
+
+  if (strcmp(line, "OK") == 0) {
+    finish(AtResult::Ok);
+  } else if (strcmp(line, "ERROR") == 0 || strncmp(line, "+CME ERROR", 10) == 0) {
+    finish(AtResult::Error);
+  } else if (cmd.prefix[0] != '\0' && strncmp(line, cmd.prefix, strlen(cmd.prefix)) == 0) {
+    strncpy(payload_, line, AT_LINE_MAX - 1);
+    payload_[AT_LINE_MAX - 1] = '\0';
+  } else if (strcmp(line, cmd.text) == 0) {
+    // Command echo (ATE1) - ignore
+  } else if (urcHandler_) {
+    urcHandler_(line);
+  }
+}
+
+void AtEngine::finish(AtResult result) {
+  // Pop before the callback so it may submit follow-up commands
+  Command cmd = queue_[head_];
+  head_ = (head_ + 1) % AT_QUEUE_DEPTH;
+  count_--;
+  inFlight_ = false;
+  completed_++;
+  if (timingHook_) timingHook_(result, micros() - sentAtUs_);
+
+  if (cmd.callback) {
+    cmd.callback(result, payload_, cmd.ctx);
+  }
+}
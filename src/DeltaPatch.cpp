@@ -0,0 +1,173 @@
+/*
+ * DeltaPatch - op decoding and block assembly (see DeltaPatch.h)
+ */
+
+#include "DeltaPatch.h"
+
+#include <string.h>
+
+enum DeltaOp : uint8_t { OP_END = 0x00, OP_COPY = 0x01, OP_INSERT = 0x02 };
+
+static uint32_t readLe32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+const char* deltaPatchStatusName(DeltaPatchStatus status) {
+  switch (status) {
+    case DeltaPatchStatus::Running: return "running";
+    case DeltaPatchStatus::Done: return "done";
+    case DeltaPatchStatus::BadPatch: return "bad patch";
+    case DeltaPatchStatus::SourceError: return "source read failed";
+    case DeltaPatchStatus::WriteError: return "target write failed";
+  }
+  return "?";
+}
+
+DeltaPatchStatus DeltaPatch::begin(const DeltaPatchIo& io) {
+  io_ = io;
+  status_ = DeltaPatchStatus::BadPatch;
+  op_ = OP_END;
+  opRemaining_ = 0;
+  sourceCursor_ = 0;
+  produced_ = 0;
+  written_ = 0;
+  patchBytes_ = 0;
+  inputPos_ = 0;
+  inputLength_ = 0;
+
+  uint8_t raw[DELTA_PATCH_HEADER_SIZE];
+  if (!readExact(raw, sizeof(raw)) || readLe32(raw) != DELTA_PATCH_MAGIC) return status_;
+  header_.sourceSize = readLe32(raw + 4);
+  memcpy(header_.sourceSha256, raw + 8, 32);
+  header_.targetSize = readLe32(raw + 40);
+  memcpy(header_.targetSha256, raw + 44, 32);
+  if (header_.targetSize == 0) return status_;
+
+  status_ = DeltaPatchStatus::Running;
+  return status_;
+}
+
+DeltaPatchStatus DeltaPatch::step() {
+  if (status_ != DeltaPatchStatus::Running) return status_;
+
+  size_t filled = 0;
+  while (filled < DELTA_PATCH_BLOCK && status_ == DeltaPatchStatus::Running) {
+    if (opRemaining_ == 0) {
+      if (!nextOp()) break;
+      continue;
+    }
+    size_t length = DELTA_PATCH_BLOCK - filled;
+    if (length > opRemaining_) length = opRemaining_;
+
+    if (op_ == OP_COPY) {
+      if (!io_.readSource(io_.ctx, sourceCursor_, block_ + filled, length)) {
+        status_ = DeltaPatchStatus::SourceError;
+        return status_;
+      }
+      sourceCursor_ += length;
+    } else if (!readExact(block_ + filled, length)) {
+      status_ = DeltaPatchStatus::BadPatch;
+      return status_;
+    }
+    filled += length;
+    opRemaining_ -= length;
+  }
+  if (status_ != DeltaPatchStatus::Running && status_ != DeltaPatchStatus::Done) return status_;
+
+  if (filled) {
+    if (!io_.writeTarget(io_.ctx, block_, filled)) {
+      status_ = DeltaPatchStatus::WriteError;
+      return status_;
+    }
+    written_ += filled;
+  }
+  return status_;
+}
+
+// Decodes the next op into op_ / opRemaining_; false with status_ set at
+// END or on an error
+bool DeltaPatch::nextOp() {
+  uint8_t op;
+  if (!readByte(op)) {
+    status_ = DeltaPatchStatus::BadPatch;
+    return false;
+  }
+
+  if (op == OP_END) {
+    uint8_t trailing;
+    bool complete = produced_ == header_.targetSize && !readByte(trailing);
+    status_ = complete ? DeltaPatchStatus::Done : DeltaPatchStatus::BadPatch;
+    return false;
+  }
+
+  uint32_t length;
+  if (op == OP_COPY) {
+    uint32_t zigzag;
+    if (!readVarint(zigzag) || !readVarint(length)) {
+      status_ = DeltaPatchStatus::BadPatch;
+      return false;
+    }
+    int64_t offset = (int64_t)sourceCursor_ + ((zigzag & 1) ? -(int64_t)(zigzag >> 1) - 1 : (int64_t)(zigzag >> 1));
+    if (offset < 0 || offset + length > header_.sourceSize) {
+      status_ = DeltaPatchStatus::BadPatch;
+      return false;
+    }
+    sourceCursor_ = (uint32_t)offset;
+  } else if (op != OP_INSERT || !readVarint(length)) {
+    status_ = DeltaPatchStatus::BadPatch;
+    return false;
+  }
+
+  if (length == 0 || length > header_.targetSize - produced_) {
+    status_ = DeltaPatchStatus::BadPatch;
+    return false;
+  }
+  op_ = op;
+  opRemaining_ = length;
+  produced_ += length;
+  return true;
+}
+
+bool DeltaPatch::readByte(uint8_t& out) {
+  if (inputPos_ == inputLength_) {
+    inputLength_ = io_.readPatch(io_.ctx, input_, sizeof(input_));
+    inputPos_ = 0;
+    if (inputLength_ == 0) return false;
+  }
+  out = input_[inputPos_++];
+  patchBytes_++;
+  return true;
+}
+
+// LEB128, at most five bytes
+bool DeltaPatch::readVarint(uint32_t& out) {
+  out = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    uint8_t byte;
+    if (!readByte(byte)) return false;
+    if (shift == 28 && (byte & 0x70)) return false;  // Beyond 32 bits
+    out |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+// `length` bytes: the read-ahead first, the rest straight from the patch
+bool DeltaPatch::readExact(uint8_t* out, size_t length) {
+  size_t buffered = inputLength_ - inputPos_;
+  if (buffered > length) buffered = length;
+  memcpy(out, input_ + inputPos_, buffered);
+  inputPos_ += buffered;
+  patchBytes_ += buffered;
+  out += buffered;
+  length -= buffered;
+
+  while (length) {
+    size_t got = io_.readPatch(io_.ctx, out, length);
+    if (got == 0) return false;
+    patchBytes_ += got;
+    out += got;
+    length -= got;
+  }
+  return true;
+}
@@ -0,0 +1,75 @@
+/*
+ * FirmwareManifest - manifest parsing (see FirmwareManifest.h)
+ */
+
+#include "FirmwareManifest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "JsonScan.h"
+
+static int hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool readSha256(const char* value, uint8_t* out) {
+  char hex[65];
+  if (!jsonReadString(value, hex, sizeof(hex)) || strlen(hex) != 64) return false;
+  for (size_t i = 0; i < 32; i++) {
+    int high = hexDigit(hex[i * 2]);
+    int low = hexDigit(hex[i * 2 + 1]);
+    if (high < 0 || low < 0) return false;
+    out[i] = (uint8_t)(high << 4 | low);
+  }
+  return true;
+}
+
+ManifestStatus firmwareManifestParse(const char* json, FirmwareManifest& out) {
+  memset(&out, 0, sizeof(out));
+  const char* p = jsonSkipSpace(json);
+  if (jsonIsLiteral(p, "null")) return *jsonSkipSpace(p + 4) == '\0' ? ManifestStatus::None : ManifestStatus::Bad;
+
+  bool haveVersion = false, havePath = false, haveSize = false, haveHash = false;
+  JsonMembers members(json);
+  const char* key;
+  size_t keyLength;
+  const char* value;
+  while (members.next(key, keyLength, value)) {
+    if (jsonKeyIs(key, keyLength, "version")) {
+      haveVersion = jsonReadString(value, out.version, sizeof(out.version)) && out.version[0];
+    } else if (jsonKeyIs(key, keyLength, "path")) {
+      havePath = jsonReadString(value, out.path, sizeof(out.path)) && out.path[0];
+    } else if (jsonKeyIs(key, keyLength, "size")) {
+      char* end;
+      double size = strtod(value, &end);
+      haveSize = end != value && size >= 1 && size <= 4294967295.0 && size == (double)(uint32_t)size;
+      out.size = haveSize ? (uint32_t)size : 0;
+    } else if (jsonKeyIs(key, keyLength, "sha256")) {
+      haveHash = readSha256(value, out.sha256);
+    }
+  }
+  if (!members.ok() || !haveVersion || !havePath || !haveSize || !haveHash) return ManifestStatus::Bad;
+  return ManifestStatus::Ok;
+}
+
+void firmwareVersionKey(const char* version, char* out, size_t size) {
+  if (size == 0) return;
+  size_t i = 0;
+  for (; version[i] && i + 1 < size; i++) {
+    char c = version[i];
+    out[i] = strchr(".$#[]/", c) ? '_' : c;
+  }
+  out[i] = '\0';
+}
+
+const char* sha256Hex(const uint8_t* hash, size_t bytes, char* out, size_t size) {
+  if (size == 0) return out;
+  out[0] = '\0';
+  for (size_t i = 0; i < bytes && i * 2 + 2 < size; i++) snprintf(out + i * 2, 3, "%02x", hash[i]);
+  return out;
+}
@@ -0,0 +1,271 @@
+/*
+ * GpsParser - allocation-free parsing of SIM7600 GPS output (see GpsParser.h)
+ */
+
+#include "GpsParser.h"
+
+#include <stdio.h>
+#include <string.h>
+
+struct Field {
+  const char* text;
+  size_t len;
+};
+
+static bool nextField(const char*& cursor, Field& field) {
+  /*
+   * Split on ',' up to the end of the line or the NMEA '*' checksum marker.
+   * Returns false once no field is left.
+   */
+  if (cursor == NULL) return false;
+
+  field.text = cursor;
+  while (*cursor != '\0' && *cursor != ',' && *cursor != '*') cursor++;
+  field.len = cursor - field.text;
+
+  if (*cursor == ',') {
+    cursor++;
+  } else {
+    cursor = NULL;  // Last field
+  }
+  return true;
+}
+
+static bool parseDigits(const char* text, size_t len, uint32_t& value) {
+  value = 0;
+  if (len == 0) return false;
+  for (size_t i = 0; i < len; i++) {
+    if (text[i] < '0' || text[i] > '9') return false;
+    value = value * 10 + (text[i] - '0');
+  }
+  return true;
+}
+
+static bool parseDegreesMinutes(const Field& field, uint32_t maxDegrees, int32_t& e7) {
+  /*
+   * ddmm.mmmmmm / dddmm.mmmmmm -> degrees x 1e7 in integer math.
+   * Minutes are scaled to 1e6 first; degrees = minutes / 60, so
+   * minutesE6 * 10 / 60 == minutesE6 / 6 lands directly in 1e7 units.
+   */
+  const char* dot = (const char*)memchr(field.text, '.', field.len);
+  size_t wholeLen = dot ? (size_t)(dot - field.text) : field.len;
+
+  uint32_t whole;
+  if (wholeLen < 3 || !parseDigits(field.text, wholeLen, whole)) return false;
+
+  uint32_t degrees = whole / 100;
+  uint32_t minutes = whole % 100;
+  if (degrees > maxDegrees || minutes >= 60) return false;
+
+  uint32_t fraction = 0;
+  uint32_t scale = 1000000;
+  if (dot) {
+    const char* p = dot + 1;
+    const char* end = field.text + field.len;
+    for (; p < end && scale > 1; p++) {
+      if (*p < '0' || *p > '9') return false;
+      scale /= 10;
+      fraction += (*p - '0') * scale;
+    }
+  }
+
+  uint32_t minutesE6 = minutes * 1000000 + fraction;
+  int64_t value = (int64_t)degrees * 10000000 + (minutesE6 + 3) / 6;
+  if (value > (int64_t)maxDegrees * 10000000) return false;
+
+  e7 = (int32_t)value;
+  return true;
+}
+
+static bool parseHemisphere(const Field& field, char positive, char negative, int32_t& e7) {
+  if (field.len != 1) return false;
+  if (field.text[0] == negative) {
+    e7 = -e7;
+  } else if (field.text[0] != positive) {
+    return false;
+  }
+  return true;
+}
+
+static bool parseTime(const Field& field, GpsFix& fix) {
+  /*
+   * hhmmss[.s] - fractional seconds are dropped
+   */
+  uint32_t hhmmss;
+  if (field.len < 6 || !parseDigits(field.text, 6, hhmmss)) return false;
+
+  uint8_t hour = hhmmss / 10000;
+  uint8_t minute = (hhmmss / 100) % 100;
+  uint8_t second = hhmmss % 100;
+  if (hour > 23 || minute > 59 || second > 60) return false;
+
+  fix.hour = hour;
+  fix.minute = minute;
+  fix.second = second;
+  return true;
+}
+
+static bool parseDate(const Field& field, GpsFix& fix) {
+  /*
+   * ddmmyy (both +CGPSINFO and RMC)
+   */
+  uint32_t ddmmyy;
+  if (field.len != 6 || !parseDigits(field.text, 6, ddmmyy)) return false;
+
+  uint8_t day = ddmmyy / 10000;
+  uint8_t month = (ddmmyy / 100) % 100;
+  if (day < 1 || day > 31 || month < 1 || month > 12) return false;
+
+  fix.day = day;
+  fix.month = month;
+  fix.year = 2000 + ddmmyy % 100;
+  return true;
+}
+
+static bool parseHdop(const Field& field, uint16_t& hdopX100) {
+  /*
+   * "1.23" -> 123
+   */
+  uint32_t value = 0;
+  int decimals = -1;
+  for (size_t i = 0; i < field.len; i++) {
+    char c = field.text[i];
+    if (c == '.') {
+      if (decimals >= 0) return false;
+      decimals = 0;
+    } else if (c >= '0' && c <= '9') {
+      if (decimals >= 2) continue;
+      value = value * 10 + (c - '0');
+      if (decimals >= 0) decimals++;
+    } else {
+      return false;
+    }
+  }
+  if (field.len == 0) return false;
+
+  if (decimals < 0) decimals = 0;
+  for (; decimals < 2; decimals++) value *= 10;
+  hdopX100 = value > 0xFFFF ? 0xFFFF : (uint16_t)value;
+  return true;
+}
+
+static bool parsePosition(Field latField, Field latHemi, Field lonField, Field lonHemi,
+                          int32_t& latE7, int32_t& lonE7) {
+  return parseDegreesMinutes(latField, 90, latE7) && parseHemisphere(latHemi, 'N', 'S', latE7) &&
+         parseDegreesMinutes(lonField, 180, lonE7) && parseHemisphere(lonHemi, 'E', 'W', lonE7);
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+static bool checksumValid(const char* line) {
+  /*
+   * XOR of every byte between '$' and '*' must equal the two hex digits after '*'
+   */
+  uint8_t sum = 0;
+  const char* p = line + 1;
+  while (*p != '\0' && *p != '*') sum ^= (uint8_t)*p++;
+  if (*p != '*') return false;
+
+  int hi = hexValue(p[1]);
+  int lo = hi >= 0 ? hexValue(p[2]) : -1;
+  return lo >= 0 && (uint8_t)(hi << 4 | lo) == sum;
+}
+
+bool parseCgpsInfo(const char* line, GpsFix& fix) {
+  /*
+   * +CGPSINFO: <lat>,<N/S>,<lon>,<E/W>,<date>,<UTC time>,<alt>,<speed>,<course>
+   * All fields are empty (",,,,,,,,") until the first fix.
+   */
+  static const char kPrefix[] = "+CGPSINFO:";
+  if (strncmp(line, kPrefix, sizeof(kPrefix) - 1) != 0) return false;
+
+  const char* cursor = line + sizeof(kPrefix) - 1;
+  while (*cursor == ' ') cursor++;
+
+  Field f[6];
+  for (int i = 0; i < 6; i++) {
+    if (!nextField(cursor, f[i])) return false;
+  }
+
+  int32_t latE7, lonE7;
+  if (!parsePosition(f[0], f[1], f[2], f[3], latE7, lonE7)) return false;
+
+  GpsFix parsed = fix;
+  parsed.latE7 = latE7;
+  parsed.lonE7 = lonE7;
+  parsed.quality = GPS_QUALITY_GPS;
+  parsed.valid = true;
+  if (!parseDate(f[4], parsed) || !parseTime(f[5], parsed)) {
+    parsed.year = 0;  // Position without a usable timestamp
+  }
+
+  fix = parsed;
+  return true;
+}
+
+bool parseNmea(const char* line, GpsFix& fix) {
+  /*
+   * $--GGA,time,lat,N,lon,E,quality,sats,hdop,alt,M,...*hh
+   * $--RMC,time,status,lat,N,lon,E,speed,course,date,...*hh
+   * Any talker ID is accepted (GP, GN, GL, ...).
+   */
+  if (line[0] != '$' || strlen(line) < 7 || line[6] != ',') return false;
+  if (!checksumValid(line)) return false;
+
+  bool isGga = strncmp(line + 3, "GGA", 3) == 0;
+  bool isRmc = strncmp(line + 3, "RMC", 3) == 0;
+  if (!isGga && !isRmc) return false;
+
+  const char* cursor = line + 7;
+  Field f[10];
+  int count = 0;
+  while (count < 10 && nextField(cursor, f[count])) count++;
+
+  GpsFix parsed = fix;
+  int32_t latE7, lonE7;
+
+  if (isGga) {
+    if (count < 8) return false;
+
+    uint32_t quality, satellites;
+    if (!parseDigits(f[5].text, f[5].len, quality) || quality == GPS_QUALITY_NONE) return false;
+    if (!parsePosition(f[1], f[2], f[3], f[4], latE7, lonE7)) return false;
+
+    parsed.quality = quality > 0xFF ? 0xFF : (uint8_t)quality;
+    if (parseDigits(f[6].text, f[6].len, satellites)) {
+      parsed.satellites = satellites > 0xFF ? 0xFF : (uint8_t)satellites;
+    }
+    parseHdop(f[7], parsed.hdopX100);
+    parseTime(f[0], parsed);
+  } else {
+    if (count < 9) return false;
+    if (f[1].len != 1 || f[1].text[0] != 'A') return false;  // 'V' = receiver warning, no fix
+    if (!parsePosition(f[2], f[3], f[4], f[5], latE7, lonE7)) return false;
+
+    if (parsed.quality == GPS_QUALITY_NONE) parsed.quality = GPS_QUALITY_GPS;
+    if (parseDate(f[8], parsed)) parseTime(f[0], parsed);
+  }
+
+  parsed.latE7 = latE7;
+  parsed.lonE7 = lonE7;
+  parsed.valid = true;
+  fix = parsed;
+  return true;
+}
+
+const char* formatCoordinate(int32_t e7, char* out, size_t size) {
+  /*
+   * Round 1e7 to 1e6 units and print without float formatting
+   */
+  uint32_t magnitude = e7 < 0 ? (uint32_t)(-(int64_t)e7) : (uint32_t)e7;
+  uint32_t micro = (magnitude + 5) / 10;
+
+  snprintf(out, size, "%s%u.%06u", e7 < 0 ? "-" : "", (unsigned)(micro / 1000000),
+           (unsigned)(micro % 1000000));
+  return out;
+}
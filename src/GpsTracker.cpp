@@ -0,0 +1,73 @@
+/*
+ * GpsTracker - settles GPS fixes into one billboard position (see GpsTracker.h)
+ */
+
+#include "GpsTracker.h"
+
+#include <math.h>
+#include <string.h>
+
+#define METERS_PER_DEGREE 111320.0f
+#define DEG_TO_RAD_F 0.017453292f
+
+static void restartMean(GpsTracker& tracker, const GpsFix& fix) {
+  tracker.samples = 1;
+  tracker.sumLatE7 = fix.latE7;
+  tracker.sumLonE7 = fix.lonE7;
+  tracker.latE7 = fix.latE7;
+  tracker.lonE7 = fix.lonE7;
+}
+
+void gpsTrackerReset(GpsTracker& tracker) {
+  memset(&tracker, 0, sizeof(tracker));
+  tracker.state = GPS_TRACK_SEARCHING;
+}
+
+bool gpsTrackerUpdate(GpsTracker& tracker, const GpsFix& fix) {
+  if (!fix.valid) return false;
+  if (fix.hdopX100 > GPS_MAX_HDOP_X100) return false;
+
+  if (tracker.state == GPS_TRACK_SEARCHING) {
+    restartMean(tracker, fix);
+    tracker.state = GPS_TRACK_LOCKED;
+    return true;
+  }
+
+  float distance = gpsDistanceMeters(tracker.latE7, tracker.lonE7, fix.latE7, fix.lonE7);
+
+  if (tracker.state == GPS_TRACK_STABLE) {
+    // Jitter around a frozen position changes nothing
+    if (distance <= GPS_MOVED_RADIUS_M) return false;
+    restartMean(tracker, fix);
+    tracker.state = GPS_TRACK_LOCKED;
+    return true;
+  }
+
+  if (distance > GPS_STABLE_RADIUS_M) {
+    restartMean(tracker, fix);
+    return true;
+  }
+
+  tracker.samples++;
+  tracker.sumLatE7 += fix.latE7;
+  tracker.sumLonE7 += fix.lonE7;
+  tracker.latE7 = (int32_t)(tracker.sumLatE7 / tracker.samples);
+  tracker.lonE7 = (int32_t)(tracker.sumLonE7 / tracker.samples);
+  if (tracker.samples >= GPS_STABLE_SAMPLES) tracker.state = GPS_TRACK_STABLE;
+  return true;
+}
+
+const char* gpsTrackStateName(uint8_t state) {
+  switch (state) {
+    case GPS_TRACK_LOCKED: return "LOCKED";
+    case GPS_TRACK_STABLE: return "STABLE";
+    default: return "SEARCHING";
+  }
+}
+
+float gpsDistanceMeters(int32_t latE7a, int32_t lonE7a, int32_t latE7b, int32_t lonE7b) {
+  float meanLat = ((float)latE7a + (float)latE7b) * 0.5e-7f * DEG_TO_RAD_F;
+  float dLat = (float)(latE7b - latE7a) * 1e-7f * METERS_PER_DEGREE;
+  float dLon = (float)(lonE7b - lonE7a) * 1e-7f * METERS_PER_DEGREE * cosf(meanLat);
+  return sqrtf(dLat * dLat + dLon * dLon);
+}
@@ -0,0 +1,365 @@
+/*
+ * ModemTlsClient - Client backed by the SIM7600 SSL stack (see ModemTlsClient.h)
+ */
+
+#include "ModemTlsClient.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODEM_TLS_START_TIMEOUT_MS 120000  // AT+CCHSTART activates the PDP context
+#define MODEM_TLS_LINE_MAX 96
+#define MODEM_TLS_TRAILER_MS 500           // Wait for the final result that follows a result line
+
+static bool startsWith(const char* line, const char* prefix) {
+  return strncmp(line, prefix, strlen(prefix)) == 0;
+}
+
+static bool isSession(const char* digits) {
+  return atoi(digits) == MODEM_TLS_SESSION;
+}
+
+ModemTlsClient::ModemTlsClient(Stream& stream)
+    : stream_(stream),
+      started_(false),
+      connected_(false),
+      peerClosed_(false),
+      rxEvent_(false),
+      lastPoll_(0),
+      txLen_(0),
+      rxLen_(0),
+      rxPos_(0),
+      opens_(0),
+      openFailures_(0) {}
+
+bool ModemTlsClient::begin() {
+  /*
+   * Receive mode must be set before the service starts. A service left
+   * running (modem not reset since a previous boot) refuses CCHSTART, so
+   * the second attempt stops it first.
+   */
+  if (started_) return true;
+
+  char cmd[64];
+  char line[MODEM_TLS_LINE_MAX];
+  for (int attempt = 0; attempt < 2 && !started_; attempt++) {
+    if (attempt > 0) command("AT+CCHSTOP", "+CCHSTOP:", MODEM_TLS_IO_TIMEOUT_MS);
+
+    command("AT+CCHSET=0,1", nullptr, MODEM_TLS_IO_TIMEOUT_MS);
+
+    // Any TLS version, no certificate check (same policy as setInsecure()), SNI for Google front ends
+    snprintf(cmd, sizeof(cmd), "AT+CSSLCFG=\"sslversion\",%d,4", MODEM_TLS_SSL_CONTEXT);
+    command(cmd, nullptr, MODEM_TLS_IO_TIMEOUT_MS);
+    snprintf(cmd, sizeof(cmd), "AT+CSSLCFG=\"authmode\",%d,0", MODEM_TLS_SSL_CONTEXT);
+    command(cmd, nullptr, MODEM_TLS_IO_TIMEOUT_MS);
+    snprintf(cmd, sizeof(cmd), "AT+CSSLCFG=\"ignorelocaltime\",%d,1", MODEM_TLS_SSL_CONTEXT);
+    command(cmd, nullptr, MODEM_TLS_IO_TIMEOUT_MS);
+    snprintf(cmd, sizeof(cmd), "AT+CSSLCFG=\"enableSNI\",%d,1", MODEM_TLS_SSL_CONTEXT);
+    command(cmd, nullptr, MODEM_TLS_IO_TIMEOUT_MS);
+
+    started_ = command("AT+CCHSTART", "+CCHSTART:", MODEM_TLS_START_TIMEOUT_MS, line, sizeof(line)) &&
+               atoi(line + strlen("+CCHSTART:")) == 0;
+  }
+  return started_;
+}
+
+void ModemTlsClient::handleUrc(const char* line) {
+  if (startsWith(line, "+CCHEVENT:")) {
+    if (isSession(line + strlen("+CCHEVENT:"))) rxEvent_ = true;
+  } else if (startsWith(line, "+CCH_PEER_CLOSED:")) {
+    if (isSession(line + strlen("+CCH_PEER_CLOSED:"))) peerClosed_ = rxEvent_ = true;
+  } else if (startsWith(line, "+CCH_RECV_CLOSED:")) {
+    if (isSession(line + strlen("+CCH_RECV_CLOSED:"))) peerClosed_ = rxEvent_ = true;
+  }
+}
+
+int ModemTlsClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port);
+}
+
+int ModemTlsClient::connect(const char* host, uint16_t port) {
+  /*
+   * DNS, TCP and the TLS handshake all happen inside AT+CCHOPEN; the
+   * result arrives as "+CCHOPEN: <id>,<err>" after the OK
+   */
+  if (connected_) stop();
+  if (!begin()) {
+    openFailures_++;
+    return 0;
+  }
+
+  char cmd[128];
+  char line[MODEM_TLS_LINE_MAX];
+  snprintf(cmd, sizeof(cmd), "AT+CCHSSLCFG=%d,%d", MODEM_TLS_SESSION, MODEM_TLS_SSL_CONTEXT);
+  command(cmd, nullptr, MODEM_TLS_IO_TIMEOUT_MS);
+
+  int n = snprintf(cmd, sizeof(cmd), "AT+CCHOPEN=%d,\"%s\",%u,2", MODEM_TLS_SESSION, host, port);
+  if (n <= 0 || (size_t)n >= sizeof(cmd)) {
+    openFailures_++;
+    return 0;
+  }
+
+  txLen_ = 0;
+  rxLen_ = rxPos_ = 0;
+  rxEvent_ = peerClosed_ = false;
+
+  if (!command(cmd, "+CCHOPEN:", MODEM_TLS_OPEN_TIMEOUT_MS, line, sizeof(line))) {
+    openFailures_++;
+    return 0;
+  }
+  const char* err = strchr(line, ',');
+  if (!err || atoi(err + 1) != 0) {
+    openFailures_++;
+    return 0;
+  }
+
+  connected_ = true;
+  lastPoll_ = millis();
+  opens_++;
+  return 1;
+}
+
+size_t ModemTlsClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t ModemTlsClient::write(const uint8_t* buf, size_t size) {
+  if (!connected_) return 0;
+
+  size_t written = 0;
+  while (written < size) {
+    size_t n = size - written;
+    if (n > MODEM_TLS_TX_BUFFER - txLen_) n = MODEM_TLS_TX_BUFFER - txLen_;
+    memcpy(tx_ + txLen_, buf + written, n);
+    txLen_ += n;
+    written += n;
+    if (txLen_ == MODEM_TLS_TX_BUFFER && !sendBuffered()) break;
+  }
+  return written;
+}
+
+int ModemTlsClient::available() {
+  if (rxPos_ < rxLen_) return rxLen_ - rxPos_;
+  if (!connected_) return 0;
+
+  // A read means the request is complete
+  if (txLen_ > 0 && !sendBuffered()) return 0;
+
+  if (rxEvent_ || millis() - lastPoll_ >= MODEM_TLS_POLL_MS) receive();
+  return rxLen_ - rxPos_;
+}
+
+int ModemTlsClient::read() {
+  if (available() <= 0) return -1;
+  return rx_[rxPos_++];
+}
+
+int ModemTlsClient::read(uint8_t* buf, size_t size) {
+  int avail = available();
+  if (avail <= 0) return -1;
+
+  size_t n = (size_t)avail < size ? (size_t)avail : size;
+  memcpy(buf, rx_ + rxPos_, n);
+  rxPos_ += n;
+  return n;
+}
+
+int ModemTlsClient::peek() {
+  if (available() <= 0) return -1;
+  return rx_[rxPos_];
+}
+
+void ModemTlsClient::flush() {
+  sendBuffered();
+}
+
+void ModemTlsClient::stop() {
+  if (connected_) {
+    char cmd[24];
+    snprintf(cmd, sizeof(cmd), "AT+CCHCLOSE=%d", MODEM_TLS_SESSION);
+    command(cmd, "+CCHCLOSE:", MODEM_TLS_IO_TIMEOUT_MS);
+  }
+  connected_ = false;
+  peerClosed_ = false;
+  txLen_ = 0;
+  rxLen_ = rxPos_ = 0;
+}
+
+uint8_t ModemTlsClient::connected() {
+  /*
+   * After the server closes, data may still sit in the modem cache; the
+   * connection only counts as closed once that has been drained.
+   */
+  if (rxPos_ < rxLen_) return 1;
+  if (connected_ && peerClosed_) {
+    receive();
+    if (rxPos_ >= rxLen_) stop();
+  }
+  return connected_ || rxPos_ < rxLen_;
+}
+
+bool ModemTlsClient::command(const char* text, const char* expect, uint32_t timeoutMs, char* lineOut,
+                             size_t lineSize) {
+  stream_.write((const uint8_t*)text, strlen(text));
+  stream_.write((const uint8_t*)"\r\n", 2);
+  if (!expect) return waitFor("OK", timeoutMs, lineOut, lineSize, nullptr);
+
+  // OK and the result line come in either order; never leave an OK behind for the AT engine
+  bool okSeen = false;
+  if (!waitFor(expect, timeoutMs, lineOut, lineSize, &okSeen)) return false;
+  if (!okSeen) waitFor("OK", MODEM_TLS_TRAILER_MS, nullptr, 0, nullptr);
+  return true;
+}
+
+bool ModemTlsClient::waitFor(const char* expect, uint32_t timeoutMs, char* lineOut, size_t lineSize,
+                             bool* okSeen) {
+  /*
+   * Read lines until one starts with `expect`. ERROR or the deadline
+   * ends the wait; URCs for this session are applied on the way.
+   */
+  uint32_t deadline = millis() + timeoutMs;
+  char line[MODEM_TLS_LINE_MAX];
+  for (;;) {
+    int len = readLine(line, sizeof(line), deadline);
+    if (len < 0) return false;
+    if (len == 0) continue;
+
+    if (startsWith(line, expect)) {
+      if (lineOut && lineSize > 0) {
+        strncpy(lineOut, line, lineSize - 1);
+        lineOut[lineSize - 1] = '\0';
+      }
+      return true;
+    }
+    if (strcmp(line, "ERROR") == 0) return false;
+    if (okSeen && strcmp(line, "OK") == 0) {
+      *okSeen = true;
+      continue;
+    }
+    handleUrc(line);
+  }
+}
+
+int ModemTlsClient::readLine(char* line, size_t size, uint32_t deadline) {
+  /*
+   * One CR/LF-terminated line, CR stripped; -1 on timeout. Overlong
+   * lines are truncated.
+   */
+  size_t len = 0;
+  for (;;) {
+    if (stream_.available() <= 0) {
+      if ((int32_t)(millis() - deadline) >= 0) return -1;
+      delay(1);
+      continue;
+    }
+
+    int c = stream_.read();
+    if (c < 0) continue;
+    if (c == '\n') break;
+    if (len < size - 1) line[len++] = (char)c;
+  }
+
+  if (len > 0 && line[len - 1] == '\r') len--;
+  line[len] = '\0';
+  return len;
+}
+
+bool ModemTlsClient::waitPrompt(uint32_t deadline) {
+  /*
+   * The CCHSEND prompt is a bare '>' with no line ending
+   */
+  char line[MODEM_TLS_LINE_MAX];
+  size_t len = 0;
+  for (;;) {
+    if (stream_.available() <= 0) {
+      if ((int32_t)(millis() - deadline) >= 0) return false;
+      delay(1);
+      continue;
+    }
+
+    int c = stream_.read();
+    if (c < 0) continue;
+    if (c == '>' && len == 0) return true;
+
+    if (c == '\n') {
+      if (len > 0 && line[len - 1] == '\r') len--;
+      line[len] = '\0';
+      if (strcmp(line, "ERROR") == 0) return false;
+      handleUrc(line);
+      len = 0;
+    } else if (len < sizeof(line) - 1) {
+      line[len++] = (char)c;
+    }
+  }
+}
+
+bool ModemTlsClient::sendBuffered() {
+  if (txLen_ == 0) return true;
+  if (!connected_) {
+    txLen_ = 0;
+    return false;
+  }
+
+  char cmd[32];
+  snprintf(cmd, sizeof(cmd), "AT+CCHSEND=%d,%u\r\n", MODEM_TLS_SESSION, (unsigned)txLen_);
+  stream_.write((const uint8_t*)cmd, strlen(cmd));
+
+  bool ok = waitPrompt(millis() + MODEM_TLS_IO_TIMEOUT_MS);
+  if (ok) {
+    stream_.write(tx_, txLen_);
+    ok = waitFor("OK", MODEM_TLS_IO_TIMEOUT_MS, nullptr, 0, nullptr);
+  }
+
+  txLen_ = 0;
+  if (!ok) connected_ = false;
+  return ok;
+}
+
+bool ModemTlsClient::receive() {
+  /*
+   * Pull up to MODEM_TLS_RX_BUFFER cached bytes. The data follows
+   * "+CCHRECV: DATA,<id>,<len>" raw (possibly in several chunks) and the
+   * transfer ends with "+CCHRECV: <id>,<err>". An empty cache answers
+   * with a non-zero <err> and ERROR.
+   */
+  lastPoll_ = millis();
+  rxEvent_ = false;
+  rxLen_ = rxPos_ = 0;
+
+  char cmd[32];
+  snprintf(cmd, sizeof(cmd), "AT+CCHRECV=%d,%d\r\n", MODEM_TLS_SESSION, MODEM_TLS_RX_BUFFER);
+  stream_.write((const uint8_t*)cmd, strlen(cmd));
+
+  uint32_t deadline = millis() + MODEM_TLS_IO_TIMEOUT_MS;
+  char line[MODEM_TLS_LINE_MAX];
+  for (;;) {
+    int len = readLine(line, sizeof(line), deadline);
+    if (len < 0) return rxLen_ > 0;
+    if (len == 0 || strcmp(line, "OK") == 0) continue;
+    if (strcmp(line, "ERROR") == 0) return rxLen_ > 0;
+
+    if (startsWith(line, "+CCHRECV: DATA,")) {
+      const char* count = strchr(line + strlen("+CCHRECV: DATA,"), ',');
+      size_t remaining = count ? (size_t)atoi(count + 1) : 0;
+      while (remaining > 0) {
+        if (stream_.available() <= 0) {
+          if ((int32_t)(millis() - deadline) >= 0) return rxLen_ > 0;
+          delay(1);
+          continue;
+        }
+        int c = stream_.read();
+        if (c < 0) continue;
+        if (rxLen_ < MODEM_TLS_RX_BUFFER) rx_[rxLen_++] = (uint8_t)c;
+        remaining--;
+      }
+    } else if (startsWith(line, "+CCHRECV:")) {
+      // Completion line; with <err> != 0 an ERROR follows - consume it here
+      const char* err = strchr(line, ',');
+      if (err && atoi(err + 1) != 0) waitFor("ERROR", MODEM_TLS_TRAILER_MS, nullptr, 0, nullptr);
+      return rxLen_ > 0;
+    } else {
+      handleUrc(line);
+    }
+  }
+}
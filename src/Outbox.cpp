@@ -0,0 +1,242 @@
+/*
+ * Outbox - persistent store-and-forward queue of cycle reports (see Outbox.h)
+ */
+
+#include "Outbox.h"
+
+#include <Arduino.h>
+#include <SD.h>
+
+#define OUTBOX_MAGIC 0x584F4254UL  // "TBOX"
+#define OUTBOX_VERSION 1
+
+struct __attribute__((packed)) OutboxHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t entrySize;
+  uint32_t capacity;
+  uint32_t head;      // Sequence number of the oldest unacknowledged entry
+  uint32_t tail;      // Sequence number the next push gets
+};
+
+enum BatchState : uint8_t {
+  BATCH_FREE = 0,
+  BATCH_IN_FLIGHT,
+  BATCH_FAILED,
+  BATCH_ACKED        // Delivered, waiting for an older batch before head can move
+};
+
+struct Batch {
+  uint32_t first;
+  uint16_t count;
+  uint8_t state;
+  uint32_t stamp;    // millis() when sent / failed
+};
+
+static File outboxFile;
+static OutboxHeader header;
+static Batch batches[OUTBOX_MAX_IN_FLIGHT];
+static uint32_t sendSeq = 0;  // First entry not yet assigned to any batch
+
+static uint32_t delivered = 0;
+static uint32_t overwritten = 0;
+
+static uint32_t entryOffset(uint32_t seq) {
+  return sizeof(OutboxHeader) + (seq % OUTBOX_CAPACITY) * sizeof(OutboxEntry);
+}
+
+static bool writeHeader() {
+  if (!outboxFile.seek(0)) return false;
+  if (outboxFile.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+  outboxFile.flush();
+  return true;
+}
+
+static bool readEntries(uint32_t seq, OutboxEntry* out, size_t count) {
+  /*
+   * Contiguous in sequence space, at most two spans in the file
+   */
+  while (count > 0) {
+    size_t span = OUTBOX_CAPACITY - seq % OUTBOX_CAPACITY;
+    if (span > count) span = count;
+
+    size_t bytes = span * sizeof(OutboxEntry);
+    if (!outboxFile.seek(entryOffset(seq)) || outboxFile.read((uint8_t*)out, bytes) != bytes) {
+      return false;
+    }
+    seq += span;
+    out += span;
+    count -= span;
+  }
+  return true;
+}
+
+static void advanceHead() {
+  /*
+   * Move head past every acknowledged batch that now starts at (or before) it
+   */
+  bool moved = true;
+  bool changed = false;
+  while (moved) {
+    moved = false;
+    for (size_t i = 0; i < OUTBOX_MAX_IN_FLIGHT; i++) {
+      Batch& batch = batches[i];
+      if (batch.state != BATCH_ACKED || batch.first > header.head) continue;
+
+      uint32_t end = batch.first + batch.count;
+      if (end > header.head) header.head = end;
+      batch.state = BATCH_FREE;
+      moved = true;
+      changed = true;
+    }
+  }
+
+  if (sendSeq < header.head) sendSeq = header.head;
+  if (changed) writeHeader();
+}
+
+bool outboxBegin() {
+  /*
+   * Reuse the ring if its layout matches; otherwise start an empty one
+   */
+  bool valid = false;
+  if (SD.exists(OUTBOX_PATH)) {
+    outboxFile = SD.open(OUTBOX_PATH, "r+");
+    valid = outboxFile && outboxFile.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == OUTBOX_MAGIC && header.version == OUTBOX_VERSION &&
+            header.entrySize == sizeof(OutboxEntry) && header.capacity == OUTBOX_CAPACITY &&
+            header.tail - header.head <= OUTBOX_CAPACITY;
+    if (!valid && outboxFile) outboxFile.close();
+  }
+
+  if (!valid) {
+    outboxFile = SD.open(OUTBOX_PATH, "w+");
+    if (!outboxFile) return false;
+    header.magic = OUTBOX_MAGIC;
+    header.version = OUTBOX_VERSION;
+    header.entrySize = sizeof(OutboxEntry);
+    header.capacity = OUTBOX_CAPACITY;
+    header.head = 0;
+    header.tail = 0;
+    if (!writeHeader()) {
+      outboxFile.close();
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < OUTBOX_MAX_IN_FLIGHT; i++) batches[i].state = BATCH_FREE;
+  sendSeq = header.head;
+  return true;
+}
+
+bool outboxPush(const OutboxEntry& entry) {
+  if (!outboxFile) return false;
+
+  if (header.tail - header.head >= OUTBOX_CAPACITY) {
+    header.head++;  // Ring full: the oldest entry gives way
+    overwritten++;
+    if (sendSeq < header.head) sendSeq = header.head;
+  }
+
+  if (!outboxFile.seek(entryOffset(header.tail)) ||
+      outboxFile.write((const uint8_t*)&entry, sizeof(entry)) != sizeof(entry)) {
+    return false;
+  }
+
+  header.tail++;
+  return writeHeader();
+}
+
+int outboxNextBatch(uint32_t nowMs, OutboxEntry (&out)[OUTBOX_BATCH], size_t* count, uint32_t* firstSeq) {
+  if (!outboxFile) return -1;
+
+  // Callbacks that never came count as failures
+  for (size_t i = 0; i < OUTBOX_MAX_IN_FLIGHT; i++) {
+    if (batches[i].state == BATCH_IN_FLIGHT && nowMs - batches[i].stamp >= OUTBOX_ACK_TIMEOUT_MS) {
+      batches[i].state = BATCH_FAILED;
+      batches[i].stamp = nowMs;
+    }
+  }
+
+  // Retries first, so delivery stays roughly in order
+  for (size_t i = 0; i < OUTBOX_MAX_IN_FLIGHT; i++) {
+    Batch& batch = batches[i];
+    if (batch.state != BATCH_FAILED || nowMs - batch.stamp < OUTBOX_RETRY_MS) continue;
+
+    // Entries overwritten by a full ring in the meantime are gone
+    if (batch.first < header.head) {
+      uint32_t lost = header.head - batch.first;
+      batch.count = lost >= batch.count ? 0 : batch.count - lost;
+      batch.first = header.head;
+    }
+    if (batch.count == 0) {
+      batch.state = BATCH_FREE;
+      continue;
+    }
+    if (!readEntries(batch.first, out, batch.count)) return -1;
+
+    batch.state = BATCH_IN_FLIGHT;
+    batch.stamp = nowMs;
+    *count = batch.count;
+    *firstSeq = batch.first;
+    return (int)i;
+  }
+
+  if (sendSeq >= header.tail) return -1;
+
+  for (size_t i = 0; i < OUTBOX_MAX_IN_FLIGHT; i++) {
+    Batch& batch = batches[i];
+    if (batch.state != BATCH_FREE) continue;
+
+    size_t n = header.tail - sendSeq;
+    if (n > OUTBOX_BATCH) n = OUTBOX_BATCH;
+    if (!readEntries(sendSeq, out, n)) return -1;
+
+    batch.first = sendSeq;
+    batch.count = n;
+    batch.state = BATCH_IN_FLIGHT;
+    batch.stamp = nowMs;
+    sendSeq += n;
+    *count = n;
+    *firstSeq = batch.first;
+    return (int)i;
+  }
+  return -1;
+}
+
+void outboxAck(int batch, uint32_t firstSeq) {
+  if (batch < 0 || batch >= OUTBOX_MAX_IN_FLIGHT || batches[batch].first != firstSeq) return;
+  if (batches[batch].state != BATCH_IN_FLIGHT && batches[batch].state != BATCH_FAILED) return;
+
+  batches[batch].state = BATCH_ACKED;
+  delivered += batches[batch].count;
+  advanceHead();
+}
+
+void outboxFail(int batch, uint32_t firstSeq, uint32_t nowMs) {
+  if (batch < 0 || batch >= OUTBOX_MAX_IN_FLIGHT || batches[batch].first != firstSeq) return;
+  if (batches[batch].state != BATCH_IN_FLIGHT) return;
+
+  batches[batch].state = BATCH_FAILED;
+  batches[batch].stamp = nowMs;
+}
+
+size_t outboxPending() {
+  return header.tail - header.head;
+}
+
+size_t outboxInFlight() {
+  size_t inFlight = 0;
+  for (size_t i = 0; i < OUTBOX_MAX_IN_FLIGHT; i++) {
+    if (batches[i].state == BATCH_IN_FLIGHT) inFlight++;
+  }
+  return inFlight;
+}
+
+uint32_t outboxDelivered() {
+  return delivered;
+}
+
+uint32_t outboxOverwritten() {
+  return overwritten;
+}
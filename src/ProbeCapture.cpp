@@ -0,0 +1,100 @@
+/*
+ * ProbeCapture - promiscuous-mode probe-request capture (see ProbeCapture.h)
+ */
+
+#include "ProbeCapture.h"
+
+#include <Arduino.h>
+#include <esp_wifi.h>
+#include <string.h>
+#include "SpscRing.h"
+
+// 802.11 frame control byte 0 for management / probe request (subtype 4)
+#define FRAME_CTRL_PROBE_REQUEST 0x40
+#define MGMT_HEADER_LEN 24
+#define MGMT_ADDR2_OFFSET 10  // Transmitter (source) address
+
+static SpscRing<ProbeSighting, PROBE_RING_CAPACITY> probeRing;
+static volatile uint32_t probeFrames = 0;
+static volatile uint32_t probeDropped = 0;
+
+static const uint8_t hopChannels[] = PROBE_HOP_CHANNELS;
+static uint8_t hopIndex = 0;
+static uint32_t lastHopTime = 0;
+static bool captureActive = false;
+
+static void IRAM_ATTR onPromiscuousPacket(void* buf, wifi_promiscuous_pkt_type_t type) {
+  /*
+   * Runs in the WiFi driver task for every management frame on the channel.
+   * Must stay allocation-free and short: filter, copy 8 bytes, push.
+   */
+  if (type != WIFI_PKT_MGMT) return;
+
+  const wifi_promiscuous_pkt_t* pkt = (const wifi_promiscuous_pkt_t*)buf;
+  if (pkt->rx_ctrl.sig_len < MGMT_HEADER_LEN) return;
+
+  const uint8_t* frame = pkt->payload;
+  if (frame[0] != FRAME_CTRL_PROBE_REQUEST) return;
+
+  ProbeSighting sighting;
+  memcpy(sighting.mac, frame + MGMT_ADDR2_OFFSET, 6);
+  sighting.rssi = (int8_t)pkt->rx_ctrl.rssi;
+  sighting.channel = (uint8_t)pkt->rx_ctrl.channel;
+
+  if (probeRing.push(sighting)) {
+    probeFrames++;
+  } else {
+    probeDropped++;
+  }
+}
+
+bool probeCaptureBegin() {
+  /*
+   * Put the STA interface into promiscuous mode, management frames only
+   */
+  wifi_promiscuous_filter_t filter;
+  filter.filter_mask = WIFI_PROMIS_FILTER_MASK_MGMT;
+
+  if (esp_wifi_set_promiscuous_filter(&filter) != ESP_OK) return false;
+  if (esp_wifi_set_promiscuous_rx_cb(&onPromiscuousPacket) != ESP_OK) return false;
+  if (esp_wifi_set_promiscuous(true) != ESP_OK) return false;
+
+  hopIndex = 0;
+  lastHopTime = millis();
+  esp_wifi_set_channel(hopChannels[hopIndex], WIFI_SECOND_CHAN_NONE);
+  captureActive = true;
+  return true;
+}
+
+void probeCaptureEnd() {
+  esp_wifi_set_promiscuous(false);
+  esp_wifi_set_promiscuous_rx_cb(NULL);
+  captureActive = false;
+}
+
+void probeCaptureHop(uint32_t nowMs) {
+  /*
+   * Rotate through PROBE_HOP_CHANNELS, PROBE_CHANNEL_DWELL_MS each
+   */
+  if (!captureActive || nowMs - lastHopTime < PROBE_CHANNEL_DWELL_MS) return;
+
+  hopIndex = (hopIndex + 1) % sizeof(hopChannels);
+  esp_wifi_set_channel(hopChannels[hopIndex], WIFI_SECOND_CHAN_NONE);
+  lastHopTime = nowMs;
+}
+
+size_t probeCaptureDrain(ProbeSighting* out, size_t max) {
+  return probeRing.pop(out, max);
+}
+
+uint32_t probeCaptureFrames() {
+  return probeFrames;
+}
+
+uint32_t probeCaptureDropped() {
+  return probeDropped;
+}
+
+size_t probeCaptureBacklog() {
+  return probeRing.size();
+}
@@ -0,0 +1,41 @@
+/*
+ * Proximity - RSSI distance bands via a lookup table (see Proximity.h)
+ */
+
+#include "Proximity.h"
+
+#include <math.h>
+
+static int8_t thresholdRssi(const ProximityCalibration& calibration, uint16_t meters) {
+  float rssi = calibration.rssiAt1m - calibration.pathLossX10 * log10f((float)meters);
+  if (rssi < -128.0f) return -128;
+  return (int8_t)lroundf(rssi);
+}
+
+bool proximityCalibrationValid(const ProximityCalibration& calibration) {
+  return calibration.rssiAt1m >= -90 && calibration.rssiAt1m <= 0 && calibration.pathLossX10 >= 10 &&
+         calibration.pathLossX10 <= 60 && calibration.viewingM >= 1 && calibration.nearbyM > calibration.viewingM;
+}
+
+void proximityTableBuild(ProximityTable& table, const ProximityCalibration& calibration) {
+  table.viewingRssi = thresholdRssi(calibration, calibration.viewingM);
+  table.nearbyRssi = thresholdRssi(calibration, calibration.nearbyM);
+
+  for (int rssi = -128; rssi <= 127; rssi++) {
+    uint8_t band = PROXIMITY_FAR;
+    if (rssi >= table.viewingRssi) {
+      band = PROXIMITY_VIEWING;
+    } else if (rssi >= table.nearbyRssi) {
+      band = PROXIMITY_NEARBY;
+    }
+    table.band[(uint8_t)rssi] = band;
+  }
+}
+
+const char* proximityBandName(uint8_t band) {
+  switch (band) {
+    case PROXIMITY_VIEWING: return "viewing";
+    case PROXIMITY_NEARBY: return "nearby";
+    default: return "far";
+  }
+}
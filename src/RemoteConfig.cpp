@@ -0,0 +1,171 @@
+/*
+ * RemoteConfig - parsing and validation of the config node (see RemoteConfig.h)
+ */
+
+#include "RemoteConfig.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "JsonScan.h"
+
+enum ConfigMember : uint8_t {
+  MEMBER_SCAN_INTERVAL = 0,
+  MEMBER_SCANS_PER_UPLOAD,
+  MEMBER_UPLOAD_INTERVAL_MAX,
+  MEMBER_RESTART_INTERVAL,
+  MEMBER_RSSI_1M,
+  MEMBER_LOSS_X10,
+  MEMBER_VIEWING_M,
+  MEMBER_NEARBY_M,
+  MEMBER_PROFILING,
+  MEMBER_COUNT
+};
+
+struct MemberSpec {
+  const char* key;
+  long min;
+  long max;
+};
+
+// Per-member ranges; the proximity members only need to fit their fields
+// here, proximityCalibrationValid() judges the set
+static const MemberSpec kMembers[MEMBER_COUNT] = {
+    {"scan_interval_ms", CONFIG_SCAN_INTERVAL_MIN_MS, CONFIG_SCAN_INTERVAL_MAX_MS},
+    {"scans_per_upload", 1, CONFIG_SCANS_PER_UPLOAD_MAX},
+    {"upload_interval_max_s", CONFIG_UPLOAD_INTERVAL_MIN_S, CONFIG_UPLOAD_INTERVAL_MAX_S},
+    {"restart_interval_h", 0, CONFIG_RESTART_INTERVAL_MAX_H},
+    {"rssi_1m", -128, 127},
+    {"loss_x10", 0, 255},
+    {"viewing_m", 0, 65535},
+    {"nearby_m", 0, 65535},
+    {"profiling", 0, 1},
+};
+
+enum MemberState : uint8_t {
+  MEMBER_ABSENT = 0,  // Not in the object, or null
+  MEMBER_SET,         // Integer or boolean in `value`
+  MEMBER_BAD          // Some other type
+};
+
+struct ParsedMember {
+  uint8_t state;
+  long value;
+};
+
+// Reads a recognised member's value. Integral numbers and booleans are SET,
+// null stays ABSENT, anything else is BAD.
+static void readValue(const char* p, ParsedMember& member) {
+  if (jsonIsLiteral(p, "null")) {
+    member.state = MEMBER_ABSENT;
+    return;
+  }
+  if (jsonIsLiteral(p, "true") || jsonIsLiteral(p, "false")) {
+    member.state = MEMBER_SET;
+    member.value = *p == 't';
+    return;
+  }
+
+  char* end;
+  double number = strtod(p, &end);
+  if (end != p && number >= -2147483648.0 && number <= 2147483647.0 && number == (double)(long)number) {
+    member.state = MEMBER_SET;
+    member.value = (long)number;
+    return;
+  }
+  member.state = MEMBER_BAD;
+}
+
+static int findMember(const char* key, size_t length) {
+  for (int i = 0; i < MEMBER_COUNT; i++) {
+    if (jsonKeyIs(key, length, kMembers[i].key)) return i;
+  }
+  return -1;
+}
+
+// Current when absent or rejected, else the parsed value
+static long resolve(const ParsedMember* parsed, int member, long currentValue, RemoteConfigResult& result) {
+  const ParsedMember& m = parsed[member];
+  if (m.state == MEMBER_ABSENT) return currentValue;
+  if (m.state == MEMBER_SET && m.value >= kMembers[member].min && m.value <= kMembers[member].max) return m.value;
+  result.rejected++;
+  return currentValue;
+}
+
+RemoteConfigResult remoteConfigParse(const char* json, const RuntimeConfig& current, RuntimeConfig& next) {
+  RemoteConfigResult result = {false, 0, 0, 0};
+  ParsedMember parsed[MEMBER_COUNT];
+  memset(parsed, 0, sizeof(parsed));
+  next = current;
+
+  const char* p = jsonSkipSpace(json);
+  if (jsonIsLiteral(p, "null")) {
+    // No config node: nothing to change
+    if (*jsonSkipSpace(p + 4) != '\0') return result;
+  } else {
+    JsonMembers members(json);
+    const char* key;
+    size_t keyLength;
+    const char* value;
+    while (members.next(key, keyLength, value)) {
+      int member = findMember(key, keyLength);
+      if (member < 0) continue;
+      result.known++;
+      readValue(value, parsed[member]);
+    }
+    if (!members.ok()) return result;
+  }
+
+  next.scanIntervalMs = resolve(parsed, MEMBER_SCAN_INTERVAL, current.scanIntervalMs, result);
+  next.scansPerUpload = resolve(parsed, MEMBER_SCANS_PER_UPLOAD, current.scansPerUpload, result);
+  next.uploadIntervalMaxS = resolve(parsed, MEMBER_UPLOAD_INTERVAL_MAX, current.uploadIntervalMaxS, result);
+  next.restartIntervalH = resolve(parsed, MEMBER_RESTART_INTERVAL, current.restartIntervalH, result);
+  next.proximity.rssiAt1m = resolve(parsed, MEMBER_RSSI_1M, current.proximity.rssiAt1m, result);
+  next.proximity.pathLossX10 = resolve(parsed, MEMBER_LOSS_X10, current.proximity.pathLossX10, result);
+  next.proximity.viewingM = resolve(parsed, MEMBER_VIEWING_M, current.proximity.viewingM, result);
+  next.proximity.nearbyM = resolve(parsed, MEMBER_NEARBY_M, current.proximity.nearbyM, result);
+  next.profiling = resolve(parsed, MEMBER_PROFILING, current.profiling, result) != 0;
+
+  // A cycle longer than the longest report gap would make every report late
+  if ((uint64_t)next.scanIntervalMs * next.scansPerUpload > (uint64_t)next.uploadIntervalMaxS * 1000) {
+    next.scanIntervalMs = current.scanIntervalMs;
+    next.scansPerUpload = current.scansPerUpload;
+    next.uploadIntervalMaxS = current.uploadIntervalMaxS;
+    result.rejected++;
+  }
+  if (!proximityCalibrationValid(next.proximity)) {
+    next.proximity = current.proximity;
+    result.rejected++;
+  }
+
+  result.valid = true;
+  result.changed = remoteConfigDiff(current, next);
+  return result;
+}
+
+bool remoteConfigValid(const RuntimeConfig& config) {
+  const long values[MEMBER_COUNT] = {(long)config.scanIntervalMs,     (long)config.scansPerUpload,
+                                     (long)config.uploadIntervalMaxS, (long)config.restartIntervalH,
+                                     config.proximity.rssiAt1m,       config.proximity.pathLossX10,
+                                     config.proximity.viewingM,       config.proximity.nearbyM,
+                                     config.profiling};
+  for (int i = 0; i < MEMBER_COUNT; i++) {
+    if (values[i] < kMembers[i].min || values[i] > kMembers[i].max) return false;
+  }
+  return (uint64_t)config.scanIntervalMs * config.scansPerUpload <= (uint64_t)config.uploadIntervalMaxS * 1000 &&
+         proximityCalibrationValid(config.proximity);
+}
+
+uint16_t remoteConfigDiff(const RuntimeConfig& a, const RuntimeConfig& b) {
+  uint16_t changed = 0;
+  if (a.scanIntervalMs != b.scanIntervalMs) changed |= CONFIG_SCAN_INTERVAL;
+  if (a.scansPerUpload != b.scansPerUpload) changed |= CONFIG_SCANS_PER_UPLOAD;
+  if (a.uploadIntervalMaxS != b.uploadIntervalMaxS) changed |= CONFIG_UPLOAD_INTERVAL_MAX;
+  if (a.restartIntervalH != b.restartIntervalH) changed |= CONFIG_RESTART_INTERVAL;
+  if (a.proximity.rssiAt1m != b.proximity.rssiAt1m || a.proximity.pathLossX10 != b.proximity.pathLossX10 ||
+      a.proximity.viewingM != b.proximity.viewingM || a.proximity.nearbyM != b.proximity.nearbyM) {
+    changed |= CONFIG_PROXIMITY;
+  }
+  if (a.profiling != b.profiling) changed |= CONFIG_PROFILING;
+  return changed;
+}
@@ -0,0 +1,55 @@
+/*
+ * ReportJson - upload body members (see ReportJson.h)
+ */
+
+#include "ReportJson.h"
+
+#include "CivilTime.h"
+#include "TimeService.h"
+
+bool reportJsonCycle(JsonWriter& json, const char* keyPrefix, const OutboxEntry& entry, uint32_t timestamp,
+                     bool compact) {
+  char date[TIME_DATE_TEXT_MAX] = "undated";
+  if (timestamp != 0) formatDay((int32_t)(timestamp / SECONDS_PER_DAY), date, sizeof(date));
+
+  if (compact) {
+    return json.member("\"%s%s/%08x-%u\":[%u,%u,%u,%u,%u]", keyPrefix, date, (unsigned)entry.bootId,
+                       (unsigned)entry.cycle, (unsigned)timestamp, (unsigned)entry.impressions,
+                       (unsigned)entry.networks, (unsigned)entry.unique, (unsigned)entry.repeated);
+  }
+  return json.member("\"%s%s/%08x-%u\":{\"ts\":%u,\"impressions\":%u,\"networks\":%u,\"unique\":%u,\"repeated\":%u}",
+                     keyPrefix, date, (unsigned)entry.bootId, (unsigned)entry.cycle, (unsigned)timestamp,
+                     (unsigned)entry.impressions, (unsigned)entry.networks, (unsigned)entry.unique,
+                     (unsigned)entry.repeated);
+}
+
+bool reportJsonVisits(JsonWriter& json, const char* date, uint32_t bootId, const VisitStats& v) {
+  static_assert(VISIT_DWELL_BINS == 7, "dwell_hist below lists seven bins");
+  return json.member("\"data/%s/visits/%08x\":{\"new\":%u,\"returning\":%u,\"ended\":%u,\"pass_by\":%u,"
+                     "\"lingering\":%u,\"dwell_s\":%u,\"evicted\":%u,\"dwell_hist\":[%u,%u,%u,%u,%u,%u,%u]}",
+                     date, (unsigned)bootId, (unsigned)v.newVisitors, (unsigned)v.returningVisitors,
+                     (unsigned)v.visitsClosed, (unsigned)v.passBy, (unsigned)v.lingering, (unsigned)v.dwellTotalS,
+                     (unsigned)v.evictions, (unsigned)v.dwellHistogram[0], (unsigned)v.dwellHistogram[1],
+                     (unsigned)v.dwellHistogram[2], (unsigned)v.dwellHistogram[3], (unsigned)v.dwellHistogram[4],
+                     (unsigned)v.dwellHistogram[5], (unsigned)v.dwellHistogram[6]);
+}
+
+bool reportJsonProximity(JsonWriter& json, const char* date, uint32_t bootId,
+                         const uint32_t (&bands)[PROXIMITY_BANDS]) {
+  static_assert(PROXIMITY_BANDS == 3, "proximity below lists three bands");
+  return json.member("\"data/%s/proximity/%08x\":{\"viewing\":%u,\"nearby\":%u,\"far\":%u}", date, (unsigned)bootId,
+                     (unsigned)bands[PROXIMITY_VIEWING], (unsigned)bands[PROXIMITY_NEARBY],
+                     (unsigned)bands[PROXIMITY_FAR]);
+}
+
+bool reportJsonMinute(JsonWriter& json, uint32_t bootId, const MinuteBucket& b, int32_t offsetS) {
+  static_assert(SCAN_RSSI_BINS == 8, "series entries below list eight RSSI bins");
+  int64_t local = (int64_t)b.minute * 60 + offsetS;
+  uint32_t minuteOfDay = (uint32_t)(local % SECONDS_PER_DAY) / 60;
+  char date[TIME_DATE_TEXT_MAX];
+  return json.member("\"series/%s/%08x/%02u%02u\":[%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u]",
+                     formatDay((int32_t)(local / SECONDS_PER_DAY), date, sizeof(date)), (unsigned)bootId,
+                     (unsigned)(minuteOfDay / 60), (unsigned)(minuteOfDay % 60), b.impressions, b.unique, b.scans,
+                     b.scanErrors, b.rssiHistogram[0], b.rssiHistogram[1], b.rssiHistogram[2], b.rssiHistogram[3],
+                     b.rssiHistogram[4], b.rssiHistogram[5], b.rssiHistogram[6], b.rssiHistogram[7]);
+}
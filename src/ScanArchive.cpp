@@ -0,0 +1,142 @@
+/*
+ * ScanArchive - per-day binary scan files on the SD card (see ScanArchive.h)
+ */
+
+#include "ScanArchive.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <string.h>
+
+#define UNDATED_DAY 0
+#define NO_DAY -1
+
+static File dayFile;
+static int32_t openDay = NO_DAY;
+static ScanFileHeader header;
+
+static ScanRecord batch[SCAN_ARCHIVE_BATCH];
+static size_t batchCount = 0;
+static int32_t batchDay = NO_DAY;
+static uint32_t lastFlushTime = 0;
+
+static uint32_t recordsWritten = 0;
+static uint32_t recordsDropped = 0;
+
+static int32_t recordDay(const ScanRecord& record) {
+  return record.timestamp ? (int32_t)(record.timestamp / SECONDS_PER_DAY) : UNDATED_DAY;
+}
+
+static void resetHeader(int32_t day) {
+  memset(&header, 0, sizeof(header));
+  header.magic = SCAN_FILE_MAGIC;
+  header.version = SCAN_FILE_VERSION;
+  header.recordSize = sizeof(ScanRecord);
+  header.dayNumber = day;
+}
+
+static bool openDayFile(int32_t day) {
+  /*
+   * Open (or create) the file for `day` read/write and load its header.
+   * A file with a foreign or older layout is replaced.
+   */
+  if (openDay == day && dayFile) return true;
+
+  if (dayFile) dayFile.close();
+  openDay = NO_DAY;
+
+  char path[32];
+  if (day == UNDATED_DAY) {
+    strcpy(path, SCAN_ARCHIVE_UNDATED_FILE);
+  } else {
+    scanFileName(day, path, sizeof(path));
+  }
+
+  bool valid = false;
+  if (SD.exists(path)) {
+    dayFile = SD.open(path, "r+");
+    valid = dayFile && dayFile.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == SCAN_FILE_MAGIC && header.version == SCAN_FILE_VERSION &&
+            header.recordSize == sizeof(ScanRecord) && header.dayNumber == day;
+    if (!valid && dayFile) dayFile.close();
+  }
+
+  if (!valid) {
+    dayFile = SD.open(path, "w+");
+    if (!dayFile) return false;
+    resetHeader(day);
+    if (dayFile.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+      dayFile.close();
+      return false;
+    }
+  }
+
+  openDay = day;
+  return true;
+}
+
+bool scanArchiveBegin() {
+  if (!SD.exists(SCAN_ARCHIVE_DIR) && !SD.mkdir(SCAN_ARCHIVE_DIR)) return false;
+  lastFlushTime = millis();
+  return true;
+}
+
+void scanArchiveAppend(const ScanRecord& record) {
+  int32_t day = recordDay(record);
+  if (batchCount > 0 && day != batchDay) scanArchiveFlush();
+
+  batch[batchCount++] = record;
+  batchDay = day;
+  if (batchCount == SCAN_ARCHIVE_BATCH) scanArchiveFlush();
+}
+
+void scanArchiveService(uint32_t nowMs) {
+  if (batchCount > 0 && nowMs - lastFlushTime >= SCAN_ARCHIVE_FLUSH_INTERVAL_MS) {
+    scanArchiveFlush();
+  }
+}
+
+bool scanArchiveFlush() {
+  /*
+   * Records first, header second - a torn write leaves the old header valid
+   */
+  lastFlushTime = millis();
+  if (batchCount == 0) return true;
+
+  size_t count = batchCount;
+  batchCount = 0;
+
+  if (!openDayFile(batchDay)) {
+    recordsDropped += count;
+    return false;
+  }
+
+  size_t bytes = count * sizeof(ScanRecord);
+  if (!dayFile.seek(sizeof(ScanFileHeader) + header.recordCount * sizeof(ScanRecord)) ||
+      dayFile.write((const uint8_t*)batch, bytes) != bytes) {
+    recordsDropped += count;
+    dayFile.close();
+    return false;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    uint32_t hour = batch[i].timestamp ? (batch[i].timestamp % SECONDS_PER_DAY) / 3600 : 0;
+    if (header.hourCounts[hour] < 0xFFFF) header.hourCounts[hour]++;
+  }
+  header.recordCount += count;
+
+  dayFile.seek(0);
+  dayFile.write((const uint8_t*)&header, sizeof(header));
+  dayFile.flush();
+
+  recordsWritten += count;
+  return true;
+}
+
+uint32_t scanArchiveRecordsWritten() {
+  return recordsWritten;
+}
+
+uint32_t scanArchiveRecordsDropped() {
+  return recordsDropped;
+}
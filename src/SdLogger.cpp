@@ -0,0 +1,143 @@
+/*
+ * SdLogger - buffered append-only log file on the SD card (see SdLogger.h)
+ */
+
+#include "SdLogger.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <string.h>
+
+static char ring[SD_LOG_BUFFER_SIZE];
+static size_t ringHead = 0;   // Oldest buffered byte
+static size_t ringCount = 0;
+
+static File logFile;
+static char logPath[32] = "";
+static uint32_t filePosition = 0;  // Bytes in the file, for sector alignment
+static uint32_t lastFlushTime = 0;
+
+static uint32_t blockWrites = 0;
+static uint32_t bytesDropped = 0;
+
+static bool openLogFile() {
+  logFile = SD.open(logPath, FILE_APPEND);
+  if (!logFile) return false;
+  filePosition = logFile.size();
+  // Keep ring offsets congruent to file offsets so a wrap also lands on a sector
+  if (ringCount == 0) ringHead = filePosition % SD_LOG_BLOCK_SIZE;
+  return true;
+}
+
+static void dropHead(size_t length) {
+  bytesDropped += length;
+  ringHead = (ringHead + length) % SD_LOG_BUFFER_SIZE;
+  ringCount -= length;
+}
+
+static void writeOut(size_t length) {
+  /*
+   * Write `length` bytes from the ring head; at most two calls if the
+   * span wraps. A failed write drops the data rather than retrying forever.
+   */
+  if (!logFile && !openLogFile()) {
+    dropHead(length);
+    return;
+  }
+
+  while (length > 0) {
+    size_t chunk = SD_LOG_BUFFER_SIZE - ringHead;
+    if (chunk > length) chunk = length;
+
+    size_t written = logFile.write((const uint8_t*)ring + ringHead, chunk);
+    blockWrites++;
+    if (written != chunk) {
+      bytesDropped += chunk - written;
+      logFile.close();  // Reopened on the next write (card reseated, etc.)
+    }
+
+    filePosition += written;
+    ringHead = (ringHead + chunk) % SD_LOG_BUFFER_SIZE;
+    ringCount -= chunk;
+    length -= chunk;
+    if (!logFile) {
+      dropHead(length);
+      return;
+    }
+  }
+}
+
+static void writeBlocks() {
+  /*
+   * Write only up to the last sector boundary of the file so every write
+   * ends on a sector and the card never sees a partial-sector update.
+   */
+  uint32_t end = filePosition + ringCount;
+  uint32_t alignedEnd = end - end % SD_LOG_BLOCK_SIZE;
+  if (alignedEnd <= filePosition) return;
+  writeOut(alignedEnd - filePosition);
+}
+
+bool sdLogBegin(const char* path) {
+  strncpy(logPath, path, sizeof(logPath) - 1);
+  logPath[sizeof(logPath) - 1] = '\0';
+  ringHead = 0;
+  ringCount = 0;
+  lastFlushTime = millis();
+  return openLogFile();
+}
+
+void sdLogAppend(const char* line) {
+  size_t length = strlen(line);
+  if (length > SD_LOG_BUFFER_SIZE - 2) length = SD_LOG_BUFFER_SIZE - 2;
+  size_t needed = length + 2;
+
+  if (SD_LOG_BUFFER_SIZE - ringCount < needed) writeBlocks();
+  if (SD_LOG_BUFFER_SIZE - ringCount < needed) writeOut(ringCount);
+  if (SD_LOG_BUFFER_SIZE - ringCount < needed) {
+    bytesDropped += needed;
+    return;
+  }
+
+  size_t tail = (ringHead + ringCount) % SD_LOG_BUFFER_SIZE;
+  for (size_t i = 0; i < length; i++) {
+    ring[(tail + i) % SD_LOG_BUFFER_SIZE] = line[i];
+  }
+  ring[(tail + length) % SD_LOG_BUFFER_SIZE] = '\r';
+  ring[(tail + length + 1) % SD_LOG_BUFFER_SIZE] = '\n';
+  ringCount += needed;
+}
+
+void sdLogService(uint32_t nowMs) {
+  if (ringCount >= SD_LOG_FLUSH_THRESHOLD) {
+    writeBlocks();
+  }
+  if (ringCount > 0 && nowMs - lastFlushTime >= SD_LOG_FLUSH_INTERVAL_MS) {
+    sdLogFlush();
+  }
+}
+
+bool sdLogFlush() {
+  lastFlushTime = millis();
+  if (ringCount > 0) writeOut(ringCount);
+  if (!logFile) return false;
+  logFile.flush();
+  return true;
+}
+
+void sdLogEnd() {
+  sdLogFlush();
+  logFile.close();
+}
+
+size_t sdLogBuffered() {
+  return ringCount;
+}
+
+uint32_t sdLogBlockWrites() {
+  return blockWrites;
+}
+
+uint32_t sdLogBytesDropped() {
+  return bytesDropped;
+}
@@ -0,0 +1,44 @@
+/*
+ * StageProfiler - stage histograms and summaries (see StageProfiler.h)
+ */
+
+#include "StageProfiler.h"
+
+#include <string.h>
+
+uint32_t profileBucketUpper(uint8_t bucket) {
+  if (bucket < 4) return bucket;
+  uint8_t exponent = bucket / 4 + 1;
+  uint32_t width = (uint32_t)1 << (exponent - 2);
+  uint32_t lower = (uint32_t)(4 + bucket % 4) << (exponent - 2);
+  return lower + (width - 1);
+}
+
+void profileReset(ProfileStage& stage) {
+  memset(&stage, 0, sizeof(stage));
+}
+
+void profileSummarize(const ProfileStage& stage, ProfileSummary& out) {
+  memset(&out, 0, sizeof(out));
+  if (stage.count == 0) return;
+
+  out.count = stage.count;
+  out.min = stage.min;
+  out.max = stage.max;
+  out.avg = (uint32_t)(stage.sum / stage.count);
+
+  // Histogram counts may have been halved: rank against their own total
+  uint32_t total = 0;
+  for (size_t i = 0; i < PROFILE_BUCKETS; i++) total += stage.histogram[i];
+  uint32_t rank = total - total / 100;  // Samples at or below the 99th percentile
+  uint32_t seen = 0;
+  for (size_t i = 0; i < PROFILE_BUCKETS; i++) {
+    seen += stage.histogram[i];
+    if (seen >= rank) {
+      uint32_t upper = profileBucketUpper((uint8_t)i);
+      out.p99 = upper < stage.max ? upper : stage.max;
+      return;
+    }
+  }
+  out.p99 = stage.max;
+}
@@ -0,0 +1,130 @@
+/*
+ * TimeService - wall clock derived from a monotonic timer (see TimeService.h)
+ */
+
+#include "TimeService.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CivilTime.h"
+
+#define QUARTER_HOUR_S 900
+
+bool parseCclk(const char* line, uint32_t* epoch, int16_t* tzQuarters) {
+  /*
+   * +CCLK: "25/12/02,10:30:45+20" is local time plus the zone offset in
+   * quarter hours; the zone is optional while the RTC has none set.
+   */
+  const char* quote = strchr(line, '"');
+  if (quote == NULL) return false;
+
+  unsigned year, month, day, hour, minute, second;
+  int consumed = 0;
+  if (sscanf(quote + 1, "%2u/%2u/%2u,%2u:%2u:%2u%n", &year, &month, &day, &hour, &minute, &second, &consumed) != 6) {
+    return false;
+  }
+  if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) return false;
+
+  int tz = 0;
+  const char* zone = quote + 1 + consumed;
+  if (*zone == '+' || *zone == '-') {
+    tz = atoi(zone);
+    if (tz < -47 || tz > 48) return false;
+  }
+
+  // Factory RTC reads "80/01/06": two-digit years from 70 are the 1900s and fail the validity floor
+  int32_t fullYear = year < 70 ? 2000 + year : 1900 + year;
+  int64_t local = (int64_t)daysFromCivil(fullYear, month, day) * SECONDS_PER_DAY + hour * 3600 + minute * 60 + second;
+  int64_t utc = local - (int64_t)tz * QUARTER_HOUR_S;
+  if (utc < (int64_t)TIME_MIN_VALID_EPOCH || utc > 0xFFFFFFFFLL) return false;
+
+  *epoch = (uint32_t)utc;
+  *tzQuarters = (int16_t)tz;
+  return true;
+}
+
+static int64_t correctedElapsedUs(const TimeSync& sync, uint64_t nowUs) {
+  int64_t elapsed = (int64_t)(nowUs - sync.baseUs);
+  return elapsed + elapsed / 1000000 * sync.driftPpm + elapsed % 1000000 * sync.driftPpm / 1000000;
+}
+
+void timeSyncApply(TimeSync& sync, uint32_t epoch, int16_t tzQuarters, uint64_t nowUs) {
+  // Readings are truncated to the second: the true time is half a second later on average
+  uint64_t sampleMs = (uint64_t)epoch * 1000 + 500;
+  sync.tzQuarters = tzQuarters;
+  sync.syncs++;
+
+  if (sync.baseMs == 0) {
+    sync.baseUs = nowUs;
+    sync.baseMs = sampleMs;
+    sync.windowUs = nowUs;
+    sync.windowEpoch = epoch;
+    sync.lastOffsetMs = 0;
+    return;
+  }
+  if (sync.windowEpoch == 0) {
+    sync.windowUs = nowUs;
+    sync.windowEpoch = epoch;
+  }
+
+  int64_t offset = (int64_t)sampleMs - (int64_t)timeNowMs(sync, nowUs);
+  sync.lastOffsetMs = offset > INT32_MAX ? INT32_MAX : (offset < INT32_MIN ? INT32_MIN : (int32_t)offset);
+
+  uint64_t window = nowUs - sync.windowUs;
+  if (window >= (uint64_t)TIME_DRIFT_MIN_WINDOW_S * 1000000) {
+    int64_t errorUs = ((int64_t)epoch - (int64_t)sync.windowEpoch) * 1000000 - (int64_t)window;
+    int64_t ppm = errorUs * 1000000 / (int64_t)window;
+
+    // An implausible rate means the network clock was stepped, not that the crystal drifted
+    if (ppm >= -TIME_DRIFT_MAX_PPM && ppm <= TIME_DRIFT_MAX_PPM) {
+      sync.driftPpm = sync.driftValid ? (sync.driftPpm * 3 + (int32_t)ppm) / 4 : (int32_t)ppm;
+      sync.driftValid = 1;
+    }
+    sync.windowUs = nowUs;
+    sync.windowEpoch = epoch;
+  }
+
+  if (offset > TIME_STEP_THRESHOLD_MS || offset < -TIME_STEP_THRESHOLD_MS) {
+    sync.baseUs = nowUs;
+    sync.baseMs = sampleMs;
+  }
+}
+
+void timeSyncRestore(TimeSync& sync, uint32_t epoch, int32_t driftPpm, bool driftValid, int16_t tzQuarters,
+                     uint64_t nowUs) {
+  memset(&sync, 0, sizeof(sync));
+  sync.baseUs = nowUs;
+  sync.baseMs = (uint64_t)epoch * 1000;
+  sync.driftPpm = driftPpm;
+  sync.driftValid = driftValid;
+  sync.tzQuarters = tzQuarters;
+}
+
+uint64_t timeNowMs(const TimeSync& sync, uint64_t nowUs) {
+  if (sync.baseMs == 0) return 0;
+  return sync.baseMs + correctedElapsedUs(sync, nowUs) / 1000;
+}
+
+int32_t timeLocalDay(const TimeSync& sync, uint32_t epoch) {
+  return (int32_t)(((int64_t)epoch + (int64_t)sync.tzQuarters * QUARTER_HOUR_S) / (int64_t)SECONDS_PER_DAY);
+}
+
+int32_t timeLocalHour(const TimeSync& sync, uint32_t epoch) {
+  return (int32_t)(((int64_t)epoch + (int64_t)sync.tzQuarters * QUARTER_HOUR_S) / 3600);
+}
+
+const char* formatUtc(uint32_t epoch, char* out, size_t size) {
+  CivilDate date = civilFromDays(epoch / SECONDS_PER_DAY);
+  uint32_t seconds = epoch % SECONDS_PER_DAY;
+  snprintf(out, size, "%04u-%02u-%02u %02u:%02u:%02u UTC", date.year, date.month, date.day, (unsigned)(seconds / 3600),
+           (unsigned)(seconds / 60 % 60), (unsigned)(seconds % 60));
+  return out;
+}
+
+const char* formatDay(int32_t day, char* out, size_t size) {
+  CivilDate date = civilFromDays(day);
+  snprintf(out, size, "%04u-%02u-%02u", date.year, date.month, date.day);
+  return out;
+}
@@ -23,25 +23,168 @@
 
 #define ENABLE_USER_AUTH
 #define ENABLE_DATABASE
+#define ENABLE_STORAGE
+#define ENABLE_FS
 #define ENABLE_GSM_NETWORK
 #define ENABLE_ESP_SSLCLIENT
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <set>
+#include <esp_wifi.h>
 #include <TinyGsmClient.h>
 #include <FirebaseClient.h>
 #include <SD.h>
 #include <SPI.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <esp_pm.h>
+#include <esp_idf_version.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+#include <stdarg.h>
 #include "credentials.h"
+#include "CycleAggregator.h"
+#include "DeltaPatch.h"
+#include "FirmwareManifest.h"
+#include "HashSet64.h"
+#include "HeapWatchdog.h"
+#include "HyperLogLog.h"
+#include "JsonWriter.h"
+#include "MacHash.h"
+#include "MinuteSeries.h"
+#include "Proximity.h"
+#include "ProbeCapture.h"
+#include "RemoteConfig.h"
+#include "ReportJson.h"
+#include "Pipeline.h"
+#include "PipelineConfig.h"
+#include "AtEngine.h"
+#include "GpsParser.h"
+#include "GpsTracker.h"
+#include "SdLogger.h"
+#include "ScanRecord.h"
+#include "ScanArchive.h"
+#include "StageProfiler.h"
+#include "CivilTime.h"
+#include "TimeService.h"
+#include "Outbox.h"
+#include "CountingClient.h"
+#include "CountingStream.h"
+#include "ModemTlsClient.h"
 
 // ============ CONFIGURATION ============
 #define BILLBOARD_ID BILLBOARD_IDS
 #define FIRMWARE_VERSION "1.0.0-PROD"
-#define SCAN_INTERVAL_MS 5000        // WiFi scan every 5 seconds
-#define SCANS_PER_UPLOAD 10          // Upload to Firebase every 10 scans
-#define MAX_NETWORKS_PER_SCAN 20     // Safety limit for processing
+// SCAN_INTERVAL_MS, SCANS_PER_UPLOAD, UPLOAD_INTERVAL_MAX_MS, SYSTEM_RESTART_INTERVAL_MS, PROXIMITY_* and
+// PROFILE_ENABLED_DEFAULT are defaults: /devices/<id>/config overrides them at run time (see RemoteConfig.h)
+// Pipeline sizing shared with the native benchmark (scan cycle, dedup, sketches, visits, proximity,
+// minute series, upload body) is in include/PipelineConfig.h
+#define SCAN_RESULT_CHUNK 16         // AP records streamed per chunk (queue space awaited between chunks)
+#define SCAN_PRINT_SIGHTINGS 1       // 1 = print every sighting's hash and RSSI (serial time grows with dense sites)
 #define STARTUP_DELAY_MS 2000        // Delay before first scan
+#define WIFI_SCAN_ASYNC 1            // 1 = non-blocking scan polled from loop(), 0 = blocking scan
+#define SCAN_DWELL_MS_PER_CHANNEL 300 // Max active dwell per channel (lower = faster sweep, fewer APs)
+#define SCAN_TIMEOUT_MS 10000        // Abandon an async scan that never reports completion
+
+// Capture engine: count access points (BSSID scan) or phones (probe requests)
+#define CAPTURE_MODE_AP_SCAN 0
+#define CAPTURE_MODE_PROBE 1
+#define CAPTURE_MODE CAPTURE_MODE_AP_SCAN
+#define PROBE_MAX_DEVICES_PER_WINDOW 128 // Distinct phones tracked per SCAN_INTERVAL_MS window
+#define PROBE_DRAIN_BATCH 32             // Sightings popped from the ring per batch
+
+// FreeRTOS task layout: radio on core 0 (with the WiFi driver), everything else on core 1
+#define RADIO_CORE 0
+#define APP_CORE 1
+#define SCAN_TASK_STACK 4096
+#define AGGREGATION_TASK_STACK 4096
+#define UPLINK_TASK_STACK 16384        // Firebase client + TLS
+#define SD_TASK_STACK 6144
+#define SCAN_TASK_PRIORITY 2
+#define AGGREGATION_TASK_PRIORITY 3
+#define UPLINK_TASK_PRIORITY 2
+#define SD_TASK_PRIORITY 1
+#define SCAN_EVENT_QUEUE_LENGTH 256    // Sightings in flight between scan and aggregation
+#define REPORT_QUEUE_LENGTH 8          // Completed cycles waiting for the uplink
+#define LOG_QUEUE_LENGTH 32            // SD log lines waiting for the card
+#define SCAN_RECORD_QUEUE_LENGTH 16    // Binary scan records waiting for the card
+#define SCAN_TASK_POLL_MS 50           // Scan task tick (async poll / probe drain)
+#define UPLINK_POLL_MS 20              // Max wait for a report between uplink service turns
+#define SYSTEM_RESTART_INTERVAL_MS 0   // No scheduled restart, the heap watchdog restarts on need (config restart_interval_h)
+#define HEAP_WATCHDOG_MIN_BLOCK 24576  // Largest free block a TLS reconnect needs (record buffers come in one piece)
+#define HEAP_WATCHDOG_MIN_FREE 40960   // Free heap floor
+#define HEAP_WATCHDOG_CHECK_MS 60000   // Heap sample cadence
+#define HEAP_WATCHDOG_STRIKES 5        // Consecutive samples below a floor before the watchdog restarts
+#define SD_TASK_POLL_MS 1000           // SD task wakes at least this often to apply flush thresholds
+#define RESTART_LOG_FLUSH_TIMEOUT_MS 2000 // Max wait for the SD task to flush before ESP.restart()
+
+// SIM7600 AT traffic (GPS / network time) via the non-blocking AT engine
+#define AT_DEFAULT_TIMEOUT_MS 3000     // Per-command response timeout
+#define GPS_FIX_POLL_MS 1000           // CGPSINFO cadence while searching for the first fix
+#define GPS_TRACK_POLL_MS 60000        // CGPSINFO cadence while the position settles
+#define GPS_STABLE_POLL_MS 3600000     // CGPSINFO cadence once the position is frozen (relocation check)
+#define GPS_SLEEP_WAIT_MS 900000       // Longest the modem is kept awake for an unsettled position; the search goes on at each wake
+#define GPS_AGPS_XTRA 1                // 1 = XTRA assistance data (AT+CGPSXE / CGPSXD) for a faster first fix
+#define TIME_RESYNC_INTERVAL_MS 3600000 // Network time re-read; esp_timer carries the clock in between
+#define TIME_RETRY_INTERVAL_MS 30000   // Re-read cadence until the first valid network time
+#define TIME_NTP_SERVER "pool.ntp.org" // AT+CNTP fallback when the network sends no NITZ, "" = off
+#define TIME_NTP_TZ_QUARTERS 0         // Zone AT+CNTP stamps on the RTC (quarter hours), sets the local day
+#define REPORT_UPLOAD_WAIT_MS 3000     // Max wait for the per-report update to be acknowledged
+#define UPLOAD_DELTA_MODE 1            // 1 = send per-cycle increments (server-side sum), 0 = overwrite daily totals
+#define UPLOAD_COMPACT_CYCLES 1        // 1 = outbox cycles as [ts,impressions,networks,unique,repeated], 0 = named fields
+#define UPLOAD_INTERVAL_MIN_MS (runtimeConfig.scanIntervalMs * runtimeConfig.scansPerUpload) // Report cadence while busy: every cycle
+#define UPLOAD_INTERVAL_MAX_MS 900000  // Longest a quiet site goes between reports (15 min; config upload_interval_max_s)
+#define UPLOAD_BUSY_ARRIVALS 3         // New + returning visitors in a cycle that count as busy
+#define UPLOAD_SLOW_LATENCY_MS 2500    // Report round trip that counts as a poor link
+#define CONFIG_POLL_INTERVAL_MS 3600000 // Re-read /devices/<id>/config after an acknowledged report at most this often
+#define OTA_ENABLED 1                  // 1 = look for delta updates under /firmware/updates (0 still confirms a trial boot)
+#define OTA_CHECK_INTERVAL_MS 21600000 // Re-read the firmware manifest after an acknowledged report at most this often (6 h)
+#define OTA_PATCH_PATH "/ota_patch.tdp" // Patch staged on the SD card and applied from there
+#define OTA_DOWNLOAD_TIMEOUT_MS 1800000 // A patch download not completed this long after it started is abandoned
+#define OTA_APPLY_BLOCKS_PER_PASS 16   // DELTA_PATCH_BLOCKs flashed per uplink pass
+#define OTA_TRIAL_BOOTS 3              // Boots a new image gets to sign in before the previous one is restored
+#define OTA_CONFIRM_TIMEOUT_MS 900000  // A new image not signed in this long after boot is rolled back
+#define GPS_NMEA_STREAMING 0           // 1 = modem pushes GGA/RMC (AT+CGPSINFOCFG), 0 = poll AT+CGPSINFO
+#define GPS_NMEA_REPORT_INTERVAL_S 10  // Seconds between streamed sentence bursts
+#define GPS_NMEA_SENTENCES 3           // AT+CGPSNMEA / CGPSINFOCFG mask: bit 0 GGA, bit 1 RMC
+#define GPS_NMEA_STABLE_INTERVAL_S 255 // Streamed burst interval once the position is frozen (modem max)
+// Where TLS runs: on the ESP32 (ESP_SSLClient over a TinyGSM socket) or inside the SIM7600 (AT+CCH*)
+#define TLS_TRANSPORT_ESP32 0
+#define TLS_TRANSPORT_MODEM 1
+#define TLS_TRANSPORT TLS_TRANSPORT_ESP32
+#define TLS_SESSION_RESUMPTION 1       // 1 = resume the cached TLS session on reconnect (abbreviated handshake)
+#define TLS_SESSION_PERSIST_RTC 1      // 1 = keep the cached session in RTC memory across restartSystem()
+#define WARM_BOOT_ENABLED 1            // 1 = carry modem/GPS/auth/counter state across restartSystem() in RTC memory
+#define WARM_TOKEN_MIN_TTL_S 300       // Reuse the cached ID token only if it has at least this long left
+#define MODEM_PROBE_TIMEOUT_MS 300     // Per plain-AT probe when looking for a live modem
+#define MODEM_BAUD_DEFAULT 115200      // Modem rate after AT+CRESET (AT+IPREX, never changed)
+#define MODEM_BAUD_MAX_NO_FLOW 921600  // Fastest rate tried without RTS/CTS wired
+#define MODEM_BAUD_ECHO_ROUNDS 3       // AT+IPR? round trips that must come back intact at a new rate
+#define MODEM_BAUD_SETTLE_MS 50        // Pause between the IPR OK and switching the ESP32 side
+#define MODEM_BAUD_CEILING_BOOTS 20    // Negotiations a failed rate stays skipped before it is tried again
+#define MODEM_UART_RX_BUFFER 4096      // ESP32 RX ring for SerialAT (default 256 overflows above 115200)
+#define TLS_KEEP_ALIVE_S 180           // Idle seconds before the Firebase socket is closed (> one report interval)
+
+// Power management: light sleep between scans, modem UART sleep between upload windows
+#define POWER_SAVE_ENABLED 1           // 0 = always awake (bench / mains-powered sites)
+#define POWER_CPU_MAX_MHZ 240
+#define POWER_CPU_MIN_MHZ 80           // DFS floor; 80 keeps APB (and the UART baud rates) fixed
+#define MODEM_SLEEP_MIN_MS 15000       // Gaps shorter than this keep the modem awake
+#define MODEM_WAKE_LEAD_MS 3000        // Modem woken this long before the next planned upload
+#define MODEM_WAKE_SETTLE_MS 100       // DTR low -> UART usable
+// Current estimates for the mA·h figure (measure your hardware and adjust)
+#define POWER_ESP32_AWAKE_MA 70        // CPU running, radio scanning on and off
+#define POWER_ESP32_SLEEP_MA 2         // Automatic light sleep, WiFi in modem sleep
+#define POWER_MODEM_AWAKE_MA 35        // SIM7600 attached, UART and network active (TX peaks averaged)
+#define POWER_MODEM_SLEEP_MA 4         // SIM7600 with AT+CSCLK=1 and DTR high (paging only)
+
+// Profiling: per-stage latency histograms, heap and stack figures in diagnostics "prof"
+#define PROFILE_ENABLED_DEFAULT 1      // Boot default; NVS "diag"/"profile" or serial "profile on|off" switch it at runtime, as does config "profiling"
+
+// Sketch and minute-series uploads (sizes in PipelineConfig.h)
+#define HLL_RETRY_MS 60000             // Delay before a failed sketch upload is re-sent
+#define MINUTE_RETRY_MS 60000          // Delay before a failed series batch is re-sent
 
 // GPRS credentials (from credentials.h)
 const char* apn = CELLULAR_APN;
@@ -53,89 +196,510 @@ const char* gprsPass = CELLULAR_PASS;
 #define USER_EMAIL FIREBASE_AUTH_EMAIL
 #define USER_PASSWORD FIREBASE_AUTH_PASSWORD
 #define DATABASE_URL FIREBASE_DATABASE_URL
+#define STORAGE_BUCKET FIREBASE_STORAGE_BUCKET
 
 // Pin definitions
 #define MODEM_TX 17
 #define MODEM_RX 16
+#define MODEM_RTS_PIN -1  // ESP32 RTS -> modem RTS (e.g. GPIO 25 when wired, -1 = not wired)
+#define MODEM_CTS_PIN -1  // ESP32 CTS <- modem CTS (e.g. GPIO 26 when wired, -1 = not wired)
+#define MODEM_DTR_PIN 27  // ESP32 -> modem DTR, high lets it sleep under AT+CSCLK=1 (-1 = not wired)
 #define SD_CS_PIN 5  // CS pin for SD card module (adjust if needed)
+#define SD_LOG_PATH "/trafilytics_log.txt"
+
+// SD log verbosity: lines above SD_LOG_LEVEL are compiled out entirely
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3             // Raw modem responses ("GPS Response:", "Time Response:")
+#define SD_LOG_LEVEL LOG_LEVEL_INFO
 
 // ============ GLOBAL STATE ============
-// Per-upload-cycle counters (reset every 10 scans)
-uint32_t wifiNetworksThisCycle = 0;
-uint32_t repeatedWifiNetworks = 0;
-uint32_t uniqueWifiNetworks = 0;
-uint32_t impressionCount = 0;
+// Dedup, per-scan and per-cycle counters and the visit engine (aggregation task only)
+CycleAggregator<DEDUP_TABLE_CAPACITY, VISIT_TRACKER_CAPACITY> aggregator(SCANS_PER_UPLOAD, VISIT_GAP_S, VISIT_LINGER_S,
+                                                                        VISIT_WINDOW_S);
+
+// Runtime tunables: the #define defaults, then the NVS cache at boot, then
+// /devices/<id>/config. Only the uplink task writes; the scan and
+// aggregation tasks read single words without a lock.
+const RuntimeConfig kConfigDefaults = {SCAN_INTERVAL_MS,
+                                       SCANS_PER_UPLOAD,
+                                       UPLOAD_INTERVAL_MAX_MS / 1000,
+                                       SYSTEM_RESTART_INTERVAL_MS / 3600000,
+                                       {PROXIMITY_RSSI_AT_1M, PROXIMITY_PATH_LOSS_X10, PROXIMITY_VIEWING_M,
+                                        PROXIMITY_NEARBY_M},
+                                       PROFILE_ENABLED_DEFAULT};
+RuntimeConfig runtimeConfig = kConfigDefaults;
+
+// RSSI -> distance band table, built from runtimeConfig.proximity (this billboard's calibration)
+ProximityTable proximityTable;
 
 // Cumulative counters (never reset)
-uint32_t totalWifiNetworks = 0;
-uint32_t totalScansPerformed = 0;
 uint32_t totalReportsGenerated = 0;
 
-// Hash tracking for deduplication
-std::set<String> currentCycleHashes;
-std::set<String> previousCycleHashes;
+// Unique-device sketches, current + closed generation each. The aggregation
+// task fills the current one and closes it at the local hour/day boundary;
+// the uplink task uploads the closed one and frees the slot again.
+HyperLogLog<HLL_HOUR_PRECISION> hourSketches[2];
+HyperLogLog<HLL_DAY_PRECISION> daySketches[2];
+volatile uint8_t hourSketchCurrent = 0;
+volatile uint8_t daySketchCurrent = 0;
+volatile int32_t sketchHour = -1;                // Local hour of the current sketches, -1 = clock not synced
+volatile int32_t closedSketchHour = -1;          // Closed hour awaiting upload, -1 = slot free
+volatile int32_t closedSketchDay = TIME_NO_DAY;  // Closed day awaiting upload
+uint32_t sketchKey = 0;                          // Scan task: fleet key for today, 0 = clock not synced
+uint32_t sketchesDropped = 0;                    // Periods closed while the previous one was still waiting
+uint32_t sketchSightingsUndated = 0;             // Sightings before the first clock sync (not sketched)
+
+// Minute buckets: filled by the aggregation task, popped in batches by the uplink task
+MinuteSeries<MINUTE_SERIES_CAPACITY> minuteSeries;
+MinuteBucket seriesBatch[MINUTE_FLUSH_BATCH];   // Uplink: popped buckets until their upload is acknowledged
+size_t seriesBatchCount = 0;
+
+// Probe capture: one SCAN_INTERVAL_MS window stands in for one scan
+HashSet64<hashSetCapacityFor(PROBE_MAX_DEVICES_PER_WINDOW)> probeWindowHashes;
+uint32_t probeWindowSightings = 0;
+uint32_t probeWindowDevices = 0;
+uint32_t probeOverflows = 0;                     // Devices a full window table could not place (not forwarded)
+
+// Cycle that could not be queued to the uplink yet (folded into the next one)
+CycleReport pendingReport;
+bool hasPendingReport = false;
 
 // Timing and system state
 uint32_t lastScanTime = 0;
-uint32_t scanCounter = 0;
 uint32_t reportCounter = 0;
 uint32_t systemStartTime = 0;
 uint32_t ephemeralSalt = 0;
+uint32_t saltEpoch = 0;         // Published stand-in for the salt (boot id in archive/outbox)
+bool scanInProgress = false;
+uint32_t scanStartTime = 0;
+uint32_t scanSequence = 0;
+
+// Tasks and queues
+TaskHandle_t scanTaskHandle = NULL;
+TaskHandle_t aggregationTaskHandle = NULL;
+TaskHandle_t uplinkTaskHandle = NULL;
+TaskHandle_t sdTaskHandle = NULL;
+QueueHandle_t scanEventQueue = NULL;
+QueueHandle_t reportQueue = NULL;
+QueueHandle_t logQueue = NULL;
+QueueHandle_t scanRecordQueue = NULL;
+
+// Wall clock, synced by the uplink task and read by any task (log stamps, records)
+TimeSync timeSync = {};
+portMUX_TYPE timeSyncMux = portMUX_INITIALIZER_UNLOCKED;
 
 // Error tracking
 uint32_t scanErrors = 0;
-uint32_t hashCollisions = 0;
+uint32_t sightingsDropped = 0;
+uint32_t logMessagesDropped = 0;
+uint32_t reportsMerged = 0;
+uint32_t scanRecordsDropped = 0;
+volatile uint32_t logFlushesCompleted = 0;
+
+// Stage profiling: one writer task per stage, read and reset by the uplink at upload
+enum ProfileStageId : uint8_t {
+  PROFILE_SCAN = 0,     // WiFi sweep, start -> results (us)
+  PROFILE_HASH,         // Both hashes of one AP record (CPU cycles)
+  PROFILE_AGGREGATE,    // One sighting through the aggregation task (CPU cycles)
+  PROFILE_SD_WRITE,     // SD task service pass that wrote to the card (us)
+  PROFILE_AT_COMMAND,   // AtEngine command -> final result (us)
+  PROFILE_TCP_CONNECT,  // Modem socket open below the TLS client (us)
+  PROFILE_TLS_CONNECT,  // Firebase connection: TCP + handshake (us)
+  PROFILE_REPORT_ACK,   // Report update issued -> acknowledged (ms)
+  PROFILE_REPORT_JSON,  // buildReportUpdate() (CPU cycles)
+  PROFILE_STAGES
+};
+static const char* const kProfileStageKeys[PROFILE_STAGES] = {"scan_us", "hash_cyc", "agg_cyc", "sd_us", "at_us",
+                                                              "tcp_us",  "tls_us",   "ack_ms",  "json_cyc"};
+ProfileStage profileStages[PROFILE_STAGES];
+portMUX_TYPE profileMux = portMUX_INITIALIZER_UNLOCKED;
+volatile bool profilingEnabled = PROFILE_ENABLED_DEFAULT;
+bool profileReported = false;           // Report in flight carries the window; reset once it is acked
+uint32_t scanStartUs = 0;
+uint32_t tlsConnectsTimed = 0;
+char consoleLine[32];
+size_t consoleLength = 0;
+
+// Device identity, formatted once in setup()
+#define DEVICE_ID_MAX (sizeof(BILLBOARD_ID) + 13)         // "<BILLBOARD_ID>_<12 hex digits>"
+#define FIREBASE_PATH_MAX (sizeof("/devices/") + DEVICE_ID_MAX + 48)  // Device path plus the longest suffix
+char deviceMacAddress[13] = "";
+char combinedBillboardId[DEVICE_ID_MAX] = "";
+char deviceAccessKey[DEVICE_ID_MAX + 11] = "";
+char devicePath[sizeof("/devices/") + DEVICE_ID_MAX] = "";  // "/devices/<combinedBillboardId>"
 
-// Device identity
-String deviceMacAddress = "";
-String combinedBillboardId = "";
-String deviceAccessKey = "";
-String currentDateTime = "";
+// Restarts only on measured heap degradation (uplink task)
+HeapWatchdog heapWatchdog(HEAP_WATCHDOG_MIN_BLOCK, HEAP_WATCHDOG_MIN_FREE, HEAP_WATCHDOG_STRIKES);
+uint32_t lastHeapCheck = 0;
 
 // Daily aggregation tracking
-String currentDate = "";
+int32_t currentDay = TIME_NO_DAY;          // Local day number of the daily totals
+char currentDate[TIME_DATE_TEXT_MAX] = ""; // currentDay as YYYY-MM-DD, "" before the first sync
 uint32_t dailyImpressions = 0;
+VisitStats dailyVisits = {};  // This boot's visits today (uplink task)
+uint32_t dailyProximity[PROXIMITY_BANDS] = {};  // This boot's sightings per distance band today (uplink task)
 
-// GPS location tracking
-String gpsLatitude = "0.0";
-String gpsLongitude = "0.0";
+// Delta mode: impressions not yet acknowledged by the server, per day
+#define IMPRESSION_DELTA_SLOTS 3  // Today, yesterday, and a day still in flight when a third one starts
+struct ImpressionDelta {
+  char date[11];      // YYYY-MM-DD, "" = before the first valid date
+  uint32_t pending;   // Not yet sent
+  uint32_t inFlight;  // Sent, waiting for the report callback
+};
+ImpressionDelta impressionDeltas[IMPRESSION_DELTA_SLOTS] = {};
+
+// GPS location tracking (numeric; formatted only when printed or uploaded)
+#define GPS_SOURCE_NONE 0    // No position known: Location is left out of uploads
+#define GPS_SOURCE_STORED 1  // Last stable position from NVS, until a live fix arrives
+#define GPS_SOURCE_FIX 2
+GpsFix gpsReceiver = {};  // Latest receiver output (GGA/RMC merge target)
+GpsFix gpsFix = {};       // Published position: gpsReceiver with the tracker's settled lat/lon
+GpsTracker gpsTracker;
+uint8_t gpsSource = GPS_SOURCE_NONE;
 bool gpsFixAcquired = false;
+uint32_t lastGpsPoll = 0;
+uint32_t gpsSearchStart = 0;            // Receiver started, or a stable position lost
 
 // Data consumption tracking (in bytes)
-uint32_t totalDataSent = 0;
 uint32_t dailyDataSent = 0;
 
 bool sdCardAvailable = false;
 bool deviceInfoUploaded = false;
+bool outboxAvailable = false;
+bool reportUploadPending = false;
+bool sketchUploadPending = false;
+bool sketchUploadFailed = false;
+uint32_t lastSketchAttempt = 0;
+int32_t sketchUploadHour = -1;          // Closed slots carried by the in-flight sketch upload
+int32_t sketchUploadDay = TIME_NO_DAY;
+bool seriesUploadPending = false;
+bool seriesUploadFailed = false;
+uint32_t lastSeriesAttempt = 0;
+// One upload body, built in place (UPLOAD_JSON_MAX: see PipelineConfig.h)
+char uploadJson[UPLOAD_JSON_MAX];
+JsonWriter uploadBody(uploadJson, sizeof(uploadJson));
+// Adaptive report cadence: shortens with traffic, stretches when quiet or the link is poor
+uint32_t uploadIntervalMs = UPLOAD_INTERVAL_MIN_MS;
+bool configPollDue = true;              // First read once signed in, then piggybacked on a report ack
+bool configPollPending = false;
+uint32_t lastConfigPoll = 0;
+uint32_t configUpdates = 0;             // Config reads that changed a setting
+uint32_t configRejected = 0;            // Values (or the whole node) refused by validation
+
+// Firmware updates (uplink task)
+#define OTA_IDLE 0
+#define OTA_CHECKING 1     // Manifest read in flight
+#define OTA_OFFERED 2      // Update accepted, download starts next pass
+#define OTA_DOWNLOADING 3
+#define OTA_DOWNLOADED 4   // Patch on SD, applying starts next pass
+#define OTA_APPLYING 5
+uint8_t otaState = OTA_IDLE;
+bool otaCheckDue = OTA_ENABLED;         // First read once signed in, then piggybacked on a report ack
+uint32_t lastOtaCheck = 0;
+bool otaConfirmed = false;              // app.ready() reached this boot
+bool otaTrialActive = false;            // Boot of a new image, until confirmed or rolled back
+uint8_t otaTrialBoots = 0;
+uint8_t otaProgress = 0;                // Percent downloaded, then percent of the image written
+uint32_t otaUpdatesFailed = 0;          // Updates abandoned this boot
+char otaFailedVersion[MANIFEST_VERSION_MAX] = "";  // Rolled back or unusable here: not taken again
+char otaBootNote[80] = "";              // otaBootCheck() outcome, logged once the SD card is up
+uint32_t otaDownloadStart = 0;
+FirmwareManifest otaManifest;           // Update in progress
+DeltaPatch otaPatch;
+File otaFile;                           // Staged patch being applied
+const esp_partition_t* otaSource = NULL;  // Running slot the patch copies from
+const esp_partition_t* otaTarget = NULL;  // Inactive slot being written
+esp_ota_handle_t otaHandle = 0;
+mbedtls_sha256_context otaHash;         // Over the target as written
+
+uint32_t lastReportUpload = 0;
+bool reportUploadSent = false;          // At least one report attempted this boot
+bool uploadLinkPoor = false;            // Last report failed or was slow
+uint32_t reportsDeferred = 0;
+bool gpsRefreshPending = false;
+bool timeRefreshPending = false;
+bool ntpRequested = false;
+uint32_t lastTimeRefresh = 0;
+
+// Power state. The ESP32 counts as awake while any POWER_HOLD_* is held
+// (each pins a no-light-sleep PM lock); the modem while DTR is low.
+#define POWER_HOLD_SCAN 0x01
+#define POWER_HOLD_MODEM 0x02
+portMUX_TYPE powerMux = portMUX_INITIALIZER_UNLOCKED;
+esp_pm_lock_handle_t scanPmLock = NULL;
+esp_pm_lock_handle_t modemPmLock = NULL;
+bool lightSleepActive = false;          // esp_pm_configure() accepted automatic light sleep
+uint8_t powerHolds = 0;
+uint64_t powerAwakeSinceUs = 0;
+uint64_t powerAwakeUs = 0;              // ESP32 time with a hold active, since boot
+bool modemAwake = true;
+bool modemSleepEnabled = false;         // AT+CSCLK=1 accepted and DTR wired
+uint64_t modemAwakeSinceUs = 0;
+uint64_t modemAwakeUs = 0;
+uint32_t modemWakeAt = 0;               // millis() of the timed wake while asleep
+uint32_t modemSleeps = 0;
+
+// Per-report power figures (uplink task)
+struct PowerCycle {
+  uint32_t elapsedMs;
+  uint32_t awakeMs;
+  uint32_t modemAwakeMs;
+  float mAh;
+};
+PowerCycle lastPowerCycle = {};
+float powerTotalMah = 0.0f;
+uint64_t powerSampleUs = 0;
+uint64_t powerSampleAwakeUs = 0;
+uint64_t powerSampleModemUs = 0;
+
+// Modem UART rate, negotiated after bring-up (fastest first)
+const uint32_t modemBaudCandidates[] = {3000000, 921600, 460800, 230400};
+uint32_t modemBaud = MODEM_BAUD_DEFAULT;
+bool modemFlowControl = false;
+
+// Warm restart: state carried across restartSystem() in RTC slow memory.
+// Written once just before the restart, consumed (magic cleared) at boot.
+#define WARM_STATE_MAGIC 0x4D524157UL  // "WARM"
+#define WARM_ID_TOKEN_MAX 1400         // Firebase ID token (JWT, ~1 KB)
+#define WARM_REFRESH_TOKEN_MAX 512
+struct WarmState {
+  uint32_t magic;
+  char firmware[16];
+  uint32_t epoch;                      // currentEpoch() at save, 0 = clock not synced
+  int32_t driftPpm;                    // Measured esp_timer drift, kept across the restart
+  bool driftValid;
+  int16_t tzQuarters;
+  uint32_t modemBaud;                  // Modem keeps its AT+IPR rate across an ESP32 restart
+  bool modemFlowControl;
+  bool networkRegistered;
+  bool gprsConnected;
+  bool gpsFixAcquired;
+  uint8_t gpsSource;
+  GpsFix gpsFix;
+  GpsTracker gpsTracker;
+  int32_t day;
+  uint32_t dailyImpressions;
+  uint32_t dailyDataSent;
+  ImpressionDelta impressionDeltas[IMPRESSION_DELTA_SLOTS];
+  uint32_t tokenExpiry;                // Unix seconds, 0 = no token cached
+  char idToken[WARM_ID_TOKEN_MAX];
+  char refreshToken[WARM_REFRESH_TOKEN_MAX];
+  uint32_t checksum;
+};
+RTC_NOINIT_ATTR WarmState warmState;
+bool warmBoot = false;
 
 // TinyGSM and Firebase objects
-TinyGsm modem(SerialAT);
-TinyGsmClient gsm_client(modem, 0);
+CountingStream modem_uart(SerialAT);  // Every byte on the modem UART after bring-up
+TinyGsm modem(modem_uart);
+AtEngine atEngine(modem_uart);
 void asyncCB(AsyncResult &aResult);
 
+#if TLS_TRANSPORT == TLS_TRANSPORT_MODEM
+ModemTlsClient modem_tls(modem_uart);
+CountingClient session_client(modem_tls);  // Firebase's view: plaintext bytes, connect = TCP + TLS
+#else
+TinyGsmClient gsm_client(modem, 0);
+CountingClient wire_client(gsm_client);  // Counts real bytes on the cellular link
 ESP_SSLClient ssl_client;
+CountingClient session_client(ssl_client);  // Firebase's view: plaintext bytes, connect = TCP + TLS
+#endif
+
+// TLS session cache: lets a reconnect skip the certificate exchange and key agreement
+#if TLS_TRANSPORT == TLS_TRANSPORT_ESP32 && TLS_SESSION_RESUMPTION
+BearSSL_Session tls_session;
+#if TLS_SESSION_PERSIST_RTC
+#define TLS_SNAPSHOT_MAGIC 0x534C5454UL  // "TTLS"
+struct TlsSessionSnapshot {
+  uint32_t magic;
+  br_ssl_session_parameters params;
+  uint32_t checksum;
+};
+RTC_NOINIT_ATTR TlsSessionSnapshot tlsSessionSnapshot;  // Survives a software reset, not a power cut
+#endif
+#endif
+uint32_t tlsConnectsSeen = 0;
+uint32_t tlsFullHandshakes = 0;
+uint32_t tlsResumedHandshakes = 0;
+uint8_t tlsLastSessionId[32];
+uint8_t tlsLastSessionIdLen = 0;
+
+// Transport benchmark: report round trips (update issued -> acknowledged)
+uint32_t reportUploadStart = 0;
+uint32_t reportUploadsAcked = 0;
+uint32_t reportLatencyTotalMs = 0;
+uint32_t reportLatencyMaxMs = 0;
+uint32_t reportUartBytesTotal = 0;
+
+// Bytes handed to the cellular link: TLS records on the ESP32 path, UART
+// traffic (plaintext + AT framing) when the modem runs TLS
+static inline uint32_t linkBytesSent() {
+#if TLS_TRANSPORT == TLS_TRANSPORT_MODEM
+  return modem_uart.bytesSent();
+#else
+  return wire_client.bytesSent();
+#endif
+}
+
+static inline uint32_t linkBytesReceived() {
+#if TLS_TRANSPORT == TLS_TRANSPORT_MODEM
+  return modem_uart.bytesReceived();
+#else
+  return wire_client.bytesReceived();
+#endif
+}
 
 using AsyncClient = AsyncClientClass;
-AsyncClient aClient(ssl_client);
+AsyncClient aClient(session_client);
 UserAuth user_auth(API_KEY, USER_EMAIL, USER_PASSWORD, 30000);
 FirebaseApp app;
 RealtimeDatabase Database;
+FirebaseStorage Storage;
 
 // Function declarations
-String hashMAC(const uint8_t* macAddr);
+uint64_t hashMAC(const uint8_t* macAddr);
+uint64_t sketchHashMAC(const uint8_t* macAddr);
+void refreshSketchKey();
+void rotateSketches();
+int32_t currentLocalHour();
+void serviceSketches();
+void flushSketches();
+bool buildSketchUpdate(const HyperLogLog<HLL_HOUR_PRECISION>* hour, int32_t hourIndex,
+                       const HyperLogLog<HLL_DAY_PRECISION>* day, int32_t dayIndex);
+void onSketchResult(AsyncResult& aResult);
+bool buildSeriesUpdate(const MinuteBucket* batch, size_t count);
+void serviceMinuteSeries();
+void sendSeriesBatch();
+void flushMinuteSeries();
+void onSeriesResult(AsyncResult& aResult);
+void scanTask(void* param);
+void aggregationTask(void* param);
+void uplinkTask(void* param);
+void sdTask(void* param);
+bool startPipelineTasks();
+void initConnectivity();
+void sendScanEvent(uint8_t type, uint64_t hash, uint64_t sketchHash, int16_t found, int8_t rssi);
 void performWiFiScan();
-void reportAnalytics();
-String getMacAddress();
-String buildDailyDataJSON();
-String buildDeviceInfoJSON();
-String generateAccessKey();
-bool updateGPSLocation();
-bool waitForGPSFix(unsigned long timeoutMs);
-String getTimeFromSIM7600();
+bool startWiFiScan();
+void pollWiFiScan();
+void processScanResults(int networksFound);
+void waitForScanEventSpace(size_t events);
+void closeScan(int networksFound);
+void archiveScan(const ScanTotals& scan);
+void emitCycleReport(CycleReport& report);
+void drainProbeCapture();
+void closeProbeWindow();
+void reportAnalytics(const CycleReport& report);
+void printTaskHealth();
+void printTransportBenchmark();
+void queueReportToOutbox(const CycleReport& report);
+void serviceOutbox();
+void onOutboxResult(AsyncResult& aResult);
+bool applyNetworkTime(const char* line);
+uint32_t currentEpoch();
+const char* currentTimestamp(char* out, size_t size);
+int32_t currentLocalDay();
+void setCurrentDay(int32_t day);
+void rollDailyTotals();
+void formatMacAddress(char* out, size_t size);
+bool appendCycleEntries(JsonWriter& json, const OutboxEntry* batch, size_t count, const char* keyPrefix);
+bool buildReportUpdate(const char* lat, const char* lon, const OutboxEntry* batch, size_t count);
+void addImpressionDelta(const char* date, uint32_t impressions);
+void settleImpressionDeltas(bool delivered);
+void uploadDeviceInfo();
+void onReportResult(AsyncResult& aResult);
+bool buildDeviceInfoJSON();
+void adaptUploadInterval(const CycleReport& report);
+bool reportUploadDue();
+void generateAccessKey(char* out, size_t size);
+void startGPS();
+void serviceGPS();
+void publishGpsFix(const GpsFix& sample);
+void loadStoredPosition();
+void loadProximityCalibration();
+void storeProximityCalibration();
+void loadRuntimeConfig();
+void storeRuntimeConfig();
+void serviceRemoteConfig();
+void onConfigResult(AsyncResult& aResult);
+void applyRuntimeConfig(const RuntimeConfig& next, uint16_t changed);
+const char* otaStateName();
+void otaBootCheck();
+void otaConfirm();
+void otaRollback(const char* reason);
+void serviceOta();
+void onOtaManifest(AsyncResult& aResult);
+void otaFileCallback(File& file, const char* filename, file_operating_mode mode);
+void onOtaDownload(AsyncResult& aResult);
+void otaBeginApply();
+void otaApplyStep();
+void otaFinish();
+void otaAbort(const char* reason, bool permanent);
+void profileSample(uint8_t stage, uint32_t value);
+void onAtTiming(AtResult result, uint32_t roundTripUs);
+bool appendProfile(JsonWriter& json);
+void resetProfile();
+void printProfile();
+void loadProfilingSetting();
+void setProfiling(bool enabled);
+void serviceConsole();
+void initPowerManagement();
+void powerHold(uint8_t source, bool held);
+void initModemPower();
+void enableModemSleep();
+void serviceModemPower();
+bool modemSleepAllowed();
+uint32_t msUntilModemWork();
+void modemSleep(uint32_t gapMs);
+void modemWake(const char* reason);
+void samplePowerCycle(PowerCycle& out);
+void storeStablePosition();
+const char* gpsSourceName();
+void onModemUrc(const char* line);
+void onNmeaLine(const char* line);
+void onGPSInfo(AtResult result, const char* payload, void* ctx);
+bool requestGPSUpdate();
+bool syncNetworkTime();
+void requestNtpSync();
+void onTimeInfo(AtResult result, const char* payload, void* ctx);
+bool requestTimeUpdate();
+void serviceUplink();
+bool restoreWarmState();
+void saveWarmState();
+uint32_t rtcChecksum(const void* data, size_t size);
+bool probeModem(uint32_t baud);
+uint32_t findModemBaud();
+void negotiateModemBaud();
+bool switchModemBaud(uint32_t from, uint32_t to);
+bool modemEchoTest(uint32_t baud);
+void initTlsSessionCache();
+void trackTlsHandshake();
 bool initSDCard();
-void logToSD(String message);
+void logToSD(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void requestLogFlush(uint32_t timeoutMs);
+void restartSystem();
+void serviceHeapWatchdog();
+uint32_t uptimeSeconds();
 void logScanToSD(int networksFound, int uniqueCount, int repeatedCount);
-String extractDateFromDateTime(String dateTime);
+
+#define LOG_ERROR(...) logToSD(__VA_ARGS__)
+#if SD_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) logToSD(__VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+#if SD_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logToSD(__VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+#if SD_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logToSD(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
 
 void setup() {
   SerialMon.begin(115200);
@@ -143,6 +707,10 @@ void setup() {
   
   systemStartTime = millis();
   
+  // Trial boots are counted (and past OTA_TRIAL_BOOTS rolled back) before any peripheral
+  // is touched, so an image that hangs in radio, modem or SD bring-up still reaches it
+  otaBootCheck();
+  
   Serial.println("\n╔════════════════════════════════════════════════════════╗");
   Serial.println("║         TRAFILYTICS - Billboard Analytics              ║");
   Serial.println("║                 Privacy-First System                   ║");
@@ -156,162 +724,281 @@ void setup() {
   Serial.println("   ✓ Ephemeral Salt per Boot (No Cross-Session Tracking)");
   Serial.println("   ✓ Non-Persistent In-Memory Storage Only\n");
   
+  loadRuntimeConfig();
+  
   Serial.printf("🔧 SYSTEM INFO:\n");
   Serial.printf("   Firmware: %s\n", FIRMWARE_VERSION);
   Serial.printf("   Billboard ID: %s\n", BILLBOARD_ID);
-  Serial.printf("   Scan Interval: %u ms\n", SCAN_INTERVAL_MS);
-  Serial.printf("   Scans per Upload: %u\n\n", SCANS_PER_UPLOAD);
+  Serial.printf("   Scan Interval: %u ms\n", runtimeConfig.scanIntervalMs);
+  Serial.printf("   Scans per Cycle: %u\n", runtimeConfig.scansPerUpload);
+  Serial.printf("   Report Interval: %u-%u s (adaptive)\n\n", UPLOAD_INTERVAL_MIN_MS / 1000, runtimeConfig.uploadIntervalMaxS);
+  
+  // Counters, clock and GPS from before a scheduled restart, before any task reads them
+  warmBoot = restoreWarmState();
+  if (warmBoot) {
+    Serial.printf("♻️  Warm restart: %u impressions today (%s), modem at %u baud\n\n", dailyImpressions,
+                  currentDate, modemBaud);
+  } else {
+    gpsTrackerReset(gpsTracker);
+    loadStoredPosition();
+  }
+  loadProximityCalibration();
+  loadProfilingSetting();
   
   // Generate ephemeral salt
   randomSeed(analogRead(34) ^ micros());
   ephemeralSalt = random(0xFFFFFFFF);
+  saltEpoch = (uint32_t)macHashAvalanche(ephemeralSalt);  // Never the salt itself
   
   // Get device MAC
-  deviceMacAddress = getMacAddress();
-  combinedBillboardId = String(BILLBOARD_ID) + "_" + deviceMacAddress;
-  deviceAccessKey = generateAccessKey();
+  formatMacAddress(deviceMacAddress, sizeof(deviceMacAddress));
+  snprintf(combinedBillboardId, sizeof(combinedBillboardId), "%s_%s", BILLBOARD_ID, deviceMacAddress);
+  snprintf(devicePath, sizeof(devicePath), "/devices/%s", combinedBillboardId);
+  generateAccessKey(deviceAccessKey, sizeof(deviceAccessKey));
   
   Serial.printf("🔐 SECURITY INFO:\n");
   Serial.printf("   Ephemeral Salt: 0x%08X\n", ephemeralSalt);
-  Serial.printf("   Hash Algorithm: FNV-1a 64-bit\n");
-  Serial.printf("   Device MAC: %s\n", deviceMacAddress.c_str());
-  Serial.printf("   Combined ID: %s\n", combinedBillboardId.c_str());
-  Serial.printf("   Access Key: %s\n", deviceAccessKey.c_str());
+  Serial.printf("   Hash Algorithm: FNV-1a 64-bit (word-wise)\n");
+  Serial.printf("   Device MAC: %s\n", deviceMacAddress);
+  Serial.printf("   Combined ID: %s\n", combinedBillboardId);
+  Serial.printf("   Access Key: %s\n", deviceAccessKey);
   Serial.printf("   Startup Timestamp: %u\n\n", systemStartTime);
   
   // Initialize WiFi in station mode (passive scanning)
   WiFi.mode(WIFI_STA);
   WiFi.disconnect();
+#if CAPTURE_MODE == CAPTURE_MODE_PROBE
+  if (probeCaptureBegin()) {
+    Serial.println("✓ Probe-request capture initialized (promiscuous mode)\n");
+  } else {
+    Serial.println("❌ Failed to enable promiscuous capture\n");
+  }
+#else
   Serial.println("✓ WiFi scanning initialized (passive mode)\n");
+#endif
+  
+  // Queues first: logToSD() enqueues from here on
+  scanEventQueue = xQueueCreate(SCAN_EVENT_QUEUE_LENGTH, sizeof(ScanEvent));
+  reportQueue = xQueueCreate(REPORT_QUEUE_LENGTH, sizeof(CycleReport));
+  logQueue = xQueueCreate(LOG_QUEUE_LENGTH, sizeof(LogMessage));
+  scanRecordQueue = xQueueCreate(SCAN_RECORD_QUEUE_LENGTH, sizeof(ScanRecord));
+  
+  initPowerManagement();
   
   // Initialize SD Card
   Serial.println("💾 Initializing SD Card...");
   if (initSDCard()) {
     sdCardAvailable = true;
     Serial.println("✓ SD Card initialized successfully");
-    logToSD("=== SYSTEM STARTUP ===");
-    logToSD("Firmware: " + String(FIRMWARE_VERSION));
-    logToSD("Billboard ID: " + String(BILLBOARD_ID));
-    logToSD("Device MAC: " + deviceMacAddress);
+    LOG_INFO("=== SYSTEM STARTUP ===");
+    LOG_INFO("Firmware: %s", FIRMWARE_VERSION);
+    LOG_INFO("Billboard ID: %s", BILLBOARD_ID);
+    LOG_INFO("Device MAC: %s", deviceMacAddress);
+    if (otaBootNote[0]) LOG_ERROR("OTA: %s", otaBootNote);
     Serial.println();
   } else {
     Serial.println("⚠️  SD Card initialization failed - logging disabled\n");
   }
   
+  // Start tasks: scanning begins now, connectivity comes up on the uplink task
+  if (!startPipelineTasks()) {
+    Serial.println("❌ Failed to start pipeline tasks - restarting");
+    delay(1000);
+    restartSystem();
+  }
+  Serial.println("✓ Pipeline tasks started (radio: core 0, analytics/uplink/SD: core 1)\n");
+}
+
+void initConnectivity() {
+  /*
+   * Modem, network, time, GPS and Firebase bring-up. Runs on the uplink
+   * task so scanning and aggregation are already counting meanwhile.
+   */
   // Initialize SIM7600G-H modem
-  SerialAT.begin(115200, SERIAL_8N1, MODEM_RX, MODEM_TX);
-  delay(1000);
-  
-  Serial.println("🔄 Resetting modem...");
-  SerialAT.println("AT+CRESET");
-  delay(10000);
-  
-  while (SerialAT.available()) SerialAT.read();
-  
-  Serial.println("Waiting for modem ready...");
-  unsigned long start = millis();
-  bool ready = false;
-  while (millis() - start < 30000) {
-    if (SerialAT.available()) {
-      String line = SerialAT.readStringUntil('\n');
-      if (line.indexOf("PB DONE") >= 0) {
-        ready = true;
-        break;
-      }
-    }
-    delay(100);
+  initModemPower();
+  SerialAT.setRxBufferSize(MODEM_UART_RX_BUFFER);
+  SerialAT.begin(modemBaud, SERIAL_8N1, MODEM_RX, MODEM_TX);
+  if (warmBoot && modemFlowControl && MODEM_RTS_PIN >= 0 && MODEM_CTS_PIN >= 0) {
+    SerialAT.setPins(MODEM_RX, MODEM_TX, MODEM_CTS_PIN, MODEM_RTS_PIN);
+    modemFlowControl = SerialAT.setHwFlowCtrlMode(UART_HW_FLOWCTRL_CTS_RTS, 64);
   }
   
-  if (ready) {
-    logToSD("Modem: Ready - PB DONE received");
+  // Warm restart: the modem never went down, a plain AT is enough
+  bool modemWarm = warmBoot && probeModem(modemBaud);
+  if (modemWarm) {
+    Serial.printf("♻️  Modem answered at %u baud - skipping reset\n", modemBaud);
+    LOG_INFO("Modem: Warm restart, reset skipped");
   } else {
-    logToSD("Modem: Warning - PB DONE timeout after 30s");
+    // The modem keeps its AT+IPR rate across an ESP32 reset: send the reset at the rate it answers on
+    uint32_t baud = findModemBaud();
+    SerialAT.updateBaudRate(baud ? baud : MODEM_BAUD_DEFAULT);
+    SerialAT.setHwFlowCtrlMode(UART_HW_FLOWCTRL_DISABLE, 64);
+    modemFlowControl = false;
+    delay(100);
+    
+    Serial.println("🔄 Resetting modem...");
+    SerialAT.println("AT+CRESET");
+    SerialAT.flush();
+    SerialAT.updateBaudRate(MODEM_BAUD_DEFAULT);  // Back at AT+IPREX after the reset
+    modemBaud = MODEM_BAUD_DEFAULT;
+    delay(10000);
+    
+    while (SerialAT.available()) SerialAT.read();
+    
+    Serial.println("Waiting for modem ready...");
+    unsigned long start = millis();
+    bool ready = false;
+    while (millis() - start < 30000) {
+      if (SerialAT.available()) {
+        char line[AT_LINE_MAX];
+        line[SerialAT.readBytesUntil('\n', line, sizeof(line) - 1)] = '\0';
+        if (strstr(line, "PB DONE")) {
+          ready = true;
+          break;
+        }
+      }
+      delay(100);
+    }
+    
+    if (ready) {
+      LOG_INFO("Modem: Ready - PB DONE received");
+    } else {
+      LOG_WARN("Modem: Warning - PB DONE timeout after 30s");
+    }
+    
+    delay(2000);
   }
   
-  delay(2000);
-  
   Serial.println("Initializing modem...");
   if (!modem.init()) {
     Serial.println("❌ Failed to initialize modem");
-    logToSD("Modem: ERROR - Initialization failed");
+    LOG_ERROR("Modem: ERROR - Initialization failed");
     return;
   }
-  logToSD("Modem: Initialized successfully");
+  LOG_INFO("Modem: Initialized successfully");
+  atEngine.setUrcHandler(onModemUrc);
+  atEngine.setTimingHook(onAtTiming);
+  if (!modemWarm) negotiateModemBaud();
+  enableModemSleep();
   
-  Serial.print("Waiting for network...");
-  if (!modem.waitForNetwork()) {
-    Serial.println(" fail");
-    logToSD("Network: ERROR - Network registration failed");
-    return;
+  // Receiver first: it searches while the network registers and Firebase signs in
+  startGPS();
+  
+  // Registration and the data context survive a warm restart; only confirm them
+  if (modemWarm && warmState.networkRegistered && modem.isNetworkConnected()) {
+    Serial.println("✓ Network still registered");
+  } else {
+    Serial.print("Waiting for network...");
+    if (!modem.waitForNetwork()) {
+      Serial.println(" fail");
+      LOG_ERROR("Network: ERROR - Network registration failed");
+      return;
+    }
+    Serial.println(" success");
+    LOG_INFO("Network: Registered successfully");
   }
-  Serial.println(" success");
-  logToSD("Network: Registered successfully");
   
-  Serial.printf("Connecting to APN: %s\n", apn);
-  if (!modem.gprsConnect(apn, gprsUser, gprsPass)) {
-    Serial.println("❌ GPRS connection failed");
-    logToSD("Network: ERROR - GPRS connection failed");
-    return;
+  if (modemWarm && warmState.gprsConnected && modem.isGprsConnected()) {
+    Serial.println("✓ GPRS still connected");
+  } else {
+    Serial.printf("Connecting to APN: %s\n", apn);
+    if (!modem.gprsConnect(apn, gprsUser, gprsPass)) {
+      Serial.println("❌ GPRS connection failed");
+      LOG_ERROR("Network: ERROR - GPRS connection failed");
+      return;
+    }
+    Serial.println("✓ GPRS connected");
   }
-  Serial.println("✓ GPRS connected");
+  
+#if GPS_AGPS_XTRA
+  // Fresh XTRA file over the new data link; the result arrives as a +CGPSXD URC
+  atEngine.submit("AT+CGPSXD=0", NULL, AT_DEFAULT_TIMEOUT_MS, NULL);
+#endif
   
   IPAddress local = modem.localIP();
-  Serial.printf("   Local IP: %s\n", local.toString().c_str());
-  logToSD("Network: GPRS connected - IP: " + local.toString());
+  Serial.printf("   Local IP: %u.%u.%u.%u\n", local[0], local[1], local[2], local[3]);
+  LOG_INFO("Network: GPRS connected - IP: %u.%u.%u.%u", local[0], local[1], local[2], local[3]);
 
-  // Get time from network
+  // Get time from network once; esp_timer carries it from here on
   Serial.println("\n⏰ Getting time from cellular network...");
-  currentDateTime = getTimeFromSIM7600();
-  currentDate = extractDateFromDateTime(currentDateTime);
-  Serial.printf("✓ Current time: %s\n", currentDateTime.c_str());
-  Serial.printf("✓ Current date: %s\n\n", currentDate.c_str());
+  bool timeSynced = syncNetworkTime();
+  lastTimeRefresh = millis();
   
-  if (currentDateTime == "Time unavailable") {
-    logToSD("Time: ERROR - Failed to get time from network");
+  char timeText[TIME_TEXT_MAX];
+  if (timeSynced) {
+    setCurrentDay(currentLocalDay());
+    Serial.printf("✓ Current time: %s\n", currentTimestamp(timeText, sizeof(timeText)));
+    Serial.printf("✓ Current date: %s\n\n", currentDate);
+    LOG_INFO("Time: Retrieved successfully - %s", timeText);
   } else {
-    logToSD("Time: Retrieved successfully - " + currentDateTime);
+    Serial.println("⚠️  Network time unavailable - retrying in the background\n");
+    LOG_ERROR("Time: ERROR - Failed to get time from network");
   }
 
-  // Try to get GPS location with extended timeout
-  Serial.println("🛰️  Acquiring GPS fix (90s timeout)...");
-  if (waitForGPSFix(90000)) {
-    gpsFixAcquired = true;
-    Serial.printf("✓ GPS Location: Lat=%s, Long=%s\n\n", gpsLatitude.c_str(), gpsLongitude.c_str());
-    logToSD("GPS: Fix acquired - Lat=" + gpsLatitude + ", Lon=" + gpsLongitude);
+  if (gpsSource != GPS_SOURCE_NONE) {
+    char lat[GPS_COORD_TEXT_MAX], lon[GPS_COORD_TEXT_MAX];
+    formatCoordinate(gpsFix.latE7, lat, sizeof(lat));
+    formatCoordinate(gpsFix.lonE7, lon, sizeof(lon));
+    Serial.printf("🛰️  GPS Location (%s): Lat=%s, Long=%s - refined in the background\n\n", gpsSourceName(), lat, lon);
   } else {
-    Serial.println("⚠️  GPS fix not acquired - using fallback coordinates\n");
-    gpsLatitude = "33.61095";
-    gpsLongitude = "73.061333";
-    logToSD("GPS: ERROR - No fix after 90s, using fallback coordinates");
+    Serial.println("🛰️  GPS acquiring in the background - Location is published with the first fix\n");
   }
   
   // Initialize Firebase
   Serial.println("Initializing Firebase...");
   Firebase.printf("Firebase Client v%s\n", FIREBASE_CLIENT_VERSION);
   
+#if TLS_TRANSPORT == TLS_TRANSPORT_MODEM
+  Serial.println("   Starting modem TLS service (AT+CCHSTART)...");
+  if (!modem_tls.begin()) {
+    Serial.println("   ⚠️  Modem TLS service not started - retried on first connect");
+    LOG_WARN("TLS: Warning - AT+CCHSTART failed");
+  }
+#else
   Serial.println("   Setting up SSL client...");
   ssl_client.setInsecure();
   ssl_client.setDebugLevel(1);
   ssl_client.setBufferSizes(2048, 1024);
-  ssl_client.setClient(&gsm_client);
+  ssl_client.setClient(&wire_client);
+  initTlsSessionCache();
+#endif
+  
+  // Keep one socket open across consecutive reports instead of a handshake per request
+  aClient.setSessionTimeout(TLS_KEEP_ALIVE_S);
   
   Serial.println("   Initializing Firebase app...");
-  Serial.printf("   API Key: %s...\n", String(API_KEY).substring(0, 10).c_str());
+  Serial.printf("   API Key: %.10s...\n", API_KEY);
   Serial.printf("   User Email: %s\n", USER_EMAIL);
   Serial.printf("   Database URL: %s\n", DATABASE_URL);
   
-  initializeApp(aClient, app, getAuth(user_auth), asyncCB, "authTask");
+  // A still-valid ID token from before the restart saves the sign-in round trip
+  uint32_t now = currentEpoch();
+  if (warmBoot && warmState.tokenExpiry && now && warmState.tokenExpiry > now + WARM_TOKEN_MIN_TTL_S) {
+    static IDToken id_token(API_KEY, warmState.idToken, warmState.tokenExpiry - now, warmState.refreshToken);
+    Serial.printf("   ♻️  Reusing cached ID token (%u s left)\n", warmState.tokenExpiry - now);
+    initializeApp(aClient, app, getAuth(id_token), asyncCB, "authTask");
+  } else {
+    initializeApp(aClient, app, getAuth(user_auth), asyncCB, "authTask");
+  }
   app.getApp<RealtimeDatabase>(Database);
   Database.url(DATABASE_URL);
+  app.getApp<FirebaseStorage>(Storage);
   
   Serial.println("✓ Firebase initialized");
+  
+#if UPLOAD_DELTA_MODE
+  // Nothing at boot depends on the server: authentication and the device
+  // info upload finish in the background (see uplinkTask), scans keep running
+  Serial.println("   Authentication continues in the background\n");
+  LOG_INFO("Firebase: Initialized, authenticating in background");
+#else
   Serial.println("   Waiting for authentication...\n");
-  logToSD("Firebase: Initialized, waiting for authentication");
+  LOG_INFO("Firebase: Initialized, waiting for authentication");
   
   // Wait for authentication (increased timeout to 60 seconds)
   unsigned long authStart = millis();
   while (!app.ready() && millis() - authStart < 60000) {
-    app.loop();
+    serviceUplink();
     
     // Show progress every 10 seconds
     if ((millis() - authStart) % 10000 < 100) {
@@ -323,40 +1010,32 @@ void setup() {
   
   if (app.ready()) {
     Serial.println("✓ Firebase authenticated and ready!\n");
-    logToSD("Firebase: Authenticated successfully");
+    LOG_INFO("Firebase: Authenticated successfully");
     
     // Load existing daily impressions from Firebase
-    String impressionsPath = "/devices/" + combinedBillboardId + "/data/" + currentDate + "/daily_impressions";
-    Serial.printf("📥 Loading existing impressions from: %s\n", impressionsPath.c_str());
+    char impressionsPath[FIREBASE_PATH_MAX];
+    snprintf(impressionsPath, sizeof(impressionsPath), "%s/data/%s/daily_impressions", devicePath, currentDate);
+    Serial.printf("📥 Loading existing impressions from: %s\n", impressionsPath);
     
-    int existingImpressions = Database.get<int>(aClient, impressionsPath.c_str());
+    int existingImpressions = Database.get<int>(aClient, impressionsPath);
     
-    if (aClient.lastError().code() == 0 && existingImpressions > 0) {
+    if (aClient.lastError().code() == 0 && existingImpressions > 0 && (uint32_t)existingImpressions > dailyImpressions) {
       dailyImpressions = existingImpressions;
       Serial.printf("✓ Loaded %d existing impressions - continuing from this count\n\n", dailyImpressions);
-      logToSD("Firebase: Loaded " + String(existingImpressions) + " existing impressions");
+      LOG_INFO("Firebase: Loaded %d existing impressions", existingImpressions);
     } else {
       Serial.println("ℹ️  No existing data found - starting fresh for today\n");
-      logToSD("Firebase: No existing data, starting fresh");
+      LOG_INFO("Firebase: No existing data, starting fresh");
     }
     
     // Upload device info once in setup
-    Serial.println("📤 Uploading device info to Firebase...");
-    String devicePath = "/devices/" + combinedBillboardId + "/device_info";
-    String deviceJson = buildDeviceInfoJSON();
-    Serial.printf("   Path: %s\n", devicePath.c_str());
-    Serial.printf("   JSON: %s\n", deviceJson.c_str());
-    
-    // Use object_t to send raw JSON
-    object_t json(deviceJson);
-    Database.set<object_t>(aClient, devicePath.c_str(), json, asyncCB, "deviceInfoTask");
-    deviceInfoUploaded = true;
+    uploadDeviceInfo();
     
     // Wait for device info upload to complete
     Serial.println("   Waiting for upload...");
     unsigned long uploadStart = millis();
     while (millis() - uploadStart < 5000) {
-      app.loop();
+      serviceUplink();
       delay(100);
     }
     Serial.println();
@@ -367,164 +1046,601 @@ void setup() {
     Serial.println("   2. Verify internet connectivity (GPRS working)");
     Serial.println("   3. Check Firebase project settings");
     Serial.println("   4. Look at error messages above\n");
-    logToSD("Firebase: ERROR - Authentication timeout after 60s");
+    LOG_ERROR("Firebase: ERROR - Authentication timeout after 60s");
   }
+#endif
   Serial.println("════════════════════════════════════════════════════════\n");
 }
 
 void loop() {
-  app.loop();
+  // All work runs on the pipeline tasks; free the Arduino loop task
+  vTaskDelete(NULL);
+}
+
+// ============ PIPELINE TASKS ============
+
+bool startPipelineTasks() {
+  /*
+   * Create the four pipeline tasks. Queues are created at the top of setup().
+   */
+  if (!scanEventQueue || !reportQueue || !logQueue || !scanRecordQueue) {
+    return false;
+  }
   
-  uint32_t currentTime = millis();
+  bool ok = true;
+  ok &= xTaskCreatePinnedToCore(sdTask, "sd", SD_TASK_STACK, NULL,
+                                SD_TASK_PRIORITY, &sdTaskHandle, APP_CORE) == pdPASS;
+  ok &= xTaskCreatePinnedToCore(aggregationTask, "aggregation", AGGREGATION_TASK_STACK, NULL,
+                                AGGREGATION_TASK_PRIORITY, &aggregationTaskHandle, APP_CORE) == pdPASS;
+  ok &= xTaskCreatePinnedToCore(scanTask, "scan", SCAN_TASK_STACK, NULL,
+                                SCAN_TASK_PRIORITY, &scanTaskHandle, RADIO_CORE) == pdPASS;
+  ok &= xTaskCreatePinnedToCore(uplinkTask, "uplink", UPLINK_TASK_STACK, NULL,
+                                UPLINK_TASK_PRIORITY, &uplinkTaskHandle, APP_CORE) == pdPASS;
+  return ok;
+}
+
+void scanTask(void* param) {
+  /*
+   * Core 0: WiFi scanning / probe capture. Hashes every address and hands
+   * only salted hashes to the aggregation task.
+   */
+  for (;;) {
+    uint32_t currentTime = millis();
+    uint32_t scanInterval = runtimeConfig.scanIntervalMs;
+    
+#if CAPTURE_MODE == CAPTURE_MODE_PROBE
+    // Sightings arrive continuously; each scan interval window counts as a scan
+    probeCaptureHop(currentTime);
+    drainProbeCapture();
+    
+    if (currentTime - lastScanTime >= scanInterval) {
+      closeProbeWindow();
+      lastScanTime = currentTime;
+    }
+#elif WIFI_SCAN_ASYNC
+    // Start the next sweep on schedule; results are collected when the radio is done
+    if (!scanInProgress && currentTime - lastScanTime >= scanInterval) {
+      if (startWiFiScan()) {
+        lastScanTime = currentTime;
+      }
+    }
+    
+    if (scanInProgress) {
+      pollWiFiScan();
+    }
+#else
+    // Perform WiFi scan
+    if (currentTime - lastScanTime >= scanInterval) {
+      performWiFiScan();
+      lastScanTime = currentTime;
+    }
+#endif
+    
+    // Between sweeps, block until the next one is due so the idle task can light-sleep the gap
+    uint32_t wait = SCAN_TASK_POLL_MS;
+#if CAPTURE_MODE != CAPTURE_MODE_PROBE
+    uint32_t sinceScan = millis() - lastScanTime;
+    if (!scanInProgress && sinceScan + SCAN_TASK_POLL_MS < scanInterval) wait = scanInterval - sinceScan;
+#endif
+    vTaskDelay(pdMS_TO_TICKS(wait));
+  }
+}
+
+void aggregationTask(void* param) {
+  /*
+   * Core 1: deduplication and cycle counters. Owns the aggregator, the
+   * sketches and the minute series; emits one CycleReport per
+   * runtimeConfig.scansPerUpload scans.
+   */
+  ScanEvent event;
   
-  // Auto-restart every 12 hours for system stability
-  if (currentTime - systemStartTime >= 43200000) { // 12 hours in milliseconds
-    Serial.println("\n⏰ 12-hour uptime reached - restarting for system stability...");
-    Serial.println("═══════════════════════════════════════════════════════\n");
-    delay(1000);
-    ESP.restart();
+  for (;;) {
+    if (xQueueReceive(scanEventQueue, &event, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    
+    if (event.type == SCAN_EVENT_SIGHTING) {
+      bool profiling = profilingEnabled;
+      uint32_t start = profiling ? ESP.getCycleCount() : 0;
+      aggregator.sighting(event.hash, event.rssi, event.band, uptimeSeconds());
+      minuteSeries.sighting(event.hash, event.rssi);
+      if (event.sketchHash) {
+        hourSketches[hourSketchCurrent].add(event.sketchHash);
+        daySketches[daySketchCurrent].add(event.sketchHash);
+      } else {
+        sketchSightingsUndated++;
+      }
+      if (profiling) profileSample(PROFILE_AGGREGATE, ESP.getCycleCount() - start);
+    } else {
+      closeScan(event.found);
+    }
   }
+}
+
+void uplinkTask(void* param) {
+  /*
+   * Core 1: everything on the SIM7600 UART - modem bring-up, Firebase,
+   * GPS and network time. A slow round trip here never delays a scan.
+   */
+  initConnectivity();
   
-  // Perform WiFi scan
-  if (currentTime - lastScanTime >= SCAN_INTERVAL_MS) {
-    performWiFiScan();
-    lastScanTime = currentTime;
-    scanCounter++;
+  CycleReport report;
+  for (;;) {
+    serviceConsole();
+    serviceModemPower();
     
-    // Upload every 10 scans
-    if (scanCounter >= SCANS_PER_UPLOAD) {
-      reportAnalytics();
+    // Nothing may touch the UART while the modem sleeps; serviceModemPower() wakes it for due work
+    if (modemAwake) {
+      serviceUplink();
+      serviceOutbox();
+      serviceSketches();
+      serviceMinuteSeries();
+      serviceRemoteConfig();
+      serviceOta();
+      serviceGPS();
+      
+      if (!deviceInfoUploaded && app.ready()) {
+        uploadDeviceInfo();
+      }
       
-      // Reset cycle tracking
-      previousCycleHashes = currentCycleHashes;
-      currentCycleHashes.clear();
-      wifiNetworksThisCycle = 0;
-      repeatedWifiNetworks = 0;
-      uniqueWifiNetworks = 0;
-      impressionCount = 0;
-      scanCounter = 0;
+      // Occasional resync for drift correction; fast retries until the first valid time
+      if (millis() - lastTimeRefresh >= (timeSync.syncs ? TIME_RESYNC_INTERVAL_MS : TIME_RETRY_INTERVAL_MS)) {
+        requestTimeUpdate();
+        lastTimeRefresh = millis();
+      }
+    }
+    
+    // Restart when the heap has actually degraded, or on a schedule if config sets one (restart_interval_h)
+    serviceHeapWatchdog();
+    uint32_t restartHours = runtimeConfig.restartIntervalH;
+    if (restartHours && uptimeSeconds() >= restartHours * 3600UL) {
+      Serial.printf("\n⏰ %u-hour uptime reached - scheduled restart...\n", restartHours);
+      Serial.println("═══════════════════════════════════════════════════════\n");
+      LOG_INFO("System: Scheduled %u-hour restart", restartHours);
+      delay(1000);
+      restartSystem();
+    }
+    
+    if (xQueueReceive(reportQueue, &report, pdMS_TO_TICKS(UPLINK_POLL_MS)) == pdTRUE) {
+      if (!modemAwake && reportUploadDue()) modemWake("report due");
+      reportAnalytics(report);
+    }
+  }
+}
+
+void sdTask(void* param) {
+  /*
+   * Core 1, lowest priority: the only task that touches the SD card.
+   * Lines go into the SdLogger RAM ring; the card only sees whole-sector
+   * writes (size threshold) or a periodic / requested flush.
+   */
+  LogMessage message;
+  ScanRecord record;
+  
+  for (;;) {
+    bool flushRequested = false;
+    if (xQueueReceive(logQueue, &message, pdMS_TO_TICKS(SD_TASK_POLL_MS)) == pdTRUE) {
+      if (message.text[0] == '\0') {
+        flushRequested = true;
+      } else {
+        sdLogAppend(message.text);
+      }
+    }
+    
+    while (xQueueReceive(scanRecordQueue, &record, 0) == pdTRUE) {
+      scanArchiveAppend(record);
+    }
+    
+    // Card latency: only passes that actually wrote are sampled
+    uint32_t writesBefore = sdLogBlockWrites() + scanArchiveRecordsWritten();
+    uint32_t start = micros();
+    
+    if (flushRequested) {
+      scanArchiveFlush();
+      sdLogFlush();
+      logFlushesCompleted++;
+    }
+    
+    uint32_t now = millis();
+    sdLogService(now);
+    scanArchiveService(now);
+    
+    if (sdLogBlockWrites() + scanArchiveRecordsWritten() != writesBefore) {
+      profileSample(PROFILE_SD_WRITE, micros() - start);
     }
   }
+}
+
+void sendScanEvent(uint8_t type, uint64_t hash, uint64_t sketchHash, int16_t found, int8_t rssi) {
+  ScanEvent event;
+  event.hash = hash;
+  event.sketchHash = sketchHash;
+  event.found = found;
+  event.rssi = rssi;
+  event.type = type;
+  event.band = proximityClassify(proximityTable, rssi);
   
-  yield();
-  delay(100);
+  // End-of-scan markers may wait briefly; sightings never block the radio
+  TickType_t wait = (type == SCAN_EVENT_END) ? pdMS_TO_TICKS(SCAN_TASK_POLL_MS) : 0;
+  if (xQueueSend(scanEventQueue, &event, wait) != pdTRUE) {
+    sightingsDropped++;
+  }
 }
 
+// ============ SCAN TASK ============
+
 void performWiFiScan() {
-  int networksFound = WiFi.scanNetworks();
-  totalScansPerformed++;
+  /*
+   * Blocking scan - holds the scan task for the whole channel sweep
+   */
+  powerHold(POWER_HOLD_SCAN, true);
+  scanStartUs = micros();
+  int networksFound = WiFi.scanNetworks(false, false, false, SCAN_DWELL_MS_PER_CHANNEL);
+  if (networksFound >= 0) profileSample(PROFILE_SCAN, micros() - scanStartUs);
+  processScanResults(networksFound);
+  powerHold(POWER_HOLD_SCAN, false);
+}
+
+bool startWiFiScan() {
+  /*
+   * Kick off a non-blocking scan; the scan task polls for completion
+   */
+  int16_t state = WiFi.scanNetworks(true, false, false, SCAN_DWELL_MS_PER_CHANNEL);
+  if (state == WIFI_SCAN_FAILED) {
+    scanErrors++;
+    Serial.printf("[WARN] WiFi async scan failed to start - Error Count: %u\n", scanErrors);
+    LOG_ERROR("WiFi Scan Error: async start failed");
+    return false;
+  }
+  
+  scanInProgress = true;
+  scanStartTime = millis();
+  scanStartUs = micros();
+  powerHold(POWER_HOLD_SCAN, true);
+  return true;
+}
+
+void pollWiFiScan() {
+  /*
+   * Collect async scan results once the radio reports completion
+   */
+  int16_t state = WiFi.scanComplete();
+  
+  if (state == WIFI_SCAN_RUNNING) {
+    if (millis() - scanStartTime < SCAN_TIMEOUT_MS) return;
+    
+    // Driver never signalled SCAN_DONE - drop this sweep and start fresh next tick
+    Serial.println("[WARN] WiFi async scan timed out");
+    WiFi.scanDelete();
+    state = WIFI_SCAN_FAILED;
+  }
+  
+  scanInProgress = false;
+  if (state >= 0) profileSample(PROFILE_SCAN, micros() - scanStartUs);
+  processScanResults(state);
+  powerHold(POWER_HOLD_SCAN, false);
+}
+
+void processScanResults(int networksFound) {
+  /*
+   * Hash scan results and forward them, followed by an end-of-scan marker
+   */
+  scanSequence++;
+  refreshSketchKey();
   
   if (networksFound < 0) {
     scanErrors++;
     Serial.printf("[WARN] WiFi scan error (code: %d) - Error Count: %u\n", 
                   networksFound, scanErrors);
-    logToSD("WiFi Scan Error: code " + String(networksFound));
+    LOG_ERROR("WiFi Scan Error: code %d", networksFound);
+    sendScanEvent(SCAN_EVENT_END, 0, 0, networksFound, 0);
     return;
   }
   
   if (networksFound == 0) {
     Serial.println("[INFO] No WiFi networks detected in this scan");
-    logToSD("WiFi Scan: No networks found");
+    LOG_WARN("WiFi Scan: No networks found");
+    sendScanEvent(SCAN_EVENT_END, 0, 0, 0, 0);
     return;
   }
   
   // Process valid scan results
-  Serial.printf("[SCAN %u/%u] Found %d network(s) - Total Scans: %u\n", 
-                scanCounter + 1, SCANS_PER_UPLOAD, networksFound, totalScansPerformed);
-  impressionCount += networksFound;
+  Serial.printf("[SCAN #%u] Found %d network(s)\n", scanSequence, networksFound);
   
-  int uniqueInThisScan = 0;
-  int repeatedInThisScan = 0;
-  int processCount = (networksFound > MAX_NETWORKS_PER_SCAN) ? 
-                     MAX_NETWORKS_PER_SCAN : networksFound;
-  
-  for (int i = 0; i < processCount; i++) {
-    uint8_t* bssid = WiFi.BSSID(i);
-    String ssid = WiFi.SSID(i);
-    int32_t rssi = WiFi.RSSI(i);
-    
-    String hashedBSSID = hashMAC(bssid);
+  /*
+   * Every record is processed, however dense the site, so impressions and
+   * uniques count the same APs. The core has already copied the driver's
+   * list (esp_wifi_scan_get_ap_records) into its wifi_ap_record_t array;
+   * it is walked in SCAN_RESULT_CHUNK steps reading only BSSID and RSSI
+   * (no SSID String), waiting for queue space between chunks instead of
+   * dropping sightings, and freed as soon as the walk is done.
+   */
+  bool profiling = profilingEnabled;
+  for (int start = 0; start < networksFound; start += SCAN_RESULT_CHUNK) {
+    int end = start + SCAN_RESULT_CHUNK < networksFound ? start + SCAN_RESULT_CHUNK : networksFound;
+    waitForScanEventSpace(end - start);
     
-    if (currentCycleHashes.find(hashedBSSID) != currentCycleHashes.end()) {
-      repeatedInThisScan++;
-    } else {
-      uniqueInThisScan++;
-      currentCycleHashes.insert(hashedBSSID);
+    for (int i = start; i < end; i++) {
+      const wifi_ap_record_t* record = (const wifi_ap_record_t*)WiFi.getScanInfoByIndex(i);
+      if (record == NULL) continue;
+      
+      uint32_t hashStart = profiling ? ESP.getCycleCount() : 0;
+      uint64_t bssidHash = hashMAC(record->bssid);
+      uint64_t sketchHash = sketchHashMAC(record->bssid);
+      if (profiling) profileSample(PROFILE_HASH, ESP.getCycleCount() - hashStart);
+      sendScanEvent(SCAN_EVENT_SIGHTING, bssidHash, sketchHash, 0, record->rssi);
+      
+#if SCAN_PRINT_SIGHTINGS
+      char hashHex[MAC_HASH_HEX_LEN + 1];
+      Serial.printf("   [%4d dBm] Hash: %.12s\n", record->rssi, formatMacHash(bssidHash, hashHex));
+#endif
+    }
+  }
+  WiFi.scanDelete();
+  
+  sendScanEvent(SCAN_EVENT_END, 0, 0, networksFound, 0);
+}
+
+void waitForScanEventSpace(size_t events) {
+  /*
+   * Back-pressure for a dense scan: give the aggregation task up to one
+   * scan tick to make room for the next chunk, then send regardless
+   */
+  unsigned long waitStart = millis();
+  while (uxQueueSpacesAvailable(scanEventQueue) < events && millis() - waitStart < SCAN_TASK_POLL_MS) {
+    vTaskDelay(1);
+  }
+}
+
+void drainProbeCapture() {
+  /*
+   * Pull captured probe requests off the ring and hash them immediately.
+   * A phone is forwarded once per window, however many probes it sends.
+   */
+  ProbeSighting batch[PROBE_DRAIN_BATCH];
+  size_t n;
+  refreshSketchKey();
+  
+  while ((n = probeCaptureDrain(batch, PROBE_DRAIN_BATCH)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      uint64_t deviceHash = hashMAC(batch[i].mac);
+      probeWindowSightings++;
       
-      if (previousCycleHashes.find(hashedBSSID) == previousCycleHashes.end()) {
-        totalWifiNetworks++;
+      HashInsert result = probeWindowHashes.insert(deviceHash);
+      if (result == HashInsert::Present) {
+        continue;
       }
+      if (result == HashInsert::Full) {
+        // New or a repeat, the table cannot tell: neither counted nor forwarded
+        probeOverflows++;
+        continue;
+      }
+      
+      probeWindowDevices++;
+      sendScanEvent(SCAN_EVENT_SIGHTING, deviceHash, sketchHashMAC(batch[i].mac), 0, batch[i].rssi);
     }
     
-    Serial.printf("   [%s] Hash: %s\n", ssid.c_str(), 
-                  hashedBSSID.substring(0, 12).c_str());
+    // Raw addresses are not kept past hashing
+    memset(batch, 0, sizeof(batch));
+  }
+}
+
+void closeProbeWindow() {
+  /*
+   * End one probe window; the aggregation task treats it like a completed scan
+   */
+  scanSequence++;
+  
+  Serial.printf("[PROBE #%u] %u device(s) from %u probe(s) - Dropped: %u\n",
+                scanSequence, probeWindowDevices, probeWindowSightings, probeCaptureDropped());
+  
+  sendScanEvent(SCAN_EVENT_END, 0, 0, (int16_t)probeWindowDevices, 0);
+  
+  probeWindowHashes.clear();
+  probeWindowSightings = 0;
+  probeWindowDevices = 0;
+}
+
+// ============ AGGREGATION TASK ============
+
+void closeScan(int networksFound) {
+  /*
+   * Fold one finished scan into the cycle counters; a complete cycle goes to the uplink
+   */
+  ScanTotals scan;
+  aggregator.setScansPerCycle(runtimeConfig.scansPerUpload);
+  bool cycleComplete = aggregator.scanEnded(networksFound, uptimeSeconds(), scan);
+  
+  if (networksFound > 0) {
+    // Log scan results to SD card
+    logScanToSD(networksFound, scan.unique, scan.repeated);
   }
   
-  wifiNetworksThisCycle += networksFound;
-  uniqueWifiNetworks += uniqueInThisScan;
-  repeatedWifiNetworks += repeatedInThisScan;
+  archiveScan(scan);
+  rotateSketches();
+  minuteSeries.scanEnded(networksFound < 0, currentEpoch() / 60);
   
-  // Log scan results to SD card
-  logScanToSD(networksFound, uniqueInThisScan, repeatedInThisScan);
+  if (cycleComplete) {
+    // Snapshot and reset the cycle (swaps the dedup generations, no copy)
+    CycleReport report;
+    aggregator.takeReport(report);
+    report.scanErrors = scanErrors;
+    emitCycleReport(report);
+  }
 }
 
-String hashMAC(const uint8_t* macAddr) {
-  const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
-  const uint64_t FNV_PRIME = 0x100000001b3ULL;
+void archiveScan(const ScanTotals& scan) {
+  /*
+   * Hand a fixed-size ScanRecord to the SD task for /scans/YYYY-MM-DD.bin.
+   * Every scan is archived, including empty and failed ones.
+   */
+  if (!sdCardAvailable) return;
   
-  uint64_t hash = FNV_OFFSET_BASIS;
+  ScanRecord record;
+  memset(&record, 0, sizeof(record));
+  record.timestamp = currentEpoch();
+  record.uptimeMs = millis();
+  record.scanIndex = scan.scanIndex;
+  record.saltEpoch = saltEpoch;
+  record.found = scan.found;
+  record.unique = scan.unique > 0xFFFF ? 0xFFFF : scan.unique;
+  record.repeated = scan.repeated > 0xFFFF ? 0xFFFF : scan.repeated;
+#if CAPTURE_MODE == CAPTURE_MODE_PROBE
+  record.flags = SCAN_RECORD_FLAG_PROBE;
+#endif
+  memcpy(record.rssiHistogram, scan.rssiHistogram, sizeof(record.rssiHistogram));
   
-  for (int i = 0; i < 6; i++) {
-    hash ^= macAddr[i];
-    hash *= FNV_PRIME;
+  if (xQueueSend(scanRecordQueue, &record, 0) != pdTRUE) {
+    scanRecordsDropped++;
+  }
+}
+
+void emitCycleReport(CycleReport& report) {
+  /*
+   * Hand the finished cycle to the uplink task. If its queue is full
+   * (e.g. modem still booting), fold the cycle into a pending report
+   * instead of losing the counts.
+   */
+  if (hasPendingReport) {
+    cycleReportMerge(pendingReport, report);
+    report = pendingReport;
+    reportsMerged++;
   }
   
-  uint8_t* saltBytes = (uint8_t*)&ephemeralSalt;
-  for (int i = 0; i < 4; i++) {
-    hash ^= saltBytes[i];
-    hash *= FNV_PRIME;
+  if (xQueueSend(reportQueue, &report, 0) == pdTRUE) {
+    hasPendingReport = false;
+  } else {
+    pendingReport = report;
+    hasPendingReport = true;
+  }
+}
+
+uint64_t hashMAC(const uint8_t* macAddr) {
+  /*
+   * Salted one-way hash of a MAC/BSSID - see MacHash.h
+   */
+  return macHashSalted(macAddr, ephemeralSalt);
+}
+
+uint64_t sketchHashMAC(const uint8_t* macAddr) {
+  /*
+   * Hash for the unique sketches: keyed per local day with a fleet-wide
+   * key instead of the boot salt, so sketches from restarts and other
+   * billboards merge. Only register maxima leave the device.
+   */
+  if (sketchKey == 0) return 0;
+  return macHashSalted(macAddr, sketchKey);
+}
+
+void refreshSketchKey() {
+  /*
+   * Scan task, once per scan: derive today's sketch key from the local day
+   */
+  int32_t day = currentLocalDay();
+  sketchKey = day == TIME_NO_DAY ? 0 : ((uint32_t)macHashAvalanche(((uint64_t)HLL_SKETCH_KEY << 32) | (uint32_t)day) | 1);
+}
+
+void rotateSketches() {
+  /*
+   * Aggregation task, after every scan: close the sketches at local hour
+   * and day boundaries. A closed sketch is left alone until the uplink
+   * frees its slot; if the previous one is still waiting, the period that
+   * just ended is dropped instead of overwriting it.
+   */
+  int32_t hour = currentLocalHour();
+  if (hour < 0) return;
+  if (sketchHour < 0) {
+    sketchHour = hour;
+    return;
   }
+  if (hour == sketchHour) return;
   
-  char hexBuffer[17];
-  sprintf(hexBuffer, "%016llx", hash);
+  if (closedSketchHour < 0) {
+    hourSketchCurrent ^= 1;
+    hourSketches[hourSketchCurrent].clear();
+    closedSketchHour = sketchHour;
+  } else {
+    hourSketches[hourSketchCurrent].clear();
+    sketchesDropped++;
+  }
   
-  return String(hexBuffer);
+  if (hour / 24 != sketchHour / 24) {
+    if (closedSketchDay == TIME_NO_DAY) {
+      daySketchCurrent ^= 1;
+      daySketches[daySketchCurrent].clear();
+      closedSketchDay = sketchHour / 24;
+    } else {
+      daySketches[daySketchCurrent].clear();
+      sketchesDropped++;
+    }
+  }
+  sketchHour = hour;
 }
 
-void reportAnalytics() {
+void reportAnalytics(const CycleReport& report) {
   reportCounter++;
   totalReportsGenerated++;
-  dailyImpressions += impressionCount;
+  
+  // Day first: a cycle that closes after midnight counts for the new day only
+  rollDailyTotals();
+  dailyImpressions += report.impressions;
+  addImpressionDelta(currentDate, report.impressions);
+  visitStatsMerge(dailyVisits, report.visits);
+  for (size_t i = 0; i < PROXIMITY_BANDS; i++) dailyProximity[i] += report.proximity[i];
   
   Serial.println("\n╔════════════════════════════════════════════════════════╗");
   Serial.println("║            ANALYTICS REPORT - PRIVACY CERTIFIED        ║");
   Serial.println("╚════════════════════════════════════════════════════════╝\n");
   
-  // Update GPS before upload
-  Serial.println("🛰️  Updating GPS location...");
-  if (updateGPSLocation()) {
-    Serial.printf("✓ GPS Updated: Lat=%s, Long=%s\n", gpsLatitude.c_str(), gpsLongitude.c_str());
-    gpsFixAcquired = true;
-  } else {
-    Serial.println("⚠️  GPS update failed - using last known location");
-  }
+  // Published position; serviceGPS() refreshes it on its own cadence
+  char lat[GPS_COORD_TEXT_MAX], lon[GPS_COORD_TEXT_MAX];
+  formatCoordinate(gpsFix.latE7, lat, sizeof(lat));
+  formatCoordinate(gpsFix.lonE7, lon, sizeof(lon));
   
   // Display statistics
   Serial.println("\n📈 10-SCAN CYCLE STATISTICS (Last 10 Scans):");
-  Serial.printf("   ├─ Total Detections (Impressions):    %u\n", impressionCount);
-  Serial.printf("   ├─ WiFi Networks Found:                %u\n", wifiNetworksThisCycle);
-  Serial.printf("   ├─ Unique Networks (New):              %u\n", uniqueWifiNetworks);
-  Serial.printf("   ├─ Repeated Networks (Seen Before):    %u\n", repeatedWifiNetworks);
-  Serial.printf("   └─ Total Unique Networks (Cumulative): %u\n\n", totalWifiNetworks);
+  Serial.printf("   ├─ Total Detections (Impressions):    %u\n", report.impressions);
+  Serial.printf("   ├─ WiFi Networks Found:                %u\n", report.networks);
+  Serial.printf("   ├─ Unique Networks (New):              %u\n", report.unique);
+  Serial.printf("   ├─ Repeated Networks (Seen Before):    %u\n", report.repeated);
+  Serial.printf("   ├─ Viewing Range / Nearby / Far:       %u / %u / %u\n", report.proximity[PROXIMITY_VIEWING],
+                report.proximity[PROXIMITY_NEARBY], report.proximity[PROXIMITY_FAR]);
+  if (report.cyclesMerged > 1) {
+    Serial.printf("   ├─ Cycles Merged (Uplink Backlog):     %u\n", report.cyclesMerged);
+  }
+  Serial.printf("   ├─ Visitors Present / New / Returning: %u / %u / %u\n", report.visitorsPresent,
+                report.visits.newVisitors, report.visits.returningVisitors);
+  Serial.printf("   ├─ Visits Ended (Pass-by / Lingering): %u (%u / %u), avg dwell %u s\n", report.visits.visitsClosed,
+                report.visits.passBy, report.visits.lingering,
+                report.visits.visitsClosed ? report.visits.dwellTotalS / report.visits.visitsClosed : 0);
+  Serial.printf("   ├─ Total Unique Networks (Cumulative): %u\n", report.totalUnique);
+  Serial.printf("   └─ Unique Devices (est.) Hour / Day:   %u / %u\n\n", hourSketches[hourSketchCurrent].estimate(),
+                daySketches[daySketchCurrent].estimate());
   
   Serial.println("📊 SYSTEM STATISTICS (Cumulative):");
-  Serial.printf("   ├─ Total Scans Performed:      %u\n", totalScansPerformed);
+  Serial.printf("   ├─ Total Scans Performed:      %u\n", report.totalScans);
   Serial.printf("   ├─ Reports Generated:          %u\n", totalReportsGenerated);
   Serial.printf("   ├─ Daily Impressions:          %u\n", dailyImpressions);
-  Serial.printf("   ├─ Combined Billboard ID:      %s\n", combinedBillboardId.c_str());
-  Serial.printf("   ├─ GPS Location:               %s, %s\n", gpsLatitude.c_str(), gpsLongitude.c_str());
-  Serial.printf("   ├─ GPS Status:                 %s\n", gpsFixAcquired ? "LOCKED" : "SEARCHING");
-  Serial.printf("   └─ Total Data Sent:            %.2f KB\n\n", totalDataSent / 1024.0);
+  Serial.printf("   ├─ Combined Billboard ID:      %s\n", combinedBillboardId);
+  Serial.printf("   ├─ GPS Location:               %s, %s\n", lat, lon);
+  Serial.printf("   ├─ GPS Status:                 %s (%s, %u fixes)\n", gpsTrackStateName(gpsTracker.state),
+                gpsSourceName(), gpsTracker.samples);
+  if (gpsFix.hdopX100 > 0) {
+    Serial.printf("   ├─ GPS HDOP / Satellites:      %u.%02u / %u\n", gpsFix.hdopX100 / 100, gpsFix.hdopX100 % 100, gpsFix.satellites);
+  }
+  Serial.printf("   ├─ Scan Errors:                %u\n", report.scanErrors);
+  Serial.printf("   ├─ Dedup Table Overflows:      %u\n", report.dedupOverflows);
+#if CAPTURE_MODE == CAPTURE_MODE_PROBE
+  Serial.printf("   ├─ Probe Frames Captured:      %u\n", probeCaptureFrames());
+  Serial.printf("   ├─ Probe Frames Dropped:       %u\n", probeCaptureDropped());
+#endif
+#if TLS_TRANSPORT == TLS_TRANSPORT_ESP32
+  Serial.printf("   ├─ Cellular Data (wire):       %.2f KB sent / %.2f KB received\n",
+                wire_client.bytesSent() / 1024.0, wire_client.bytesReceived() / 1024.0);
+#endif
+  Serial.printf("   ├─ Modem UART Traffic:         %.2f KB out / %.2f KB in\n",
+                modem_uart.bytesSent() / 1024.0, modem_uart.bytesReceived() / 1024.0);
+  Serial.printf("   └─ TLS Handshakes:             %u full / %u resumed\n\n", tlsFullHandshakes, tlsResumedHandshakes);
   
   Serial.println("🔐 PRIVACY & SECURITY STATUS:");
   Serial.println("   ├─ MAC Address Protection:     ONE-WAY HASHED ✓");
@@ -534,436 +1650,2582 @@ void reportAnalytics() {
   Serial.println("   ├─ Cross-Session Tracking:     PREVENTED ✓");
   Serial.println("   └─ CCPA Compliance:            VERIFIED ✓\n");
   
-  if (app.ready()) {
-    // Update time before upload
-    currentDateTime = getTimeFromSIM7600();
-    String newDate = extractDateFromDateTime(currentDateTime);
-    
-    // Only process day change if we got valid time
-    if (newDate != "Unknown" && currentDateTime != "Time unavailable") {
-      // Check for day change
-      if (newDate != currentDate && currentDate.length() > 0) {
-        Serial.printf("📅 New day detected - loading data for new date (was %s, now %s)\n", currentDate.c_str(), newDate.c_str());
-        currentDate = newDate;
-        
-        // Load existing impressions for the new day
-        String impressionsPath = "/devices/" + combinedBillboardId + "/data/" + currentDate + "/daily_impressions";
-        Serial.printf("📥 Loading impressions for new day from: %s\n", impressionsPath.c_str());
-        
-        int existingImpressions = Database.get<int>(aClient, impressionsPath.c_str());
-        
-        if (aClient.lastError().code() == 0 && existingImpressions > 0) {
-          dailyImpressions = existingImpressions;
-          Serial.printf("✓ Loaded %d existing impressions for new day\n", dailyImpressions);
-        } else {
-          dailyImpressions = 0;
-          Serial.println("ℹ️  No existing data for new day - starting fresh\n");
-        }
-      } else if (currentDate.length() == 0) {
-        currentDate = newDate;
-      }
-      
-      // Only upload if we have valid date
-      if (currentDate.length() > 0 && currentDate != "Unknown") {
-        String json = buildDailyDataJSON();
-        Serial.println("📡 Uploading daily data to Firebase...");
-        Serial.println(json);
-        Serial.println();
-        
-        // Upload to daily data path: /devices/BILLBOARD_ID/data/DATE
-        String path = "/devices/" + combinedBillboardId + "/data/" + currentDate;
-        Serial.printf("📤 Path: %s\n", path.c_str());
-        
-        // Use object_t to send raw JSON
-        object_t jsonObj(json);
-        Database.set<object_t>(aClient, path.c_str(), jsonObj, asyncCB, "dailyDataTask");
-        
-        // Update GPS location in device_info after every data push
-        String locationPath = "/devices/" + combinedBillboardId + "/device_info/Location";
-        String locationJson = "{\"Lat\":\"" + gpsLatitude + "\",\"Long\":\"" + gpsLongitude + "\"}";
-        Serial.printf("📍 Updating location: %s\n", locationPath.c_str());
-        object_t locationObj(locationJson);
-        Database.set<object_t>(aClient, locationPath.c_str(), locationObj, asyncCB, "locationUpdateTask");
-        
-        // Wait for uploads to complete (reduced to 3 seconds to prevent blocking)
-        Serial.println("   Waiting for uploads to complete...");
-        unsigned long uploadWaitStart = millis();
-        while (millis() - uploadWaitStart < 3000) {
-          app.loop();
-          delay(50);
-        }
-        
-        totalDataSent += json.length() + locationJson.length() + 400; // Approximate overhead
-      } else {
-        Serial.println("⚠️  Skipping upload - no valid date available, will retry next cycle\n");
+  printTaskHealth();
+  printTransportBenchmark();
+  
+  samplePowerCycle(lastPowerCycle);
+  uint32_t cycleMs = lastPowerCycle.elapsedMs ? lastPowerCycle.elapsedMs : 1;
+  Serial.println("⚡ POWER (since last report, estimated):");
+  Serial.printf("   ├─ ESP32 Awake:                %u / %u ms (%u%%)%s\n", lastPowerCycle.awakeMs, lastPowerCycle.elapsedMs,
+                (uint32_t)((uint64_t)lastPowerCycle.awakeMs * 100 / cycleMs), lightSleepActive ? "" : " - no light sleep");
+  Serial.printf("   ├─ Modem Awake:                %u / %u ms (%u%%), %u sleep(s) total\n", lastPowerCycle.modemAwakeMs,
+                lastPowerCycle.elapsedMs, (uint32_t)((uint64_t)lastPowerCycle.modemAwakeMs * 100 / cycleMs), modemSleeps);
+  Serial.printf("   ├─ Charge This Cycle:          %.3f mAh (avg %.1f mA)\n", lastPowerCycle.mAh,
+                lastPowerCycle.mAh * 3600000.0f / cycleMs);
+  Serial.printf("   └─ Charge Since Boot:          %.1f mAh\n\n", powerTotalMah);
+  printProfile();
+  
+  // Persist first: the cycle survives a failed upload or a reboot
+  queueReportToOutbox(report);
+  adaptUploadInterval(report);
+  
+  if (!app.ready()) {
+    Serial.println("⚠️  Firebase not ready - skipping upload\n");
+  } else if (currentDay == TIME_NO_DAY) {
+    Serial.println("⚠️  No valid date yet - skipping upload, will retry next cycle\n");
+  } else if (!reportUploadDue()) {
+    // Held back: the cycle waits in the outbox and its impressions in the pending delta
+    reportsDeferred++;
+    Serial.printf("⏸️  Report deferred (interval %u s, next in %u s, %u cycle(s) queued)\n\n",
+                  uploadIntervalMs / 1000, (uploadIntervalMs - (millis() - lastReportUpload)) / 1000, outboxPending());
+  } else {
+    // Daily data, location, diagnostics and the oldest outbox batch in one PATCH
+    static OutboxEntry batch[OUTBOX_BATCH];
+    size_t count = 0;
+    uint32_t firstSeq = 0;
+    int batchId = outboxAvailable ? outboxNextBatch(millis(), batch, &count, &firstSeq) : -1;
+    
+    uint32_t buildStart = ESP.getCycleCount();
+    bool built = buildReportUpdate(lat, lon, batch, batchId >= 0 ? count : 0);
+    profileSample(PROFILE_REPORT_JSON, ESP.getCycleCount() - buildStart);
+    if (built) {
+      char uid[32];
+      snprintf(uid, sizeof(uid), "report:%d:%u", batchId, firstSeq);
+      
+      Serial.printf("📡 Uploading report to %s (%u B, %u outbox cycle(s))...\n", devicePath, uploadBody.length(),
+                    batchId >= 0 ? count : 0);
+      Serial.println(uploadBody.c_str());
+      Serial.println();
+      
+      uint32_t sentBefore = modem_uart.bytesSent();
+      uint32_t receivedBefore = modem_uart.bytesReceived();
+      
+      object_t updateObj(uploadBody.c_str());
+      reportUploadPending = true;
+      reportUploadStart = millis();
+      lastReportUpload = reportUploadStart;
+      reportUploadSent = true;
+      Database.update<object_t>(aClient, devicePath, updateObj, onReportResult, uid);
+      
+      // Returns as soon as the update is acknowledged
+      unsigned long uploadWaitStart = millis();
+      while (reportUploadPending && millis() - uploadWaitStart < REPORT_UPLOAD_WAIT_MS) {
+        serviceUplink();
+        delay(50);
       }
+      
+      uint32_t uartBytes = (modem_uart.bytesSent() - sentBefore) + (modem_uart.bytesReceived() - receivedBefore);
+      if (!reportUploadPending) reportUartBytesTotal += uartBytes;
+      Serial.printf("📶 Report round trip: %u B out, %u B in on the modem UART (%lu ms)\n\n",
+                    modem_uart.bytesSent() - sentBefore, modem_uart.bytesReceived() - receivedBefore,
+                    millis() - uploadWaitStart);
     } else {
-      Serial.println("⚠️  Time retrieval failed - skipping upload, will retry next cycle\n");
+      settleImpressionDeltas(false);
+      if (batchId >= 0) outboxFail(batchId, firstSeq, millis());
+      Serial.println("❌ Report update exceeds UPLOAD_JSON_MAX - skipped\n");
+      LOG_ERROR("Upload: ERROR - report update too large");
     }
-  } else {
-    Serial.println("⚠️  Firebase not ready - skipping upload\n");
   }
   
   Serial.println("════════════════════════════════════════════════════════\n");
   
   // Log report to SD card
   if (sdCardAvailable) {
-    logToSD("--- ANALYTICS REPORT ---");
-    logToSD("Impressions (10-scan): " + String(impressionCount));
-    logToSD("Daily Impressions: " + String(dailyImpressions));
-    logToSD("Unique Networks: " + String(uniqueWifiNetworks));
-    logToSD("GPS: " + gpsLatitude + ", " + gpsLongitude);
-    logToSD("Total Scans: " + String(totalScansPerformed));
-    logToSD("Total Data Sent: " + String(totalDataSent / 1024.0) + " KB");
+    LOG_INFO("--- ANALYTICS REPORT ---");
+    LOG_INFO("Impressions (cycle): %u", report.impressions);
+    LOG_INFO("Daily Impressions: %u", dailyImpressions);
+    LOG_INFO("Unique Networks: %u", report.unique);
+    LOG_INFO("GPS: %s, %s", lat, lon);
+    LOG_INFO("Total Scans: %u", report.totalScans);
+    LOG_INFO("Total Data Sent: %.2f KB", linkBytesSent() / 1024.0);
   }
 }
 
-String buildDailyDataJSON() {
+void printTaskHealth() {
   /*
-   * JSON Daily Analytics Payload - Optimized for Firebase structure
+   * Stack headroom (bytes never used) and queue backlog per pipeline task
    */
-  String json = "{";
-  json += "\"billboard_id\":\"" + combinedBillboardId + "\",";
-  json += "\"date\":\"" + currentDate + "\",";
-  json += "\"daily_impressions\":" + String(dailyImpressions) + ",";
-  json += "\"last_updated\":\"" + currentDateTime + "\"";
-  json += "}";
-  return json;
+  Serial.println("🧵 TASK HEALTH:");
+  Serial.printf("   ├─ Scan Stack Free:            %u B\n", uxTaskGetStackHighWaterMark(scanTaskHandle));
+  Serial.printf("   ├─ Aggregation Stack Free:     %u B\n", uxTaskGetStackHighWaterMark(aggregationTaskHandle));
+  Serial.printf("   ├─ Uplink Stack Free:          %u B\n", uxTaskGetStackHighWaterMark(uplinkTaskHandle));
+  Serial.printf("   ├─ SD Stack Free:              %u B\n", uxTaskGetStackHighWaterMark(sdTaskHandle));
+  Serial.printf("   ├─ Scan Event Queue:           %u/%u\n", uxQueueMessagesWaiting(scanEventQueue), SCAN_EVENT_QUEUE_LENGTH);
+  Serial.printf("   ├─ Report Queue:               %u/%u\n", uxQueueMessagesWaiting(reportQueue), REPORT_QUEUE_LENGTH);
+  Serial.printf("   ├─ Log Queue:                  %u/%u\n", uxQueueMessagesWaiting(logQueue), LOG_QUEUE_LENGTH);
+  Serial.printf("   ├─ Sightings Dropped:          %u\n", sightingsDropped);
+  Serial.printf("   ├─ Log Lines Dropped:          %u\n", logMessagesDropped);
+  Serial.printf("   ├─ SD Log Buffered / Writes:   %u B / %u\n", sdLogBuffered(), sdLogBlockWrites());
+  Serial.printf("   ├─ SD Log Bytes Dropped:       %u\n", sdLogBytesDropped());
+  Serial.printf("   ├─ Scan Records Archived:      %u (dropped %u)\n", scanArchiveRecordsWritten(),
+                scanArchiveRecordsDropped() + scanRecordsDropped);
+  Serial.printf("   ├─ Reports Merged:             %u\n", reportsMerged);
+  Serial.printf("   ├─ Minute Buckets Queued:      %u/%u (dropped %u)\n", minuteSeries.pending() + seriesBatchCount,
+                MINUTE_SERIES_CAPACITY + MINUTE_FLUSH_BATCH, minuteSeries.dropped());
+  Serial.printf("   ├─ Outbox Pending / In Flight: %u / %u\n", outboxPending(), outboxInFlight());
+  Serial.printf("   └─ Outbox Delivered / Lost:    %u / %u\n\n", outboxDelivered(), outboxOverwritten());
 }
 
-String buildDeviceInfoJSON() {
+void printTransportBenchmark() {
   /*
-   * Device information for QR code access
+   * Figures for comparing TLS_TRANSPORT builds on the same site: latency
+   * and modem UART bytes per acknowledged report, and ESP32 heap (the
+   * ESP32 path carries BearSSL buffers, the modem path does not)
    */
-  String json = "{";
-  json += "\"billboard_id\":\"" + combinedBillboardId + "\",";
-  json += "\"device_name\":\"" + String(BILLBOARD_ID) + "\",";
-  json += "\"firmware\":\"" + String(FIRMWARE_VERSION) + "\",";
-  json += "\"mac_address\":\"" + deviceMacAddress + "\",";
-  json += "\"setup_time\":\"" + currentDateTime + "\",";
-  json += "\"status\":\"active\",";
-  json += "\"Location\":{";
-  json += "\"Lat\":\"" + gpsLatitude + "\",";
-  json += "\"Long\":\"" + gpsLongitude + "\"";
-  json += "}";
-  json += "}";
-  return json;
+  uint32_t acked = reportUploadsAcked ? reportUploadsAcked : 1;
+  Serial.println("🚀 TRANSPORT BENCHMARK:");
+  Serial.printf("   ├─ TLS Runs On:                %s\n", TLS_TRANSPORT == TLS_TRANSPORT_MODEM ? "SIM7600 (AT+CCH*)" : "ESP32 (ESP_SSLClient)");
+  Serial.printf("   ├─ Modem UART:                 %u baud, flow control %s\n", modemBaud, modemFlowControl ? "RTS/CTS" : "off");
+  Serial.printf("   ├─ Reports Acknowledged:       %u\n", reportUploadsAcked);
+  Serial.printf("   ├─ Report Interval / Deferred: %u s / %u%s\n", uploadIntervalMs / 1000, reportsDeferred,
+                uploadLinkPoor ? " (poor link)" : "");
+  Serial.printf("   ├─ Upload Latency avg / max:   %u / %u ms\n", reportLatencyTotalMs / acked, reportLatencyMaxMs);
+  Serial.printf("   ├─ UART Bytes per Report:      %u B\n", reportUartBytesTotal / acked);
+#if TLS_TRANSPORT == TLS_TRANSPORT_MODEM
+  Serial.printf("   ├─ Modem TLS Opens / Failed:   %u / %u\n", modem_tls.opens(), modem_tls.openFailures());
+#endif
+  Serial.printf("   └─ Free Heap now / min:        %u / %u B\n\n", ESP.getFreeHeap(), ESP.getMinFreeHeap());
 }
 
-String generateAccessKey() {
+void queueReportToOutbox(const CycleReport& report) {
   /*
-   * Generate unique access key for QR code authentication
+   * One OutboxEntry per cycle, keyed later by its date and (boot, cycle)
    */
-  return String(BILLBOARD_ID) + "_" + deviceMacAddress.substring(0, 8) + "_" + String(millis());
+  if (!outboxAvailable) return;
+  
+  OutboxEntry entry;
+  entry.timestamp = currentEpoch();
+  entry.uptimeMs = millis();
+  entry.bootId = saltEpoch;
+  entry.cycle = reportCounter;
+  entry.impressions = report.impressions;
+  entry.networks = report.networks;
+  entry.unique = report.unique;
+  entry.repeated = report.repeated;
+  
+  if (!outboxPush(entry)) {
+    Serial.println("⚠️  Outbox write failed - cycle kept in RAM totals only");
+    LOG_ERROR("Outbox: ERROR - write failed");
+  }
 }
 
-bool waitForGPSFix(unsigned long timeoutMs) {
+void serviceOutbox() {
   /*
-   * Wait for GPS fix with timeout (like backup code)
+   * Drain a backlog while the link is up: up to OUTBOX_MAX_IN_FLIGHT
+   * multi-path updates of OUTBOX_BATCH entries each, written under
+   * /devices/<id>/cycles/<date>/<boot>-<cycle>. Acks arrive in onOutboxResult().
+   * The newest batch is left for the next report to carry, so deferred
+   * reports are not undone by sending each cycle on its own.
    */
-  unsigned long start = millis();
-  unsigned long lastDot = 0;
-
-  Serial.print("Getting GPS fix");
+  if (!outboxAvailable || !app.ready() || atEngine.busy()) return;
   
-  // Enable GPS
-  SerialAT.println("AT+CGPS=1");
-  delay(2000);
-
-  while (millis() - start < timeoutMs) {
-    if (millis() - lastDot >= 1000) {
-      Serial.print(".");
-      lastDot = millis();
+  static OutboxEntry batch[OUTBOX_BATCH];
+  size_t count;
+  uint32_t firstSeq;
+  int batchId;
+  
+  while (outboxPending() > OUTBOX_BATCH * (outboxInFlight() + 1) &&
+         (batchId = outboxNextBatch(millis(), batch, &count, &firstSeq)) >= 0) {
+    JsonWriter& json = uploadBody;
+    json.reset();
+    json.append("{");
+    appendCycleEntries(json, batch, count, "");
+    if (!json.append("}")) {
+      outboxFail(batchId, firstSeq, millis());
+      break;
     }
+    
+    char uid[32];
+    snprintf(uid, sizeof(uid), "outbox:%d:%u", batchId, firstSeq);
+    
+    char path[FIREBASE_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/cycles", devicePath);
+    object_t batchObj(uploadBody.c_str());
+    Database.update<object_t>(aClient, path, batchObj, onOutboxResult, uid);
+    
+    Serial.printf("📤 Outbox: sending %u cycle(s) as %s (%u pending)\n", count, uid, outboxPending());
+  }
+}
 
-    SerialAT.println("AT+CGPSINFO");
-    delay(1000);
-
-    while (SerialAT.available()) {
-      String line = SerialAT.readStringUntil('\n');
-      line.trim();
-      if (line.isEmpty()) continue;
-
-      if (line.startsWith("+CGPSINFO:")) {
-        if (line.indexOf(",,,,,,,,,") != -1) break; // no fix yet
-
-        String data = line.substring(line.indexOf(':') + 1);
-        data.trim();
-
-        int i1 = data.indexOf(','), i2 = data.indexOf(',', i1 + 1);
-        int i3 = data.indexOf(',', i2 + 1), i4 = data.indexOf(',', i3 + 1);
-
-        String rawLat = data.substring(0, i1);
-        String latDir = data.substring(i1 + 1, i2);
-        String rawLon = data.substring(i2 + 1, i3);
-        String lonDir = data.substring(i3 + 1, i4);
-
-        if (rawLat.isEmpty() || rawLon.isEmpty()) break;
-
-        float latVal = rawLat.toFloat(), lonVal = rawLon.toFloat();
-        int latDeg = int(latVal / 100), lonDeg = int(lonVal / 100);
-        float latDec = latDeg + (latVal - latDeg * 100) / 60.0;
-        float lonDec = lonDeg + (lonVal - lonDeg * 100) / 60.0;
+void onOutboxResult(AsyncResult& aResult) {
+  /*
+   * Per-batch ack / retry for serviceOutbox(); other events go to asyncCB
+   */
+  int batchId;
+  unsigned firstSeq;
+  if (sscanf(aResult.uid().c_str(), "outbox:%d:%u", &batchId, &firstSeq) != 2) {
+    asyncCB(aResult);
+    return;
+  }
+  
+  if (aResult.isError()) {
+    Serial.printf("⚠️  Outbox batch %s failed (code %d) - will retry\n", aResult.uid().c_str(), aResult.error().code());
+    LOG_WARN("Outbox: batch %s failed, code %d", aResult.uid().c_str(), aResult.error().code());
+    outboxFail(batchId, firstSeq, millis());
+  } else if (aResult.available()) {
+    outboxAck(batchId, firstSeq);
+    Serial.printf("✓ Outbox batch delivered (%u pending)\n", outboxPending());
+  }
+}
 
-        if (latDir == "S") latDec *= -1;
-        if (lonDir == "W") lonDec *= -1;
+// ============ UNIQUE SKETCHES ============
 
-        gpsLatitude = String(latDec, 6);
-        gpsLongitude = String(lonDec, 6);
+template <uint8_t Precision>
+bool appendSketch(JsonWriter& json, const char* key, const HyperLogLog<Precision>& sketch) {
+  /*
+   * "<key>":{"p":..,"estimate":..,"registers":"<one base64 digit per register>"}
+   */
+  if (!json.member("\"%s\":{\"p\":%u,\"estimate\":%u,\"registers\":\"", key, (unsigned)Precision, sketch.estimate())) {
+    return false;
+  }
+  json.advance(sketch.encode(json.tail(), json.remaining()));
+  json.append("\"}");
+  return json.ok();
+}
 
-        float elapsed = (millis() - start) / 1000.0;
-        Serial.printf(" ✅ (%.1fs)\n", elapsed);
-        return true;
-      }
-    }
+bool buildSketchUpdate(const HyperLogLog<HLL_HOUR_PRECISION>* hour, int32_t hourIndex,
+                       const HyperLogLog<HLL_DAY_PRECISION>* day, int32_t dayIndex) {
+  /*
+   * Multi-location update relative to /devices/<id>, one key per boot:
+   *   sketches/<date>/hours/<HH>/<boot>
+   *   sketches/<date>/day/<boot>
+   * The backend unions boots, hours and billboards register by register.
+   */
+  char date[TIME_DATE_TEXT_MAX];
+  char key[64];
+  JsonWriter& json = uploadBody;
+  json.reset();
+  json.append("{");
+  
+  if (hour) {
+    snprintf(key, sizeof(key), "sketches/%s/hours/%02d/%08x", formatDay(hourIndex / 24, date, sizeof(date)),
+             (int)(hourIndex % 24), saltEpoch);
+    appendSketch(json, key, *hour);
   }
+  if (day) {
+    snprintf(key, sizeof(key), "sketches/%s/day/%08x", formatDay(dayIndex, date, sizeof(date)), saltEpoch);
+    appendSketch(json, key, *day);
+  }
+  json.append("}");
+  return json.ok();
+}
 
-  Serial.println("\n⚠️ Timeout: GPS fix not acquired.");
-  return false;
+void serviceSketches() {
+  /*
+   * Upload a closed hour together with its day: the final day sketch
+   * after midnight, otherwise a running snapshot of today.
+   */
+  if (sketchUploadPending || !app.ready()) return;
+  if (sketchUploadFailed && millis() - lastSketchAttempt < HLL_RETRY_MS) return;
+  
+  int32_t hour = closedSketchHour;
+  int32_t closedDay = closedSketchDay;
+  if (hour < 0 && closedDay == TIME_NO_DAY) return;
+  
+  const HyperLogLog<HLL_DAY_PRECISION>* day = NULL;
+  int32_t dayIndex = closedDay;
+  if (closedDay != TIME_NO_DAY) {
+    day = &daySketches[daySketchCurrent ^ 1];
+  } else if (hour / 24 == sketchHour / 24) {
+    day = &daySketches[daySketchCurrent];
+    dayIndex = hour / 24;
+  }
+  
+  if (!buildSketchUpdate(hour >= 0 ? &hourSketches[hourSketchCurrent ^ 1] : NULL, hour, day, dayIndex)) {
+    // Cannot fit at any time: free the slots rather than wedge the hourly upload
+    if (hour >= 0) closedSketchHour = -1;
+    if (closedDay != TIME_NO_DAY) closedSketchDay = TIME_NO_DAY;
+    sketchesDropped++;
+    LOG_ERROR("Upload: ERROR - sketch update exceeds UPLOAD_JSON_MAX");
+    return;
+  }
+  
+  sketchUploadHour = hour;
+  sketchUploadDay = closedDay;
+  sketchUploadPending = true;
+  lastSketchAttempt = millis();
+  
+  object_t sketchObj(uploadBody.c_str());
+  Database.update<object_t>(aClient, devicePath, sketchObj, onSketchResult, "sketches");
+  Serial.printf("📤 Sketches: sending hour %d / day %d (%u B)\n", hour >= 0 ? (int)(hour % 24) : -1,
+                (int)dayIndex, uploadBody.length());
 }
 
-bool updateGPSLocation() {
+void flushSketches() {
   /*
-   * Quick GPS update (for periodic refresh)
+   * Before a scheduled restart: send the running hour and day so the
+   * partial period is not lost (the next boot continues under a new key)
    */
-  for (int attempt = 0; attempt < 3; attempt++) {
-    SerialAT.println("AT+CGPSINFO");
-    delay(2000);
+  if (!app.ready() || sketchHour < 0 || sketchUploadPending) return;
+  
+  int32_t hour = sketchHour;
+  if (!buildSketchUpdate(&hourSketches[hourSketchCurrent], hour, &daySketches[daySketchCurrent], hour / 24)) return;
+  
+  sketchUploadHour = -1;
+  sketchUploadDay = TIME_NO_DAY;
+  sketchUploadPending = true;
+  
+  object_t sketchObj(uploadBody.c_str());
+  Database.update<object_t>(aClient, devicePath, sketchObj, onSketchResult, "sketches");
+  
+  unsigned long waitStart = millis();
+  while (sketchUploadPending && millis() - waitStart < REPORT_UPLOAD_WAIT_MS) {
+    serviceUplink();
+    delay(50);
+  }
+}
 
-    while (SerialAT.available()) {
-      String line = SerialAT.readStringUntil('\n');
-      line.trim();
-      
-      logToSD("GPS Response: " + line);
+void onSketchResult(AsyncResult& aResult) {
+  /*
+   * Completion of a sketch upload; frees the closed slots it carried
+   */
+  if (aResult.isError()) {
+    sketchUploadPending = false;
+    sketchUploadFailed = true;
+    asyncCB(aResult);
+  } else if (aResult.available()) {
+    sketchUploadPending = false;
+    sketchUploadFailed = false;
+    if (sketchUploadHour >= 0) closedSketchHour = -1;
+    if (sketchUploadDay != TIME_NO_DAY) closedSketchDay = TIME_NO_DAY;
+    LOG_INFO("Firebase Upload: Sketches successful");
+  }
+}
 
-      if (line.startsWith("+CGPSINFO:")) {
-        if (line.indexOf(",,,,,,,,,") != -1) {
-          logToSD("GPS: No fix - empty coordinates");
-          break;
-        }
+// ============ MINUTE SERIES ============
 
-        String data = line.substring(line.indexOf(':') + 1);
-        data.trim();
+bool buildSeriesUpdate(const MinuteBucket* batch, size_t count) {
+  /*
+   * Multi-location update relative to /devices/<id>, one key per bucket:
+   *   series/<date>/<boot>/<HHMM>: [impressions, unique, scans, scan_errors, rssi bins...]
+   * Date and HHMM are local time; the RSSI bins are ScanRecord's 10 dB bins.
+   */
+  static_assert(MINUTE_FLUSH_BATCH * 128 < UPLOAD_JSON_MAX, "series batch may not fit the upload body");
+  
+  portENTER_CRITICAL(&timeSyncMux);
+  int32_t offsetS = (int32_t)timeSync.tzQuarters * 900;
+  portEXIT_CRITICAL(&timeSyncMux);
+  
+  JsonWriter& json = uploadBody;
+  json.reset();
+  json.append("{");
+  
+  for (size_t i = 0; i < count; i++) {
+    reportJsonMinute(json, saltEpoch, batch[i], offsetS);
+  }
+  json.append("}");
+  return json.ok();
+}
 
-        int i1 = data.indexOf(','), i2 = data.indexOf(',', i1 + 1);
-        int i3 = data.indexOf(',', i2 + 1), i4 = data.indexOf(',', i3 + 1);
+void serviceMinuteSeries() {
+  /*
+   * Send closed buckets once a full batch has accumulated. A popped batch
+   * stays in seriesBatch until acknowledged and is re-sent on failure,
+   * so the ring only ever holds buckets that have not been sent.
+   */
+  if (seriesUploadPending || !app.ready()) return;
+  if (seriesUploadFailed && millis() - lastSeriesAttempt < MINUTE_RETRY_MS) return;
+  
+  if (seriesBatchCount == 0) {
+    if (minuteSeries.pending() < MINUTE_FLUSH_BATCH) return;
+    seriesBatchCount = minuteSeries.pop(seriesBatch, MINUTE_FLUSH_BATCH);
+  }
+  sendSeriesBatch();
+}
 
-        String rawLat = data.substring(0, i1);
-        String latDir = data.substring(i1 + 1, i2);
-        String rawLon = data.substring(i2 + 1, i3);
-        String lonDir = data.substring(i3 + 1, i4);
+void sendSeriesBatch() {
+  if (!buildSeriesUpdate(seriesBatch, seriesBatchCount)) {
+    // Cannot fit at any time: drop the batch rather than wedge the series
+    seriesBatchCount = 0;
+    LOG_ERROR("Upload: ERROR - series update exceeds UPLOAD_JSON_MAX");
+    return;
+  }
+  
+  seriesUploadPending = true;
+  lastSeriesAttempt = millis();
+  
+  object_t seriesObj(uploadBody.c_str());
+  Database.update<object_t>(aClient, devicePath, seriesObj, onSeriesResult, "series");
+  Serial.printf("📤 Series: sending %u minute bucket(s) (%u B, %u queued)\n", seriesBatchCount, uploadBody.length(),
+                minuteSeries.pending());
+}
 
-        if (rawLat.isEmpty() || rawLon.isEmpty()) {
-          logToSD("GPS: Empty lat/lon values");
-          break;
-        }
+void flushMinuteSeries() {
+  /*
+   * Before a scheduled restart: send the closed buckets not yet uploaded
+   * (the open minute is lost with the restart)
+   */
+  unsigned long waitStart = millis();
+  while (app.ready() && millis() - waitStart < REPORT_UPLOAD_WAIT_MS) {
+    if (!seriesUploadPending) {
+      if (seriesBatchCount == 0) seriesBatchCount = minuteSeries.pop(seriesBatch, MINUTE_FLUSH_BATCH);
+      if (seriesBatchCount == 0) break;
+      sendSeriesBatch();
+    }
+    serviceUplink();
+    delay(50);
+  }
+}
 
-        float latVal = rawLat.toFloat(), lonVal = rawLon.toFloat();
-        int latDeg = int(latVal / 100), lonDeg = int(lonVal / 100);
-        float latDec = latDeg + (latVal - latDeg * 100) / 60.0;
-        float lonDec = lonDeg + (lonVal - lonDeg * 100) / 60.0;
+void onSeriesResult(AsyncResult& aResult) {
+  /*
+   * Completion of a series upload; frees the batch it carried
+   */
+  if (aResult.isError()) {
+    seriesUploadPending = false;
+    seriesUploadFailed = true;
+    asyncCB(aResult);
+  } else if (aResult.available()) {
+    seriesUploadPending = false;
+    seriesUploadFailed = false;
+    seriesBatchCount = 0;
+    LOG_INFO("Firebase Upload: Series successful");
+  }
+}
 
-        if (latDir == "S") latDec *= -1;
-        if (lonDir == "W") lonDec *= -1;
+void onReportResult(AsyncResult& aResult) {
+  /*
+   * Completion of the per-report update; acks the outbox batch it carried
+   */
+  int batchId;
+  unsigned firstSeq;
+  if (sscanf(aResult.uid().c_str(), "report:%d:%u", &batchId, &firstSeq) != 2) {
+    asyncCB(aResult);
+    return;
+  }
+  
+  if (aResult.isError()) {
+    reportUploadPending = false;
+    uploadLinkPoor = true;
+    asyncCB(aResult);  // Prints and logs the error
+    settleImpressionDeltas(false);
+    if (batchId >= 0) outboxFail(batchId, firstSeq, millis());
+  } else if (aResult.available()) {
+    reportUploadPending = false;
+    uint32_t latency = millis() - reportUploadStart;
+    if (profileReported) resetProfile();  // Before this ack's own sample, which opens the next window
+    profileSample(PROFILE_REPORT_ACK, latency);
+    reportUploadsAcked++;
+    reportLatencyTotalMs += latency;
+    if (latency > reportLatencyMaxMs) reportLatencyMaxMs = latency;
+    uploadLinkPoor = latency > UPLOAD_SLOW_LATENCY_MS;
+    settleImpressionDeltas(true);
+    if (batchId >= 0) outboxAck(batchId, firstSeq);
+    if (millis() - lastConfigPoll >= CONFIG_POLL_INTERVAL_MS) configPollDue = true;  // Rides the open socket
+    if (OTA_ENABLED && millis() - lastOtaCheck >= OTA_CHECK_INTERVAL_MS) otaCheckDue = true;
+    Serial.println("✓ Report update successful (daily data, location, diagnostics)\n");
+    LOG_INFO("Firebase Upload: Report update successful");
+  }
+}
 
-        gpsLatitude = String(latDec, 6);
-        gpsLongitude = String(lonDec, 6);
-        logToSD("GPS Updated: Lat=" + gpsLatitude + ", Lon=" + gpsLongitude);
-        return true;
-      }
-    }
+void adaptUploadInterval(const CycleReport& report) {
+  /*
+   * Busy cycles bring the report cadence back to every cycle; each quiet
+   * cycle doubles it, up to the configured maximum. A failed or slow last
+   * report counts as quiet, so a weak cell is not kept transmitting.
+   */
+  uint32_t arrivals = report.visits.newVisitors + report.visits.returningVisitors;
+  if (arrivals >= UPLOAD_BUSY_ARRIVALS && !uploadLinkPoor) {
+    uploadIntervalMs = UPLOAD_INTERVAL_MIN_MS;
+  } else {
+    uint32_t maxMs = runtimeConfig.uploadIntervalMaxS * 1000;
+    uploadIntervalMs = uploadIntervalMs >= maxMs / 2 ? maxMs : uploadIntervalMs * 2;
   }
+}
+
+bool reportUploadDue() {
+  /*
+   * Due once the interval is up (half a cycle of slack for scan jitter),
+   * and always for the last cycles before local midnight: the day's
+   * totals and visits are closed then, so nothing is held across it.
+   */
+  if (!reportUploadSent || millis() - lastReportUpload + UPLOAD_INTERVAL_MIN_MS / 2 >= uploadIntervalMs) return true;
   
-  logToSD("GPS update failed after 3 attempts");
-  return false;
+  uint32_t epoch = currentEpoch();
+  if (epoch == 0) return true;
+  portENTER_CRITICAL(&timeSyncMux);
+  int32_t nextDay = timeLocalDay(timeSync, epoch + 2 * UPLOAD_INTERVAL_MIN_MS / 1000);
+  portEXIT_CRITICAL(&timeSyncMux);
+  return nextDay != currentDay;
 }
 
-String getTimeFromSIM7600() {
+void addImpressionDelta(const char* date, uint32_t impressions) {
   /*
-   * Get current date/time from SIM7600G-H with retry logic
+   * Credit a cycle to `date` (delta mode): the day it closed on, settled by
+   * rollDailyTotals() beforehand. The increment is sent under that date
+   * even when the report goes out after midnight, and dailyImpressions
+   * restarts with the new day, so no cycle reaches both days' totals.
+   * No cycle is ever dropped: when no slot can be freed before an ack,
+   * it is credited to a neighbouring day instead.
    */
-  for (int attempt = 0; attempt < 3; attempt++) {
-    SerialAT.println("AT+CCLK?");
-    delay(1000);
-    
-    String response = "";
-    unsigned long start = millis();
-    while (millis() - start < 2000) {
-      if (SerialAT.available()) {
-        response += SerialAT.readString();
-        break;
-      }
-      delay(50);
+#if UPLOAD_DELTA_MODE
+  ImpressionDelta* slot = NULL;
+  for (size_t i = 0; i < IMPRESSION_DELTA_SLOTS && !slot; i++) {
+    if (strcmp(impressionDeltas[i].date, date) == 0) slot = &impressionDeltas[i];
+  }
+  for (size_t i = 0; i < IMPRESSION_DELTA_SLOTS && !slot; i++) {
+    if (impressionDeltas[i].pending == 0 && impressionDeltas[i].inFlight == 0) slot = &impressionDeltas[i];
+  }
+  if (!slot) {
+    // Every slot holds another day (an outage of days, acks outstanding): free the oldest
+    // one not in flight by folding it into the newest, which may carry pending next to inFlight
+    ImpressionDelta* oldest = NULL;
+    ImpressionDelta* newest = &impressionDeltas[0];
+    for (size_t i = 0; i < IMPRESSION_DELTA_SLOTS; i++) {
+      ImpressionDelta& delta = impressionDeltas[i];
+      if (strcmp(delta.date, newest->date) > 0) newest = &delta;
+      if (delta.inFlight == 0 && (!oldest || strcmp(delta.date, oldest->date) < 0)) oldest = &delta;
     }
-    
-    logToSD("Time Response: " + response);
-    
-    // Parse: +CCLK: "25/12/02,10:30:45+00"
-    int startPos = response.indexOf("\"") + 1;
-    int endPos = response.indexOf("\"", startPos);
-    
-    if (startPos > 0 && endPos > startPos) {
-      String timeStr = response.substring(startPos, endPos);
-      
-      if (timeStr.length() >= 17) {
-        String year = "20" + timeStr.substring(0, 2);
-        String month = timeStr.substring(3, 5);
-        String day = timeStr.substring(6, 8);
-        String time = timeStr.substring(9, 17);
-        
-        String formattedTime = year + "-" + month + "-" + day + " " + time + " UTC";
-        logToSD("Time Retrieved: " + formattedTime);
-        return formattedTime;
-      }
+    if (!oldest || oldest == newest) {
+      // Nothing can be freed before the ack: credit the newest day rather than lose the cycle
+      newest->pending += impressions;
+      return;
     }
-    
-    Serial.printf("[WARN] Time retrieval attempt %d failed, retrying...\n", attempt + 1);
-    delay(500);
+    newest->pending += oldest->pending;
+    oldest->pending = 0;
+    slot = oldest;
   }
   
-  logToSD("Time retrieval failed after 3 attempts");
-  return "Time unavailable";
+  strncpy(slot->date, date, sizeof(slot->date) - 1);
+  slot->date[sizeof(slot->date) - 1] = '\0';
+  slot->pending += impressions;
+#endif
 }
 
-String extractDateFromDateTime(String dateTime) {
+void settleImpressionDeltas(bool delivered) {
   /*
-   * Extract date from datetime
-   * From: "2025-12-02 14:30:45 UTC" To: "2025-12-02"
+   * Report callback: drop acknowledged increments, or queue them again.
+   * A lost ack can double-count one cycle; the per-cycle outbox keys stay exact.
    */
-  int spaceIndex = dateTime.indexOf(' ');
-  if (spaceIndex > 0) {
-    return dateTime.substring(0, spaceIndex);
+  for (size_t i = 0; i < IMPRESSION_DELTA_SLOTS; i++) {
+    if (!delivered) impressionDeltas[i].pending += impressionDeltas[i].inFlight;
+    impressionDeltas[i].inFlight = 0;
   }
-  return "Unknown";
 }
 
-String getMacAddress() {
-  uint8_t baseMac[6];
-  esp_read_mac(baseMac, ESP_MAC_WIFI_STA);
-  
-  char macStr[13];
-  sprintf(macStr, "%02X%02X%02X%02X%02X%02X", 
-          baseMac[0], baseMac[1], baseMac[2], 
-          baseMac[3], baseMac[4], baseMac[5]);
+bool appendCycleEntries(JsonWriter& json, const OutboxEntry* batch, size_t count, const char* keyPrefix) {
+  /*
+   * Outbox entries as multi-path keys "<prefix><date>/<boot>-<cycle>",
+   * continuing an open object. Compact form is a positional array
+   * [ts, impressions, networks, unique, repeated]: about half the bytes
+   * of named fields on every cycle that crosses the cellular link.
+   */
+  uint32_t now = currentEpoch();
   
-  return String(macStr);
-}
-
-void asyncCB(AsyncResult &aResult) {
-  if (aResult.isEvent()) {
-    Firebase.printf("Event: %s, msg: %s, code: %d\n", 
-                    aResult.uid().c_str(), 
-                    aResult.appEvent().message().c_str(), 
-                    aResult.appEvent().code());
+  for (size_t i = 0; i < count; i++) {
+    const OutboxEntry& entry = batch[i];
     
-    if (String(aResult.uid()) == "authTask" && aResult.appEvent().code() == 9) {
-      Serial.println("✓ Authentication successful!");
+    // Entries from before the first clock sync can be dated if they are from this boot
+    uint32_t timestamp = entry.timestamp;
+    if (timestamp == 0 && now != 0 && entry.bootId == saltEpoch) {
+      timestamp = now - (millis() - entry.uptimeMs) / 1000;
     }
+    
+    reportJsonCycle(json, keyPrefix, entry, timestamp, UPLOAD_COMPACT_CYCLES);
   }
+  return json.ok();
+}
+
+bool buildReportUpdate(const char* lat, const char* lon, const OutboxEntry* batch, size_t count) {
+  /*
+   * Multi-location update body relative to /devices/<id>:
+   *   data/<date>/...        daily totals and last_updated (leaf paths, siblings untouched)
+   *   data/<date>/visits/<boot>  this boot's visit analytics for the day
+   *   data/<date>/proximity/<boot>  this boot's sightings per distance band
+   *   device_info/Location   settled position (left out while none is known)
+   *   diagnostics            device health snapshot (update state in "ota", stage profile in "prof" while profiling)
+   *   cycles/<date>/<key>    oldest outbox backlog
+   */
+  const char* date = currentDate;
+  char now[TIME_TEXT_MAX];
+  currentTimestamp(now, sizeof(now));
+  JsonWriter& json = uploadBody;
+  json.reset();
   
-  if (aResult.isDebug()) {
-    Firebase.printf("Debug: %s, msg: %s\n", aResult.uid().c_str(), aResult.debug().c_str());
-  }
-  
-  if (aResult.isError()) {
-    Serial.println("\n❌ FIREBASE ERROR:");
-    Firebase.printf("   Task: %s\n", aResult.uid().c_str());
-    Firebase.printf("   Message: %s\n", aResult.error().message().c_str());
-    Firebase.printf("   Code: %d\n\n", aResult.error().code());
+  // The id and the date are already in the path: only the timestamp is sent
+  json.append("{\"data/%s/last_updated\":\"%s\"", date, now);
+#if UPLOAD_DELTA_MODE
+  // Server-side increment: concurrent boots and re-sent deltas never overwrite each other
+  for (size_t i = 0; i < IMPRESSION_DELTA_SLOTS; i++) {
+    ImpressionDelta& delta = impressionDeltas[i];
+    if (delta.date[0] == '\0') strncpy(delta.date, date, sizeof(delta.date) - 1);  // Pre-clock cycles count for today
+    if (delta.pending == 0 || delta.inFlight != 0) continue;
     
-    String errorLog = "Firebase Upload ERROR - Task: " + String(aResult.uid().c_str()) + 
-                     ", Code: " + String(aResult.error().code()) + 
-                     ", Msg: " + String(aResult.error().message().c_str());
-    logToSD(errorLog);
+    json.member("\"data/%s/daily_impressions\":{\".sv\":{\"increment\":%u}}", delta.date, delta.pending);
+    delta.inFlight = delta.pending;
+    delta.pending = 0;
   }
-  
-  if (aResult.available()) {
-    String taskId = String(aResult.uid());
-    if (taskId == "deviceInfoTask") {
-      Serial.println("✓ Device info upload successful!\n");
-      logToSD("Firebase Upload: Device info successful");
-    } else if (taskId == "dailyDataTask") {
-      Serial.println("✓ Daily data upload successful!\n");
-      logToSD("Firebase Upload: Daily data successful");
-    } else if (taskId == "locationUpdateTask") {
-      Serial.println("✓ Location update successful!\n");
-      logToSD("Firebase Upload: Location update successful");
-    } else {
-      Firebase.printf("✓ Upload successful: %s\n", taskId.c_str());
-      logToSD("Firebase Upload: " + taskId + " successful");
-    }
+#else
+  json.member("\"data/%s/daily_impressions\":%u", date, dailyImpressions);
+#endif
+  // This boot's visits today; one key per boot, the backend sums them
+  reportJsonVisits(json, date, saltEpoch, dailyVisits);
+  reportJsonProximity(json, date, saltEpoch, dailyProximity);
+  if (gpsSource != GPS_SOURCE_NONE) {
+    json.member("\"device_info/Location\":{\"Lat\":\"%s\",\"Long\":\"%s\",\"Source\":\"%s\"}", lat, lon,
+                gpsSourceName());
   }
+  json.member("\"diagnostics\":{\"updated\":\"%s\",\"firmware\":\"%s\",\"uptime_s\":%lu,"
+              "\"scans\":%u,\"scan_errors\":%u,\"dedup_overflows\":%u,\"probe_overflows\":%u,\"sightings_dropped\":%u,"
+              "\"free_heap\":%u,\"min_free_heap\":%u,\"max_alloc_heap\":%u,\"heap_degraded\":%u,\"gps_fix\":%s,\"gps_state\":\"%s\",\"outbox_pending\":%u,"
+              "\"sketches_dropped\":%u,\"wire_bytes_sent\":%u,\"wire_bytes_received\":%u,"
+              "\"upload_interval_s\":%u,\"reports_deferred\":%u,\"series_queued\":%u,\"series_dropped\":%u,"
+              "\"config_updates\":%u,\"config_rejected\":%u,"
+              "\"power\":{\"light_sleep\":%s,\"cycle_ms\":%u,\"awake_ms\":%u,\"modem_awake_ms\":%u,"
+              "\"cycle_mah\":%.3f,\"total_mah\":%.1f}",
+              now, FIRMWARE_VERSION, (unsigned long)uptimeSeconds(),
+              aggregator.totalScans(), scanErrors, aggregator.dedupOverflows(), probeOverflows, sightingsDropped,
+              ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap(), heapWatchdog.degradedSamples(), gpsFixAcquired ? "true" : "false",
+              gpsTrackStateName(gpsTracker.state), outboxPending(),
+              sketchesDropped, linkBytesSent(), linkBytesReceived(),
+              uploadIntervalMs / 1000, reportsDeferred, minuteSeries.pending() + seriesBatchCount,
+              minuteSeries.dropped(), configUpdates, configRejected, lightSleepActive ? "true" : "false", lastPowerCycle.elapsedMs,
+              lastPowerCycle.awakeMs, lastPowerCycle.modemAwakeMs, lastPowerCycle.mAh, powerTotalMah);
+  json.member("\"ota\":{\"state\":\"%s\",\"target\":\"%s\",\"progress_pct\":%u,\"failed\":\"%s\",\"aborted\":%u}",
+              otaStateName(), otaManifest.version, otaProgress, otaFailedVersion, otaUpdatesFailed);
+  if (profilingEnabled) appendProfile(json);
+  json.append("}");
+  appendCycleEntries(json, batch, count, "cycles/");
+  json.append("}");
+  return json.ok();
 }
 
-// ============ SD CARD LOGGING FUNCTIONS ============
+bool buildDeviceInfoJSON() {
+  /*
+   * Device information for QR code access, written into uploadBody; also
+   * the settings in use, republished whenever remote config changes them
+   */
+  char now[TIME_TEXT_MAX];
+  JsonWriter& json = uploadBody;
+  json.reset();
+  
+  json.append("{\"billboard_id\":\"%s\",\"device_name\":\"%s\",\"firmware\":\"%s\",\"mac_address\":\"%s\","
+              "\"setup_time\":\"%s\",\"status\":\"active\"",
+              combinedBillboardId, BILLBOARD_ID, FIRMWARE_VERSION, deviceMacAddress,
+              currentTimestamp(now, sizeof(now)));
+  json.member("\"proximity\":{\"rssi_1m\":%d,\"loss_x10\":%u,\"viewing_m\":%u,\"nearby_m\":%u,"
+              "\"viewing_rssi\":%d,\"nearby_rssi\":%d}",
+              runtimeConfig.proximity.rssiAt1m, runtimeConfig.proximity.pathLossX10, runtimeConfig.proximity.viewingM,
+              runtimeConfig.proximity.nearbyM, proximityTable.viewingRssi, proximityTable.nearbyRssi);
+  json.member("\"config\":{\"scan_interval_ms\":%u,\"scans_per_upload\":%u,\"upload_interval_max_s\":%u,"
+              "\"restart_interval_h\":%u}",
+              runtimeConfig.scanIntervalMs, runtimeConfig.scansPerUpload, runtimeConfig.uploadIntervalMaxS,
+              runtimeConfig.restartIntervalH);
+  if (gpsSource != GPS_SOURCE_NONE) {
+    char lat[GPS_COORD_TEXT_MAX], lon[GPS_COORD_TEXT_MAX];
+    json.member("\"Location\":{\"Lat\":\"%s\",\"Long\":\"%s\",\"Source\":\"%s\"}",
+                formatCoordinate(gpsFix.latE7, lat, sizeof(lat)), formatCoordinate(gpsFix.lonE7, lon, sizeof(lon)),
+                gpsSourceName());
+  }
+  json.append("}");
+  return json.ok();
+}
 
-bool initSDCard() {
+void uploadDeviceInfo() {
   /*
-   * Initialize SD card module
-   * Default SPI pins for ESP32: MOSI=23, MISO=19, SCK=18
-   * CS pin defined as SD_CS_PIN
+   * Publish device_info once per boot (asynchronous)
    */
-  if (!SD.begin(SD_CS_PIN)) {
-    Serial.println("   SD Card mount failed!");
-    return false;
+  Serial.println("📤 Uploading device info to Firebase...");
+  if (!buildDeviceInfoJSON()) {
+    Serial.println("❌ Device info exceeds UPLOAD_JSON_MAX - skipped");
+    LOG_ERROR("Upload: ERROR - device info too large");
+    return;
   }
+  char path[FIREBASE_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/device_info", devicePath);
+  Serial.printf("   Path: %s\n", path);
+  Serial.printf("   JSON: %s\n", uploadBody.c_str());
   
-  uint8_t cardType = SD.cardType();
-  if (cardType == CARD_NONE) {
-    Serial.println("   No SD card attached!");
-    return false;
-  }
+  // Use object_t to send raw JSON (copies the body, the buffer is free again on return)
+  object_t json(uploadBody.c_str());
+  Database.set<object_t>(aClient, path, json, asyncCB, "deviceInfoTask");
+  deviceInfoUploaded = true;
+}
+
+void generateAccessKey(char* out, size_t size) {
+  /*
+   * Generate unique access key for QR code authentication
+   */
+  snprintf(out, size, "%s_%.8s_%lu", BILLBOARD_ID, deviceMacAddress, (unsigned long)millis());
+}
+
+void startGPS() {
+  /*
+   * Start the receiver and return at once; fixes are published as they
+   * arrive (onGPSInfo / onNmeaLine -> publishGpsFix). After a warm
+   * restart the session is still running and these just answer ERROR.
+   */
+#if GPS_AGPS_XTRA
+  // XTRA must be enabled while the receiver is off; the file is injected at session start
+  atEngine.run("AT+CGPSXE=1", NULL, AT_DEFAULT_TIMEOUT_MS);
+  atEngine.run("AT+CGPSXDAUTO=1", NULL, AT_DEFAULT_TIMEOUT_MS);
+#endif
+
+#if GPS_NMEA_STREAMING
+  // Sentence mask must be set before the session starts (ERROR if already running)
+  char command[AT_COMMAND_MAX];
+  snprintf(command, sizeof(command), "AT+CGPSNMEA=%d", GPS_NMEA_SENTENCES);
+  atEngine.run(command, NULL, AT_DEFAULT_TIMEOUT_MS);
+#endif
+
+  // Enable GPS (ERROR just means the engine is already running)
+  atEngine.run("AT+CGPS=1", NULL, AT_DEFAULT_TIMEOUT_MS);
+
+#if GPS_NMEA_STREAMING
+  snprintf(command, sizeof(command), "AT+CGPSINFOCFG=%d,%d",
+           gpsTracker.state == GPS_TRACK_STABLE ? GPS_NMEA_STABLE_INTERVAL_S : GPS_NMEA_REPORT_INTERVAL_S,
+           GPS_NMEA_SENTENCES);
+  atEngine.run(command, NULL, AT_DEFAULT_TIMEOUT_MS);
+#endif
+  lastGpsPoll = millis();
+  gpsSearchStart = lastGpsPoll;
+}
+
+void serviceGPS() {
+  /*
+   * Polling cadence follows the tracker: fast until the first fix, slow
+   * while the position settles, hourly once it is frozen - a billboard
+   * does not move. Streaming mode needs no polling (see publishGpsFix()).
+   */
+#if !GPS_NMEA_STREAMING
+  uint32_t interval = GPS_FIX_POLL_MS;
+  if (gpsTracker.state == GPS_TRACK_LOCKED) interval = GPS_TRACK_POLL_MS;
+  if (gpsTracker.state == GPS_TRACK_STABLE) interval = GPS_STABLE_POLL_MS;
   
-  Serial.print("   SD Card Type: ");
-  if (cardType == CARD_MMC) {
-    Serial.println("MMC");
-  } else if (cardType == CARD_SD) {
-    Serial.println("SDSC");
-  } else if (cardType == CARD_SDHC) {
-    Serial.println("SDHC");
-  } else {
-    Serial.println("UNKNOWN");
+  if (millis() - lastGpsPoll >= interval && requestGPSUpdate()) {
+    lastGpsPoll = millis();
   }
+#endif
+}
+
+void publishGpsFix(const GpsFix& sample) {
+  /*
+   * Feed a receiver fix to the tracker and publish its settled position
+   */
+  uint8_t previous = gpsTracker.state;
+  if (!gpsTrackerUpdate(gpsTracker, sample)) return;
   
-  uint64_t cardSize = SD.cardSize() / (1024 * 1024);
-  Serial.printf("   SD Card Size: %lluMB\n", cardSize);
+  gpsFix = sample;
+  gpsFix.latE7 = gpsTracker.latE7;
+  gpsFix.lonE7 = gpsTracker.lonE7;
+  gpsFixAcquired = true;
+  gpsSource = GPS_SOURCE_FIX;
   
-  uint64_t cardUsed = SD.usedBytes() / (1024 * 1024);
-  uint64_t cardTotal = SD.totalBytes() / (1024 * 1024);
-  Serial.printf("   Space Used: %lluMB / %lluMB\n", cardUsed, cardTotal);
+  if (gpsTracker.state == previous) return;
   
-  return true;
+  char lat[GPS_COORD_TEXT_MAX], lon[GPS_COORD_TEXT_MAX];
+  formatCoordinate(gpsFix.latE7, lat, sizeof(lat));
+  formatCoordinate(gpsFix.lonE7, lon, sizeof(lon));
+  Serial.printf("🛰️  GPS %s: Lat=%s, Long=%s\n", gpsTrackStateName(gpsTracker.state), lat, lon);
+  LOG_INFO("GPS: %s - Lat=%s, Lon=%s", gpsTrackStateName(gpsTracker.state), lat, lon);
+  
+  if (gpsTracker.state == GPS_TRACK_STABLE) storeStablePosition();
+  if (previous == GPS_TRACK_STABLE) gpsSearchStart = millis();  // Relocated: settle again before sleeping
+  
+#if GPS_NMEA_STREAMING
+  // Streamed bursts back off with the tracker too
+  if (gpsTracker.state == GPS_TRACK_STABLE || previous == GPS_TRACK_STABLE) {
+    char command[AT_COMMAND_MAX];
+    snprintf(command, sizeof(command), "AT+CGPSINFOCFG=%d,%d",
+             gpsTracker.state == GPS_TRACK_STABLE ? GPS_NMEA_STABLE_INTERVAL_S : GPS_NMEA_REPORT_INTERVAL_S,
+             GPS_NMEA_SENTENCES);
+    atEngine.submit(command, NULL, AT_DEFAULT_TIMEOUT_MS, NULL);
+  }
+#endif
 }
 
-void logToSD(String message) {
+void loadStoredPosition() {
   /*
-   * Write a log message to SD card with timestamp
-   * Creates/appends to trafilytics_log.txt
+   * Last stable position from NVS: better than nothing until a live fix
+   * arrives, and replaces the old hardcoded fallback coordinates
    */
-  if (!sdCardAvailable) return;
-  
-  File logFile = SD.open("/trafilytics_log.txt", FILE_APPEND);
-  if (!logFile) {
-    return;
+  Preferences prefs;
+  if (!prefs.begin("gps", true)) return;
+  if (prefs.isKey("lat") && prefs.isKey("lon")) {
+    gpsFix.latE7 = (int32_t)prefs.getUInt("lat", 0);
+    gpsFix.lonE7 = (int32_t)prefs.getUInt("lon", 0);
+    gpsSource = GPS_SOURCE_STORED;
   }
-  
-  // Write timestamp and message
-  String logEntry = "[" + currentDateTime + "] " + message;
-  logFile.println(logEntry);
-  logFile.close();
+  prefs.end();
 }
 
-void logScanToSD(int networksFound, int uniqueCount, int repeatedCount) {
+void loadProximityCalibration() {
   /*
-   * Log WiFi scan results to SD card with timestamp
+   * Per-billboard calibration from NVS "proximity" (rssi_1m, loss_x10,
+   * viewing_m, nearby_m), falling back to the PROXIMITY_* defaults for
+   * missing keys or an implausible set; then the lookup table is built
    */
-  if (!sdCardAvailable) return;
+  Preferences prefs;
+  if (prefs.begin("proximity", true)) {
+    ProximityCalibration stored;
+    stored.rssiAt1m = prefs.getChar("rssi_1m", PROXIMITY_RSSI_AT_1M);
+    stored.pathLossX10 = prefs.getUChar("loss_x10", PROXIMITY_PATH_LOSS_X10);
+    stored.viewingM = prefs.getUShort("viewing_m", PROXIMITY_VIEWING_M);
+    stored.nearbyM = prefs.getUShort("nearby_m", PROXIMITY_NEARBY_M);
+    prefs.end();
+    
+    if (proximityCalibrationValid(stored)) {
+      runtimeConfig.proximity = stored;
+    } else {
+      Serial.println("⚠️  Stored proximity calibration rejected - using defaults");
+    }
+  }
   
-  String scanLog = "SCAN #" + String(totalScansPerformed) + ": ";
-  scanLog += "Found=" + String(networksFound) + ", ";
-  scanLog += "Unique=" + String(uniqueCount) + ", ";
-  scanLog += "Repeated=" + String(repeatedCount);
+  proximityTableBuild(proximityTable, runtimeConfig.proximity);
+  Serial.printf("📏 Proximity: viewing >= %d dBm (%u m), nearby >= %d dBm (%u m)\n\n", proximityTable.viewingRssi,
+                runtimeConfig.proximity.viewingM, proximityTable.nearbyRssi, runtimeConfig.proximity.nearbyM);
+}
+
+void storeProximityCalibration() {
+  /*
+   * Keep a remotely set calibration for the next boot (same keys as above)
+   */
+  Preferences prefs;
+  if (!prefs.begin("proximity", false)) return;
+  prefs.putChar("rssi_1m", runtimeConfig.proximity.rssiAt1m);
+  prefs.putUChar("loss_x10", runtimeConfig.proximity.pathLossX10);
+  prefs.putUShort("viewing_m", runtimeConfig.proximity.viewingM);
+  prefs.putUShort("nearby_m", runtimeConfig.proximity.nearbyM);
+  prefs.end();
+}
+
+void storeStablePosition() {
+  /*
+   * Written only when the position freezes, so NVS sees a handful of writes per site
+   */
+  Preferences prefs;
+  if (!prefs.begin("gps", false)) return;
+  if ((int32_t)prefs.getUInt("lat", 0) != gpsTracker.latE7 || (int32_t)prefs.getUInt("lon", 0) != gpsTracker.lonE7) {
+    prefs.putUInt("lat", (uint32_t)gpsTracker.latE7);
+    prefs.putUInt("lon", (uint32_t)gpsTracker.lonE7);
+  }
+  prefs.end();
+}
+
+const char* gpsSourceName() {
+  switch (gpsSource) {
+    case GPS_SOURCE_FIX: return "fix";
+    case GPS_SOURCE_STORED: return "stored";
+    default: return "none";
+  }
+}
+
+void onModemUrc(const char* line) {
+  /*
+   * Lines the AT engine reads while no command is in flight
+   */
+  if (strncmp(line, "+CNTP:", 6) == 0) {
+    // NTP result: 0 = RTC set, read it back
+    LOG_INFO("Time: NTP update result%s", line + 6);
+    if (atoi(line + 6) == 0) requestTimeUpdate();
+    return;
+  }
+  if (strncmp(line, "+CGPSXD:", 8) == 0) {
+    // XTRA download result: 0 = success
+    LOG_INFO("GPS: XTRA download result%s", line + 8);
+    return;
+  }
+  onNmeaLine(line);
+#if TLS_TRANSPORT == TLS_TRANSPORT_MODEM
+  modem_tls.handleUrc(line);
+#endif
+}
+
+void onNmeaLine(const char* line) {
+  /*
+   * URC handler while GPS_NMEA_STREAMING is on. Sentences are consumed in
+   * place; only GGA/RMC with a valid fix and checksum reach the tracker.
+   * Sentences that arrive during a TinyGSM exchange are read (and dropped)
+   * by TinyGSM - harmless, the next burst follows GPS_NMEA_REPORT_INTERVAL_S later.
+   */
+  if (line[0] != '$') return;
+  if (parseNmea(line, gpsReceiver)) {
+    publishGpsFix(gpsReceiver);
+  }
+}
+
+void onGPSInfo(AtResult result, const char* payload, void* ctx) {
+  /*
+   * Completion of a queued AT+CGPSINFO refresh
+   */
+  gpsRefreshPending = false;
+  LOG_DEBUG("GPS Response: %s", payload);
+  
+  if (result != AtResult::Ok) {
+    LOG_ERROR(result == AtResult::Timeout ? "GPS: Timeout waiting for CGPSINFO" : "GPS: CGPSINFO error");
+    return;
+  }
+  
+  if (!parseCgpsInfo(payload, gpsReceiver)) {
+    LOG_DEBUG("GPS: No fix - empty coordinates");
+    return;
+  }
+  
+  publishGpsFix(gpsReceiver);
+}
+
+bool requestGPSUpdate() {
+  /*
+   * Quick GPS update (for periodic refresh) - queued, never blocks.
+   * The result reaches the tracker via onGPSInfo(). Streaming mode needs no
+   * request: sentences keep arriving on their own.
+   */
+#if GPS_NMEA_STREAMING
+  return true;
+#else
+  if (gpsRefreshPending) return true;
+  
+  gpsRefreshPending = atEngine.submit("AT+CGPSINFO", "+CGPSINFO:", AT_DEFAULT_TIMEOUT_MS, onGPSInfo);
+  return gpsRefreshPending;
+#endif
+}
+
+bool syncNetworkTime() {
+  /*
+   * Boot path: one AT+CCLK? read. The RTC follows NITZ (AT+CTZU=1); a
+   * network without NITZ leaves it unset, which falls back to AT+CNTP and
+   * the background retry picks the result up.
+   */
+  atEngine.run("AT+CTZU=1", NULL, AT_DEFAULT_TIMEOUT_MS);
+  
+  char response[AT_LINE_MAX];
+  AtResult result = atEngine.run("AT+CCLK?", "+CCLK:", AT_DEFAULT_TIMEOUT_MS, response, sizeof(response));
+  LOG_DEBUG("Time Response: %s", response);
+  
+  if (result == AtResult::Ok && applyNetworkTime(response)) return true;
+  
+  requestNtpSync();
+  return false;
+}
+
+void requestNtpSync() {
+  /*
+   * Have the modem set its RTC over NTP (once per boot). AT+CNTP answers OK
+   * at once and "+CNTP: <err>" when done, see onModemUrc().
+   */
+  if (ntpRequested || strlen(TIME_NTP_SERVER) == 0) return;
+  
+  char command[AT_COMMAND_MAX];
+  snprintf(command, sizeof(command), "AT+CNTP=\"%s\",%d", TIME_NTP_SERVER, TIME_NTP_TZ_QUARTERS);
+  ntpRequested = atEngine.submit(command, NULL, AT_DEFAULT_TIMEOUT_MS, NULL) &&
+                 atEngine.submit("AT+CNTP", NULL, AT_DEFAULT_TIMEOUT_MS, NULL);
+}
+
+void onTimeInfo(AtResult result, const char* payload, void* ctx) {
+  /*
+   * Completion of a queued AT+CCLK? resync
+   */
+  timeRefreshPending = false;
+  
+  if (result != AtResult::Ok || !applyNetworkTime(payload)) {
+    LOG_ERROR("Time: Refresh failed - %s", payload);
+    requestNtpSync();
+    return;
+  }
+  
+  LOG_DEBUG("Time: Resync offset %ld ms, drift %ld ppm", (long)timeSync.lastOffsetMs, (long)timeSync.driftPpm);
+}
+
+bool requestTimeUpdate() {
+  /*
+   * Queue a network time resync; the result is applied in onTimeInfo()
+   */
+  if (timeRefreshPending) return true;
+  
+  timeRefreshPending = atEngine.submit("AT+CCLK?", "+CCLK:", AT_DEFAULT_TIMEOUT_MS, onTimeInfo);
+  return timeRefreshPending;
+}
+
+void serviceUplink() {
+  /*
+   * One turn of the shared modem UART: AT engine first, and TinyGSM /
+   * Firebase only while no AT command is waiting for its response.
+   */
+  atEngine.poll();
+  if (!atEngine.busy()) {
+    app.loop();
+    trackTlsHandshake();
+  }
+}
+
+// ============ WARM RESTART ============
+
+uint32_t rtcChecksum(const void* data, size_t size) {
+  // FNV-1a 32 over raw RTC memory
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < size; i++) {
+    h = (h ^ bytes[i]) * 16777619UL;
+  }
+  return h;
+}
+
+void saveWarmState() {
+  /*
+   * Snapshot for the next boot. Runs on the uplink task right before
+   * ESP.restart(); the modem is not touched, so everything it holds
+   * (registration, PDP context, GPS session, AT+IPR rate) stays valid.
+   */
+#if WARM_BOOT_ENABLED
+  memset(&warmState, 0, sizeof(warmState));
+  strncpy(warmState.firmware, FIRMWARE_VERSION, sizeof(warmState.firmware) - 1);
+  warmState.epoch = currentEpoch();
+  warmState.driftPpm = timeSync.driftPpm;
+  warmState.driftValid = timeSync.driftValid;
+  warmState.tzQuarters = timeSync.tzQuarters;
+  warmState.modemBaud = modemBaud;
+  warmState.modemFlowControl = modemFlowControl;
+  warmState.networkRegistered = modem.isNetworkConnected();
+  warmState.gprsConnected = modem.isGprsConnected();
+  warmState.gpsFixAcquired = gpsFixAcquired;
+  warmState.gpsSource = gpsSource;
+  warmState.gpsFix = gpsFix;
+  warmState.gpsTracker = gpsTracker;
+  warmState.day = currentDay;
+  warmState.dailyImpressions = dailyImpressions;
+  warmState.dailyDataSent = dailyDataSent;
+  memcpy(warmState.impressionDeltas, impressionDeltas, sizeof(impressionDeltas));
+  
+  // In-flight deltas never got their callback; they go out again after the restart
+  for (size_t i = 0; i < IMPRESSION_DELTA_SLOTS; i++) {
+    warmState.impressionDeltas[i].pending += warmState.impressionDeltas[i].inFlight;
+    warmState.impressionDeltas[i].inFlight = 0;
+  }
+  
+  if (app.ready() && warmState.epoch) {
+    String token = app.getToken();
+    String refresh = app.getRefreshToken();
+    if (token.length() < sizeof(warmState.idToken) && refresh.length() < sizeof(warmState.refreshToken)) {
+      strcpy(warmState.idToken, token.c_str());
+      strcpy(warmState.refreshToken, refresh.c_str());
+      warmState.tokenExpiry = warmState.epoch + app.ttl();
+    }
+  }
+  
+  warmState.checksum = rtcChecksum(&warmState, offsetof(WarmState, checksum));
+  warmState.magic = WARM_STATE_MAGIC;
+#endif
+}
+
+bool restoreWarmState() {
+  /*
+   * Accept the snapshot only after a software reset of the same firmware.
+   * The magic is cleared right away, so a crash loop falls back to a
+   * cold boot instead of replaying the same state.
+   */
+#if WARM_BOOT_ENABLED
+  if (esp_reset_reason() != ESP_RST_SW || warmState.magic != WARM_STATE_MAGIC) return false;
+  warmState.magic = 0;
+  
+  uint32_t checksum = warmState.checksum;
+  warmState.checksum = 0;
+  uint32_t expected = rtcChecksum(&warmState, offsetof(WarmState, checksum));
+  if (checksum != expected || strncmp(warmState.firmware, FIRMWARE_VERSION, sizeof(warmState.firmware)) != 0) {
+    return false;
+  }
+  warmState.idToken[sizeof(warmState.idToken) - 1] = '\0';
+  warmState.refreshToken[sizeof(warmState.refreshToken) - 1] = '\0';
+  
+  // The restart itself takes a few seconds; the first AT+CCLK? corrects that
+  if (warmState.epoch) {
+    portENTER_CRITICAL(&timeSyncMux);
+    timeSyncRestore(timeSync, warmState.epoch, warmState.driftPpm, warmState.driftValid, warmState.tzQuarters,
+                    esp_timer_get_time());
+    portEXIT_CRITICAL(&timeSyncMux);
+  }
+  modemBaud = warmState.modemBaud;
+  modemFlowControl = warmState.modemFlowControl;
+  gpsFixAcquired = warmState.gpsFixAcquired;
+  gpsSource = warmState.gpsSource;
+  gpsFix = warmState.gpsFix;
+  gpsTracker = warmState.gpsTracker;
+  setCurrentDay(warmState.day);
+  dailyImpressions = warmState.dailyImpressions;
+  dailyDataSent = warmState.dailyDataSent;
+  memcpy(impressionDeltas, warmState.impressionDeltas, sizeof(impressionDeltas));
+  return true;
+#else
+  return false;
+#endif
+}
+
+// ============ MODEM UART ============
+
+bool probeModem(uint32_t baud) {
+  /*
+   * Plain AT at `baud`, a few tries; true if the modem answers OK
+   */
+  SerialAT.updateBaudRate(baud);
+  while (SerialAT.available()) SerialAT.read();
+  for (int i = 0; i < 3; i++) {
+    if (atEngine.run("AT", NULL, MODEM_PROBE_TIMEOUT_MS) == AtResult::Ok) return true;
+  }
+  return false;
+}
+
+uint32_t findModemBaud() {
+  /*
+   * The rate a modem that was not reset is still listening on: the
+   * default first, then every negotiable rate. 0 if nothing answers
+   * (modem still booting or powered down).
+   */
+  if (probeModem(MODEM_BAUD_DEFAULT)) return MODEM_BAUD_DEFAULT;
+  for (size_t i = 0; i < sizeof(modemBaudCandidates) / sizeof(modemBaudCandidates[0]); i++) {
+    if (probeModem(modemBaudCandidates[i])) return modemBaudCandidates[i];
+  }
+  return 0;
+}
+
+static void storeBaudCeiling(Preferences& prefs, uint32_t ceiling) {
+  prefs.putUInt("ceiling", ceiling);
+  prefs.putUChar("ceiling_boots", MODEM_BAUD_CEILING_BOOTS);
+}
+
+void negotiateModemBaud() {
+  /*
+   * Move the modem UART off 115200. AT+IPR is temporary - every
+   * AT+CRESET brings the modem back to MODEM_BAUD_DEFAULT - so a failed
+   * rate can never lock us out for more than one restart.
+   *
+   * NVS ("modem" namespace) remembers the outcome:
+   *   baud    - last rate that passed the echo test, tried first
+   *   ceiling - lowest rate that failed; it and anything faster are skipped
+   *             for the next MODEM_BAUD_CEILING_BOOTS negotiations
+   *             (ceiling_boots), then tried again
+   *   pending - rate being switched to; still set at boot means the
+   *             switch crashed or hung, so it counts as failed
+   */
+  Preferences prefs;
+  if (!prefs.begin("modem", false)) return;
+  
+  uint32_t ceiling = prefs.getUInt("ceiling", 0);
+  if (ceiling) {
+    // A failed rate is not failed forever: a marginal cable or a bad boot should not cap the link for good
+    uint8_t boots = prefs.getUChar("ceiling_boots", 0);
+    if (boots <= 1) {
+      ceiling = 0;
+      prefs.remove("ceiling");
+      prefs.remove("ceiling_boots");
+      Serial.println("   Modem baud ceiling expired - faster rates are tried again");
+    } else {
+      prefs.putUChar("ceiling_boots", boots - 1);
+    }
+  }
+  uint32_t pending = prefs.getUInt("pending", 0);
+  if (pending) {
+    if (!ceiling || pending < ceiling) ceiling = pending;
+    storeBaudCeiling(prefs, ceiling);
+    prefs.remove("pending");
+  }
+  uint32_t stored = prefs.getUInt("baud", 0);
+  
+  // Hardware flow control first, so the fast rates have it from the first byte
+  if (MODEM_RTS_PIN >= 0 && MODEM_CTS_PIN >= 0 &&
+      atEngine.run("AT+IFC=2,2", NULL, AT_DEFAULT_TIMEOUT_MS) == AtResult::Ok) {
+    SerialAT.setPins(MODEM_RX, MODEM_TX, MODEM_CTS_PIN, MODEM_RTS_PIN);
+    modemFlowControl = SerialAT.setHwFlowCtrlMode(UART_HW_FLOWCTRL_CTS_RTS, 64);
+    
+    // A line that is configured but not actually wired stalls one side: prove both directions, else back out
+    if (modemFlowControl && !modemEchoTest(MODEM_BAUD_DEFAULT)) {
+      SerialAT.setHwFlowCtrlMode(UART_HW_FLOWCTRL_DISABLE, 64);
+      modemFlowControl = false;
+      atEngine.run("AT+IFC=0,0", NULL, AT_DEFAULT_TIMEOUT_MS);
+      while (SerialAT.available()) SerialAT.read();
+      Serial.println("⚠️  RTS/CTS configured but not answering - flow control off");
+      LOG_WARN("Modem: Warning - RTS/CTS echo test failed, flow control disabled");
+    }
+  }
+  
+  modemBaud = MODEM_BAUD_DEFAULT;
+  for (int pass = 0; pass < 2 && modemBaud == MODEM_BAUD_DEFAULT; pass++) {
+    for (size_t i = 0; i < sizeof(modemBaudCandidates) / sizeof(modemBaudCandidates[0]); i++) {
+      uint32_t baud = modemBaudCandidates[i];
+      if (pass == 0 && baud != stored) continue;  // First pass: only the stored rate
+      if (ceiling && baud >= ceiling) continue;
+      if (!modemFlowControl && baud > MODEM_BAUD_MAX_NO_FLOW) continue;
+      
+      prefs.putUInt("pending", baud);
+      bool ok = switchModemBaud(MODEM_BAUD_DEFAULT, baud);
+      prefs.remove("pending");
+      
+      if (ok) {
+        modemBaud = baud;
+        if (baud != stored) prefs.putUInt("baud", baud);
+        break;
+      }
+      ceiling = baud;
+      storeBaudCeiling(prefs, ceiling);
+      
+      // Fallback left the modem unreachable: a restart resets it to MODEM_BAUD_DEFAULT
+      if (!modemEchoTest(MODEM_BAUD_DEFAULT)) {
+        prefs.end();
+        Serial.println("❌ Modem lost after baud fallback - restarting");
+        LOG_ERROR("Modem: ERROR - no response after baud fallback, restarting");
+        restartSystem();
+      }
+    }
+  }
+  prefs.end();
+  
+  if (modemBaud != MODEM_BAUD_DEFAULT) {
+    Serial.printf("✓ Modem UART at %u baud (flow control %s)\n", modemBaud, modemFlowControl ? "RTS/CTS" : "off");
+    LOG_INFO("Modem: UART at %u baud", modemBaud);
+  } else {
+    Serial.printf("⚠️  Modem UART stays at %u baud\n", MODEM_BAUD_DEFAULT);
+    LOG_WARN("Modem: Warning - baud negotiation failed, staying at default");
+  }
+}
+
+bool switchModemBaud(uint32_t from, uint32_t to) {
+  /*
+   * The modem answers AT+IPR at the old rate and switches right after.
+   * On a failed echo test both sides are put back on `from`.
+   */
+  char command[AT_COMMAND_MAX];
+  snprintf(command, sizeof(command), "AT+IPR=%u", to);
+  if (atEngine.run(command, NULL, AT_DEFAULT_TIMEOUT_MS) != AtResult::Ok) return false;
+  
+  SerialAT.flush();
+  delay(MODEM_BAUD_SETTLE_MS);
+  SerialAT.updateBaudRate(to);
+  while (SerialAT.available()) SerialAT.read();
+  
+  if (modemEchoTest(to)) return true;
+  
+  // Best effort: the modem may understand us at `to` even if its replies were garbled
+  snprintf(command, sizeof(command), "AT+IPR=%u", from);
+  atEngine.run(command, NULL, AT_DEFAULT_TIMEOUT_MS);
+  SerialAT.flush();
+  delay(MODEM_BAUD_SETTLE_MS);
+  SerialAT.updateBaudRate(from);
+  while (SerialAT.available()) SerialAT.read();
+  return false;
+}
+
+bool modemEchoTest(uint32_t baud) {
+  /*
+   * AT+IPR? must come back intact, reporting `baud`, every round
+   */
+  char line[AT_LINE_MAX];
+  for (int i = 0; i < MODEM_BAUD_ECHO_ROUNDS; i++) {
+    if (atEngine.run("AT+IPR?", "+IPR", AT_DEFAULT_TIMEOUT_MS, line, sizeof(line)) != AtResult::Ok) return false;
+    const char* value = strchr(line, ':');
+    if (!value || strtoul(value + 1, NULL, 10) != baud) return false;
+  }
+  return true;
+}
+
+// ============ TLS SESSION CACHE ============
+
+void initTlsSessionCache() {
+  /*
+   * Attach the session cache to the SSL client and, after a software
+   * restart, seed it from RTC memory so the first connection of the new
+   * boot can already be resumed. A cold boot finds garbage there and
+   * starts with an empty session (full handshake).
+   */
+#if TLS_TRANSPORT == TLS_TRANSPORT_ESP32 && TLS_SESSION_RESUMPTION
+  br_ssl_session_parameters* params = tls_session.getSession();
+#if TLS_SESSION_PERSIST_RTC
+  if (tlsSessionSnapshot.magic == TLS_SNAPSHOT_MAGIC &&
+      tlsSessionSnapshot.checksum == rtcChecksum(&tlsSessionSnapshot.params, sizeof(tlsSessionSnapshot.params)) &&
+      tlsSessionSnapshot.params.session_id_len <= sizeof(tlsSessionSnapshot.params.session_id)) {
+    memcpy(params, &tlsSessionSnapshot.params, sizeof(*params));
+    Serial.println("   ✓ TLS session restored from RTC memory");
+  } else {
+    memset(params, 0, sizeof(*params));
+  }
+#else
+  memset(params, 0, sizeof(*params));
+#endif
+  tlsLastSessionIdLen = params->session_id_len;
+  memcpy(tlsLastSessionId, params->session_id, sizeof(tlsLastSessionId));
+  ssl_client.setSession(&tls_session);
+#endif
+}
+
+void trackTlsHandshake() {
+  /*
+   * Classify each new connection. The handshake runs inside connect(), so
+   * once the connect count moves and the socket is up it has finished: a
+   * session ID equal to the one offered means the server resumed it,
+   * anything else was a full handshake (and is the new session to keep).
+   * The modem stack does not say whether it resumed, so every successful
+   * AT+CCHOPEN counts as full there.
+   */
+  if (session_client.connects() != tlsConnectsTimed) {
+    tlsConnectsTimed = session_client.connects();
+    profileSample(PROFILE_TLS_CONNECT, session_client.lastConnectUs());
+#if TLS_TRANSPORT == TLS_TRANSPORT_ESP32
+    profileSample(PROFILE_TCP_CONNECT, wire_client.lastConnectUs());
+#endif
+  }
+  
+#if TLS_TRANSPORT == TLS_TRANSPORT_MODEM
+  uint32_t opens = modem_tls.opens();
+  tlsFullHandshakes += opens - tlsConnectsSeen;
+  tlsConnectsSeen = opens;
+#else
+  uint32_t connects = wire_client.connects();
+  if (connects == tlsConnectsSeen) return;
+  tlsConnectsSeen = connects;
+  if (!ssl_client.connected()) return;
+  
+#if TLS_SESSION_RESUMPTION
+  const br_ssl_session_parameters* params = tls_session.getSession();
+  bool resumed = tlsLastSessionIdLen > 0 && params->session_id_len == tlsLastSessionIdLen &&
+                 memcmp(params->session_id, tlsLastSessionId, tlsLastSessionIdLen) == 0;
+  if (resumed) {
+    tlsResumedHandshakes++;
+    return;
+  }
+  
+  tlsFullHandshakes++;
+  tlsLastSessionIdLen = params->session_id_len;
+  memcpy(tlsLastSessionId, params->session_id, sizeof(tlsLastSessionId));
+#if TLS_SESSION_PERSIST_RTC
+  memcpy(&tlsSessionSnapshot.params, params, sizeof(*params));
+  tlsSessionSnapshot.checksum = rtcChecksum(&tlsSessionSnapshot.params, sizeof(tlsSessionSnapshot.params));
+  tlsSessionSnapshot.magic = TLS_SNAPSHOT_MAGIC;
+#endif
+#else
+  tlsFullHandshakes++;
+#endif
+#endif
+}
+
+void formatMacAddress(char* out, size_t size) {
+  uint8_t baseMac[6];
+  esp_read_mac(baseMac, ESP_MAC_WIFI_STA);
+  
+  snprintf(out, size, "%02X%02X%02X%02X%02X%02X", 
+           baseMac[0], baseMac[1], baseMac[2], 
+           baseMac[3], baseMac[4], baseMac[5]);
+}
+
+void asyncCB(AsyncResult &aResult) {
+  if (aResult.isEvent()) {
+    Firebase.printf("Event: %s, msg: %s, code: %d\n", 
+                    aResult.uid().c_str(), 
+                    aResult.appEvent().message().c_str(), 
+                    aResult.appEvent().code());
+    
+    if (strcmp(aResult.uid().c_str(), "authTask") == 0 && aResult.appEvent().code() == 9) {
+      Serial.println("✓ Authentication successful!");
+    }
+  }
+  
+  if (aResult.isDebug()) {
+    Firebase.printf("Debug: %s, msg: %s\n", aResult.uid().c_str(), aResult.debug().c_str());
+  }
+  
+  if (aResult.isError()) {
+    Serial.println("\n❌ FIREBASE ERROR:");
+    Firebase.printf("   Task: %s\n", aResult.uid().c_str());
+    Firebase.printf("   Message: %s\n", aResult.error().message().c_str());
+    Firebase.printf("   Code: %d\n\n", aResult.error().code());
+    
+    LOG_ERROR("Firebase Upload ERROR - Task: %s, Code: %d, Msg: %s", aResult.uid().c_str(), aResult.error().code(),
+              aResult.error().message().c_str());
+  }
+  
+  if (aResult.available()) {
+    const char* taskId = aResult.uid().c_str();
+    if (strcmp(taskId, "deviceInfoTask") == 0) {
+      Serial.println("✓ Device info upload successful!\n");
+      LOG_INFO("Firebase Upload: Device info successful");
+    } else {
+      Firebase.printf("✓ Upload successful: %s\n", taskId);
+      LOG_INFO("Firebase Upload: %s successful", taskId);
+    }
+  }
+}
+
+// ============ SD CARD LOGGING FUNCTIONS ============
+
+bool initSDCard() {
+  /*
+   * Initialize SD card module
+   * Default SPI pins for ESP32: MOSI=23, MISO=19, SCK=18
+   * CS pin defined as SD_CS_PIN
+   */
+  if (!SD.begin(SD_CS_PIN)) {
+    Serial.println("   SD Card mount failed!");
+    return false;
+  }
+  
+  uint8_t cardType = SD.cardType();
+  if (cardType == CARD_NONE) {
+    Serial.println("   No SD card attached!");
+    return false;
+  }
+  
+  Serial.print("   SD Card Type: ");
+  if (cardType == CARD_MMC) {
+    Serial.println("MMC");
+  } else if (cardType == CARD_SD) {
+    Serial.println("SDSC");
+  } else if (cardType == CARD_SDHC) {
+    Serial.println("SDHC");
+  } else {
+    Serial.println("UNKNOWN");
+  }
+  
+  uint64_t cardSize = SD.cardSize() / (1024 * 1024);
+  Serial.printf("   SD Card Size: %lluMB\n", cardSize);
+  
+  uint64_t cardUsed = SD.usedBytes() / (1024 * 1024);
+  uint64_t cardTotal = SD.totalBytes() / (1024 * 1024);
+  Serial.printf("   Space Used: %lluMB / %lluMB\n", cardUsed, cardTotal);
+  
+  // Log file stays open; the SD task owns it from here on
+  if (!sdLogBegin(SD_LOG_PATH)) {
+    Serial.printf("   Cannot open %s\n", SD_LOG_PATH);
+    return false;
+  }
+  
+  if (!scanArchiveBegin()) {
+    Serial.printf("   Cannot create %s - binary scan archive disabled\n", SCAN_ARCHIVE_DIR);
+  }
+  
+  outboxAvailable = outboxBegin();
+  if (outboxAvailable) {
+    Serial.printf("   Outbox: %u report(s) waiting from earlier sessions\n", outboxPending());
+  } else {
+    Serial.printf("   Cannot open %s - offline reports will not be kept\n", OUTBOX_PATH);
+  }
+  
+  return true;
+}
+
+bool applyNetworkTime(const char* line) {
+  /*
+   * Feed one +CCLK: reading to the clock. Unset RTCs are rejected.
+   */
+  uint32_t epoch;
+  int16_t tzQuarters;
+  if (!parseCclk(line, &epoch, &tzQuarters)) return false;
+  
+  portENTER_CRITICAL(&timeSyncMux);
+  timeSyncApply(timeSync, epoch, tzQuarters, esp_timer_get_time());
+  portEXIT_CRITICAL(&timeSyncMux);
+  return true;
+}
+
+uint32_t currentEpoch() {
+  /*
+   * Unix seconds from the drift-corrected monotonic clock, 0 until synced
+   */
+  portENTER_CRITICAL(&timeSyncMux);
+  uint64_t nowMs = timeNowMs(timeSync, esp_timer_get_time());
+  portEXIT_CRITICAL(&timeSyncMux);
+  
+  return (uint32_t)(nowMs / 1000);
+}
+
+const char* currentTimestamp(char* out, size_t size) {
+  /*
+   * Current time as text for logs and uploads; uptime until the clock is synced
+   */
+  uint32_t epoch = currentEpoch();
+  if (epoch) return formatUtc(epoch, out, size);
+  
+  snprintf(out, size, "uptime %lus", (unsigned long)uptimeSeconds());
+  return out;
+}
+
+int32_t currentLocalHour() {
+  uint32_t epoch = currentEpoch();
+  if (epoch == 0) return -1;
+  
+  portENTER_CRITICAL(&timeSyncMux);
+  int32_t hour = timeLocalHour(timeSync, epoch);
+  portEXIT_CRITICAL(&timeSyncMux);
+  return hour;
+}
+
+int32_t currentLocalDay() {
+  uint32_t epoch = currentEpoch();
+  if (epoch == 0) return TIME_NO_DAY;
+  
+  portENTER_CRITICAL(&timeSyncMux);
+  int32_t day = timeLocalDay(timeSync, epoch);
+  portEXIT_CRITICAL(&timeSyncMux);
+  return day;
+}
+
+void setCurrentDay(int32_t day) {
+  currentDay = day;
+  if (day == TIME_NO_DAY) {
+    currentDate[0] = '\0';
+  } else {
+    formatDay(day, currentDate, sizeof(currentDate));
+  }
+}
+
+void rollDailyTotals() {
+  /*
+   * Uplink task, before a cycle is credited: start the daily totals of a
+   * new local day, so every cycle is counted for exactly one day (the one
+   * it closed on). Runs whether or not Firebase is up; cycles from before
+   * the first clock sync count for the first valid day.
+   */
+  int32_t today = currentLocalDay();
+  if (today == TIME_NO_DAY || today == currentDay) return;
+  if (currentDay == TIME_NO_DAY) {
+    setCurrentDay(today);
+    return;
+  }
+  
+  char previous[TIME_DATE_TEXT_MAX];
+  memcpy(previous, currentDate, sizeof(previous));
+  setCurrentDay(today);
+  Serial.printf("📅 New day detected (was %s, now %s)\n", previous, currentDate);
+  memset(dailyProximity, 0, sizeof(dailyProximity));
+  memset(&dailyVisits, 0, sizeof(dailyVisits));
+  dailyImpressions = 0;
+  
+#if !UPLOAD_DELTA_MODE
+  // Overwrite mode: continue from the server's total if another boot already counted today
+  if (!app.ready()) return;
+  char impressionsPath[FIREBASE_PATH_MAX];
+  snprintf(impressionsPath, sizeof(impressionsPath), "%s/data/%s/daily_impressions", devicePath, currentDate);
+  Serial.printf("📥 Loading impressions for new day from: %s\n", impressionsPath);
+  
+  int existingImpressions = Database.get<int>(aClient, impressionsPath);
+  if (aClient.lastError().code() == 0 && existingImpressions > 0) {
+    dailyImpressions = existingImpressions;
+    Serial.printf("✓ Loaded %d existing impressions for new day\n", dailyImpressions);
+  } else {
+    Serial.println("ℹ️  No existing data for new day - starting fresh\n");
+  }
+#endif
+}
+
+void logToSD(const char* format, ...) {
+  /*
+   * Queue a printf-formatted log message for the SD task with timestamp,
+   * formatted straight into the queue entry (truncated to LOG_MESSAGE_MAX).
+   * Safe to call from any task; never blocks on the card.
+   */
+  if (!sdCardAvailable || !logQueue) return;
+  
+  char timestamp[TIME_TEXT_MAX];
+  currentTimestamp(timestamp, sizeof(timestamp));
+  
+  LogMessage entry;
+  int prefix = snprintf(entry.text, sizeof(entry.text), "[%s] ", timestamp);
+  if (prefix > 0 && (size_t)prefix < sizeof(entry.text)) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(entry.text + prefix, sizeof(entry.text) - prefix, format, args);
+    va_end(args);
+  }
+  
+  if (xQueueSend(logQueue, &entry, 0) != pdTRUE) {
+    logMessagesDropped++;
+  }
+}
+
+void requestLogFlush(uint32_t timeoutMs) {
+  /*
+   * Ask the SD task to write out its RAM buffer and wait (bounded) for it.
+   * An empty LogMessage is the flush marker.
+   */
+  if (!sdCardAvailable || !logQueue || !sdTaskHandle) return;
+  
+  uint32_t flushesBefore = logFlushesCompleted;
+  LogMessage marker;
+  marker.text[0] = '\0';
+  
+  uint32_t start = millis();
+  if (xQueueSend(logQueue, &marker, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) return;
+  while (logFlushesCompleted == flushesBefore && millis() - start < timeoutMs) {
+    delay(10);
+  }
+}
+
+// ============ REMOTE CONFIG ============
+
+void loadRuntimeConfig() {
+  /*
+   * The last remote config from NVS "config" (scan_ms, scans, upload_max_s,
+   * restart_h), so a boot schedules with it before the network is up.
+   * A stored set that does not validate is ignored.
+   */
+  Preferences prefs;
+  if (!prefs.begin("config", true)) return;
+  RuntimeConfig stored = runtimeConfig;
+  stored.scanIntervalMs = prefs.getUInt("scan_ms", stored.scanIntervalMs);
+  stored.scansPerUpload = prefs.getUInt("scans", stored.scansPerUpload);
+  stored.uploadIntervalMaxS = prefs.getUInt("upload_max_s", stored.uploadIntervalMaxS);
+  stored.restartIntervalH = prefs.getUInt("restart_h", stored.restartIntervalH);
+  prefs.end();
+  
+  if (remoteConfigValid(stored)) {
+    runtimeConfig = stored;
+  } else {
+    Serial.println("⚠️  Stored runtime config rejected - using defaults");
+  }
+}
+
+void storeRuntimeConfig() {
+  /*
+   * Cache the scheduling values for the next boot (proximity and profiling
+   * keep their own namespaces)
+   */
+  Preferences prefs;
+  if (!prefs.begin("config", false)) return;
+  prefs.putUInt("scan_ms", runtimeConfig.scanIntervalMs);
+  prefs.putUInt("scans", runtimeConfig.scansPerUpload);
+  prefs.putUInt("upload_max_s", runtimeConfig.uploadIntervalMaxS);
+  prefs.putUInt("restart_h", runtimeConfig.restartIntervalH);
+  prefs.end();
+}
+
+void serviceRemoteConfig() {
+  /*
+   * Read /devices/<id>/config once signed in, then right after an
+   * acknowledged report at most every CONFIG_POLL_INTERVAL_MS: the modem is
+   * awake and the TLS socket open, so the GET costs no extra wake-up or
+   * handshake. A poll rather than an RTDB stream, which would hold a second
+   * socket (and the modem) awake around the clock.
+   */
+  if (!configPollDue || configPollPending || !app.ready()) return;
+  configPollDue = false;
+  configPollPending = true;
+  lastConfigPoll = millis();
+  
+  char path[FIREBASE_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/config", devicePath);
+  Database.get(aClient, path, onConfigResult, false, "config");
+}
+
+void onConfigResult(AsyncResult& aResult) {
+  /*
+   * Completion of the config read. A node that cannot be parsed, or a
+   * failed read, leaves the settings in use alone until the next poll.
+   */
+  if (aResult.isError()) {
+    configPollPending = false;
+    asyncCB(aResult);
+    return;
+  }
+  if (!aResult.available()) return;
+  configPollPending = false;
+  
+  RuntimeConfig next;
+  RemoteConfigResult result = remoteConfigParse(aResult.c_str(), runtimeConfig, next);
+  if (!result.valid) {
+    configRejected++;
+    Serial.println("⚠️  Remote config is not a JSON object - ignored");
+    LOG_WARN("Config: ERROR - unreadable config node");
+    return;
+  }
+  if (result.rejected) {
+    configRejected += result.rejected;
+    Serial.printf("⚠️  Remote config: %u value(s) out of range - kept current\n", result.rejected);
+    LOG_WARN("Config: %u value(s) rejected", result.rejected);
+  }
+  if (result.changed == 0) return;
+  
+  applyRuntimeConfig(next, result.changed);
+  configUpdates++;
+  Serial.printf("⚙️  Remote config applied: scan %u ms x %u, reports <= %u s, restart %u h, profiling %s\n",
+                runtimeConfig.scanIntervalMs, runtimeConfig.scansPerUpload, runtimeConfig.uploadIntervalMaxS,
+                runtimeConfig.restartIntervalH, runtimeConfig.profiling ? "on" : "off");
+  LOG_INFO("Config: remote settings applied (scan %u ms x %u)", runtimeConfig.scanIntervalMs,
+           runtimeConfig.scansPerUpload);
+}
+
+void applyRuntimeConfig(const RuntimeConfig& next, uint16_t changed) {
+  /*
+   * Uplink task: take a validated config live and cache it. The scan task
+   * picks up the interval at its next tick and the aggregator the cycle
+   * length at the end of the running scan; the report interval bounds and
+   * the restart schedule apply at once. A node without "profiling" leaves
+   * a serial "profile on|off" in force; one that names it wins.
+   */
+  runtimeConfig.scanIntervalMs = next.scanIntervalMs;
+  runtimeConfig.scansPerUpload = next.scansPerUpload;
+  runtimeConfig.uploadIntervalMaxS = next.uploadIntervalMaxS;
+  runtimeConfig.restartIntervalH = next.restartIntervalH;
+  
+  uint32_t maxMs = runtimeConfig.uploadIntervalMaxS * 1000;
+  if (uploadIntervalMs > maxMs) uploadIntervalMs = maxMs;
+  if (uploadIntervalMs < UPLOAD_INTERVAL_MIN_MS) uploadIntervalMs = UPLOAD_INTERVAL_MIN_MS;
+  
+  if (changed & CONFIG_PROXIMITY) {
+    // Rebuilt in place: sightings classified meanwhile may get either band (see Proximity.h)
+    runtimeConfig.proximity = next.proximity;
+    proximityTableBuild(proximityTable, runtimeConfig.proximity);
+    storeProximityCalibration();
+  }
+  if (changed & CONFIG_PROFILING) setProfiling(next.profiling);
+  storeRuntimeConfig();
+  deviceInfoUploaded = false;  // Republish device_info with the values in use
+}
+
+// ============ FIRMWARE UPDATES ============
+
+// Keeps the Arduino core from marking a new image valid before setup():
+// with bootloader rollback compiled in, otaConfirm() does it once signed in
+extern "C" bool verifyRollbackLater() { return true; }
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+#define otaHashStart(ctx) mbedtls_sha256_starts(ctx, 0)
+#define otaHashUpdate(ctx, data, length) mbedtls_sha256_update(ctx, data, length)
+#define otaHashFinish(ctx, digest) mbedtls_sha256_finish(ctx, digest)
+#else
+#define otaHashStart(ctx) mbedtls_sha256_starts_ret(ctx, 0)
+#define otaHashUpdate(ctx, data, length) mbedtls_sha256_update_ret(ctx, data, length)
+#define otaHashFinish(ctx, digest) mbedtls_sha256_finish_ret(ctx, digest)
+#endif
+
+static size_t otaReadPatch(void* ctx, uint8_t* out, size_t length) {
+  return otaFile.read(out, length);
+}
+
+static bool otaReadSource(void* ctx, uint32_t offset, uint8_t* out, size_t length) {
+  return esp_partition_read(otaSource, offset, out, length) == ESP_OK;
+}
+
+static bool otaWriteTarget(void* ctx, const uint8_t* data, size_t length) {
+  otaHashUpdate(&otaHash, data, length);
+  return esp_ota_write(otaHandle, data, length) == ESP_OK;
+}
+
+const char* otaStateName() {
+  switch (otaState) {
+    case OTA_CHECKING: return "checking";
+    case OTA_OFFERED: return "offered";
+    case OTA_DOWNLOADING: return "downloading";
+    case OTA_DOWNLOADED: return "downloaded";
+    case OTA_APPLYING: return "applying";
+    default: return "idle";
+  }
+}
+
+void otaBootCheck() {
+  /*
+   * First thing at boot: settle the trial record in NVS "ota" (trial,
+   * prev, boots, reason, failed) that otaFinish() left behind.
+   *   - no trial: the update known to have failed, if any, is never retried
+   *   - trial for another version: this is the old image again (rolled
+   *     back here or by the bootloader), so the trial version has failed
+   *   - trial for this version: one more boot of the new image; past
+   *     OTA_TRIAL_BOOTS without reaching app.ready() it is rolled back
+   */
+  Preferences prefs;
+  if (!prefs.begin("ota", false)) return;
+  char trial[MANIFEST_VERSION_MAX] = "";
+  prefs.getString("trial", trial, sizeof(trial));
+  prefs.getString("failed", otaFailedVersion, sizeof(otaFailedVersion));
+  
+  if (trial[0] == '\0') {
+    prefs.end();
+    return;
+  }
+  
+  if (strcmp(trial, FIRMWARE_VERSION) != 0) {
+    char reason[48] = "";
+    if (!prefs.getString("reason", reason, sizeof(reason))) strncpy(reason, "image did not start", sizeof(reason) - 1);
+    strncpy(otaFailedVersion, trial, sizeof(otaFailedVersion) - 1);
+    prefs.putString("failed", otaFailedVersion);
+    prefs.remove("trial");
+    prefs.remove("prev");
+    prefs.remove("boots");
+    prefs.remove("reason");
+    prefs.end();
+    Serial.printf("↩️  Update to %s rolled back (%s) - staying on %s\n\n", trial, reason, FIRMWARE_VERSION);
+    snprintf(otaBootNote, sizeof(otaBootNote), "Update to %s rolled back (%s)", trial, reason);
+    return;
+  }
+  
+  otaTrialBoots = prefs.getUChar("boots", 0) + 1;
+  prefs.putUChar("boots", otaTrialBoots);
+  prefs.end();
+  if (otaTrialBoots > OTA_TRIAL_BOOTS) {
+    otaRollback("restarted before signing in");
+    return;
+  }
+  otaTrialActive = true;
+  Serial.printf("🆕 Trial boot %u of %u for %s - confirmed once signed in\n\n", otaTrialBoots, OTA_TRIAL_BOOTS,
+                FIRMWARE_VERSION);
+  snprintf(otaBootNote, sizeof(otaBootNote), "Trial boot %u of %u", otaTrialBoots, OTA_TRIAL_BOOTS);
+}
+
+void otaConfirm() {
+  /*
+   * First app.ready() of the boot: the image reached Firebase, so it is
+   * kept. Also cancels the bootloader's own rollback where that is enabled.
+   */
+  otaConfirmed = true;
+  esp_ota_mark_app_valid_cancel_rollback();
+  if (!otaTrialActive) return;
+  
+  otaTrialActive = false;
+  Preferences prefs;
+  if (prefs.begin("ota", false)) {
+    prefs.remove("trial");
+    prefs.remove("prev");
+    prefs.remove("boots");
+    prefs.remove("reason");
+    prefs.end();
+  }
+  Serial.printf("✅ Update to %s confirmed (boot %u)\n", FIRMWARE_VERSION, otaTrialBoots);
+  LOG_INFO("OTA: Update to %s confirmed", FIRMWARE_VERSION);
+}
+
+void otaRollback(const char* reason) {
+  /*
+   * Boot the previous image again. Its otaBootCheck() then records this
+   * version as failed. Without a valid previous image the trial simply ends.
+   */
+  Preferences prefs;
+  char prev[17] = "";
+  if (prefs.begin("ota", false)) {
+    prefs.getString("prev", prev, sizeof(prev));
+    prefs.putString("reason", reason);
+    prefs.end();
+  }
+  const esp_partition_t* previous =
+      prev[0] ? esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, prev) : NULL;
+  if (!previous) previous = esp_ota_get_next_update_partition(NULL);
+  
+  Serial.printf("\n↩️  %s %s - rolling back to %s...\n", FIRMWARE_VERSION, reason,
+                previous ? previous->label : "?");
+  LOG_ERROR("OTA: %s %s - rolling back", FIRMWARE_VERSION, reason);
+  if (!previous || esp_ota_set_boot_partition(previous) != ESP_OK) {
+    // Nothing to go back to: keep running this image
+    Serial.println("❌ No bootable previous image - keeping this one");
+    LOG_ERROR("OTA: Rollback impossible, no bootable previous image");
+    otaTrialActive = false;
+    otaConfirmed = true;
+    if (prefs.begin("ota", false)) {
+      prefs.remove("trial");
+      prefs.remove("boots");
+      prefs.remove("reason");
+      prefs.end();
+    }
+    return;
+  }
+  requestLogFlush(RESTART_LOG_FLUSH_TIMEOUT_MS);
+  ESP.restart();
+}
+
+void serviceOta() {
+  /*
+   * Uplink task. Confirms or rolls back a trial boot, then runs one
+   * update at a time:
+   *   checking     GET /firmware/updates/<version key>, once signed in and
+   *                then after an acknowledged report at most every
+   *                OTA_CHECK_INTERVAL_MS (rides the open socket)
+   *   downloading  Storage download of the patch to OTA_PATCH_PATH on SD
+   *   applying     OTA_APPLY_BLOCKS_PER_PASS blocks per pass into the
+   *                inactive slot, so reports and scans carry on meanwhile
+   */
+  if (!otaConfirmed) {
+    if (app.ready()) {
+      otaConfirm();
+    } else if (otaTrialActive && millis() >= OTA_CONFIRM_TIMEOUT_MS) {
+      otaRollback("not signed in within the confirm timeout");
+    }
+    return;
+  }
+  
+  switch (otaState) {
+    case OTA_IDLE:
+      if (otaCheckDue && app.ready()) {
+        otaCheckDue = false;
+        lastOtaCheck = millis();
+        if (!sdCardAvailable) return;  // Nowhere to stage the patch
+        char key[MANIFEST_VERSION_MAX];
+        char path[FIREBASE_PATH_MAX];
+        firmwareVersionKey(FIRMWARE_VERSION, key, sizeof(key));
+        snprintf(path, sizeof(path), "/firmware/updates/%s", key);
+        otaState = OTA_CHECKING;
+        Database.get(aClient, path, onOtaManifest, false, "ota");
+      }
+      break;
+    case OTA_OFFERED: {
+      static FileConfig patchFile(OTA_PATCH_PATH, otaFileCallback);
+      SD.remove(OTA_PATCH_PATH);
+      otaState = OTA_DOWNLOADING;
+      otaProgress = 0;
+      otaDownloadStart = millis();
+      Storage.download(aClient, FirebaseStorage::Parent(STORAGE_BUCKET, otaManifest.path), getFile(patchFile),
+                       onOtaDownload, "ota_download");
+      break;
+    }
+    case OTA_DOWNLOADING:
+      if (millis() - otaDownloadStart >= OTA_DOWNLOAD_TIMEOUT_MS) otaAbort("download timed out", false);
+      break;
+    case OTA_DOWNLOADED:
+      otaBeginApply();
+      break;
+    case OTA_APPLYING:
+      otaApplyStep();
+      break;
+    default:
+      break;
+  }
+}
+
+void onOtaManifest(AsyncResult& aResult) {
+  /*
+   * Completion of the manifest read. An update is taken only for another
+   * version than this one and the last that failed, with a slot to take it.
+   */
+  if (aResult.isError()) {
+    otaState = OTA_IDLE;
+    asyncCB(aResult);
+    return;
+  }
+  if (!aResult.available()) return;
+  otaState = OTA_IDLE;
+  
+  FirmwareManifest manifest;
+  ManifestStatus status = firmwareManifestParse(aResult.c_str(), manifest);
+  if (status == ManifestStatus::None) return;
+  if (status == ManifestStatus::Bad) {
+    Serial.println("⚠️  Firmware manifest unreadable - ignored");
+    LOG_WARN("OTA: ERROR - unreadable firmware manifest");
+    return;
+  }
+  if (strcmp(manifest.version, FIRMWARE_VERSION) == 0 || strcmp(manifest.version, otaFailedVersion) == 0) return;
+  if (!esp_ota_get_next_update_partition(NULL)) {
+    Serial.println("⚠️  Update offered but the partition table has no second OTA slot");
+    LOG_WARN("OTA: No OTA partition for %s", manifest.version);
+    return;
+  }
+  
+  otaManifest = manifest;
+  otaState = OTA_OFFERED;
+  Serial.printf("⬇️  Update %s -> %s offered: downloading %u B patch\n", FIRMWARE_VERSION, otaManifest.version,
+                otaManifest.size);
+  LOG_INFO("OTA: Downloading %s (%u B patch)", otaManifest.version, otaManifest.size);
+}
+
+void otaFileCallback(File& file, const char* filename, file_operating_mode mode) {
+  // The Firebase client writes the download through this file
+  switch (mode) {
+    case file_mode_open_read: file = SD.open(filename, FILE_READ); break;
+    case file_mode_open_write: file = SD.open(filename, FILE_WRITE); break;
+    case file_mode_open_append: file = SD.open(filename, FILE_APPEND); break;
+    case file_mode_remove: SD.remove(filename); break;
+    default: break;
+  }
+}
+
+void onOtaDownload(AsyncResult& aResult) {
+  /*
+   * Download progress, then completion. The last progress event comes as
+   * the last bytes arrive, before the client has flushed and closed the
+   * file, so only the task's closing result hands the patch to the uplink
+   * loop (which still checks its size).
+   */
+  if (otaState != OTA_DOWNLOADING) return;
+  if (aResult.isError()) {
+    asyncCB(aResult);
+    otaAbort("download failed", false);
+    return;
+  }
+  if (aResult.downloadProgress()) {
+    int progress = aResult.downloadInfo().progress;
+    if (progress / 10 != otaProgress / 10) Serial.printf("⬇️  Patch download %d%%\n", progress);
+    otaProgress = progress;
+    return;
+  }
+  if (aResult.isResult() && otaProgress == 100) otaState = OTA_DOWNLOADED;
+}
+
+static bool otaSourceMatches(const DeltaPatchHeader& header) {
+  // SHA-256 of the first sourceSize bytes of the running slot: the image the patch was made from
+  if (header.sourceSize > otaSource->size) return false;
+  uint8_t chunk[256];
+  uint8_t digest[32];
+  mbedtls_sha256_context hash;
+  mbedtls_sha256_init(&hash);
+  otaHashStart(&hash);
+  bool ok = true;
+  for (uint32_t offset = 0; ok && offset < header.sourceSize; offset += sizeof(chunk)) {
+    size_t length = header.sourceSize - offset < sizeof(chunk) ? header.sourceSize - offset : sizeof(chunk);
+    ok = esp_partition_read(otaSource, offset, chunk, length) == ESP_OK;
+    if (ok) otaHashUpdate(&hash, chunk, length);
+  }
+  otaHashFinish(&hash, digest);
+  mbedtls_sha256_free(&hash);
+  return ok && memcmp(digest, header.sourceSha256, sizeof(digest)) == 0;
+}
+
+void otaBeginApply() {
+  /*
+   * Check the staged patch against the manifest and the running image,
+   * then open the inactive slot (erased sector by sector as it is written)
+   */
+  otaFile = SD.open(OTA_PATCH_PATH, FILE_READ);
+  if (!otaFile || otaFile.size() != otaManifest.size) {
+    otaAbort("patch size differs from the manifest", false);
+    return;
+  }
+  otaSource = esp_ota_get_running_partition();
+  otaTarget = esp_ota_get_next_update_partition(NULL);
+  
+  DeltaPatchIo io = {otaReadPatch, otaReadSource, otaWriteTarget, NULL};
+  if (otaPatch.begin(io) != DeltaPatchStatus::Running) {
+    otaAbort("not a delta patch", true);
+    return;
+  }
+  const DeltaPatchHeader& header = otaPatch.header();
+  if (memcmp(header.targetSha256, otaManifest.sha256, sizeof(otaManifest.sha256)) != 0) {
+    otaAbort("patch builds another image than the manifest", true);
+    return;
+  }
+  if (!otaTarget || header.targetSize > otaTarget->size) {
+    otaAbort("image larger than the OTA slot", true);
+    return;
+  }
+  if (!otaSourceMatches(header)) {
+    otaAbort("patch is not for the running image", true);
+    return;
+  }
+  if (esp_ota_begin(otaTarget, OTA_WITH_SEQUENTIAL_WRITES, &otaHandle) != ESP_OK) {
+    otaHandle = 0;
+    otaAbort("esp_ota_begin failed", false);
+    return;
+  }
+  
+  mbedtls_sha256_init(&otaHash);
+  otaHashStart(&otaHash);
+  otaState = OTA_APPLYING;
+  otaProgress = 0;
+  Serial.printf("🔧 Applying patch: %u B -> %s (%u B image)\n", otaManifest.size, otaTarget->label,
+                header.targetSize);
+  LOG_INFO("OTA: Applying %s into %s", otaManifest.version, otaTarget->label);
+}
+
+void otaApplyStep() {
+  /*
+   * One pass: up to OTA_APPLY_BLOCKS_PER_PASS target blocks
+   */
+  for (int i = 0; i < OTA_APPLY_BLOCKS_PER_PASS; i++) {
+    DeltaPatchStatus status = otaPatch.step();
+    if (status == DeltaPatchStatus::Running) continue;
+    if (status == DeltaPatchStatus::Done) {
+      otaFinish();
+    } else {
+      // A header that passed and ops that do not: a corrupt download, fetched again next check
+      otaAbort(deltaPatchStatusName(status), false);
+    }
+    return;
+  }
+  
+  uint8_t progress = (uint8_t)((uint64_t)otaPatch.written() * 100 / otaPatch.header().targetSize);
+  if (progress / 10 != otaProgress / 10) Serial.printf("🔧 Patch applied %u%%\n", progress);
+  otaProgress = progress;
+}
+
+void otaFinish() {
+  /*
+   * Target complete: verify its hash, let esp_ota_end() check the image,
+   * record the trial and boot into it
+   */
+  otaFile.close();
+  uint8_t digest[32];
+  otaHashFinish(&otaHash, digest);
+  mbedtls_sha256_free(&otaHash);
+  if (memcmp(digest, otaManifest.sha256, sizeof(digest)) != 0) {
+    otaAbort("image hash mismatch", false);
+    return;
+  }
+  esp_err_t err = esp_ota_end(otaHandle);
+  otaHandle = 0;
+  if (err != ESP_OK) {
+    otaAbort("image rejected by esp_ota_end", true);
+    return;
+  }
+  
+  Preferences prefs;
+  if (!prefs.begin("ota", false)) {
+    otaAbort("NVS unavailable for the trial record", false);
+    return;
+  }
+  prefs.putString("trial", otaManifest.version);
+  prefs.putString("prev", otaSource->label);
+  prefs.putUChar("boots", 0);
+  prefs.remove("reason");
+  prefs.end();
+  
+  if (esp_ota_set_boot_partition(otaTarget) != ESP_OK) {
+    if (prefs.begin("ota", false)) {
+      prefs.remove("trial");
+      prefs.remove("prev");
+      prefs.remove("boots");
+      prefs.end();
+    }
+    otaAbort("esp_ota_set_boot_partition failed", true);
+    return;
+  }
+  SD.remove(OTA_PATCH_PATH);
+  
+  char hex[17];
+  Serial.printf("\n✅ %s written to %s (sha256 %s...) - restarting into it\n", otaManifest.version, otaTarget->label,
+                sha256Hex(digest, 8, hex, sizeof(hex)));
+  Serial.println("═══════════════════════════════════════════════════════\n");
+  LOG_INFO("OTA: %s verified, restarting into %s", otaManifest.version, otaTarget->label);
+  delay(1000);
+  restartSystem();
+}
+
+void otaAbort(const char* reason, bool permanent) {
+  /*
+   * Drop the update in progress. A transient failure (download, corrupt
+   * patch, flash) is retried at the next check; a patch that can never
+   * apply here, or an image esp_ota_end() refuses, marks the version
+   * failed, like a rollback does.
+   */
+  if (otaHandle) {
+    esp_ota_abort(otaHandle);
+    otaHandle = 0;
+    mbedtls_sha256_free(&otaHash);
+  }
+  if (otaFile) otaFile.close();
+  SD.remove(OTA_PATCH_PATH);
+  otaState = OTA_IDLE;
+  otaUpdatesFailed++;
+  
+  if (permanent) {
+    strncpy(otaFailedVersion, otaManifest.version, sizeof(otaFailedVersion) - 1);
+    Preferences prefs;
+    if (prefs.begin("ota", false)) {
+      prefs.putString("failed", otaFailedVersion);
+      prefs.end();
+    }
+  }
+  Serial.printf("❌ Update to %s abandoned: %s%s\n", otaManifest.version, reason, permanent ? "" : " (retried later)");
+  LOG_ERROR("OTA: Update to %s abandoned - %s", otaManifest.version, reason);
+}
+
+// ============ PROFILING ============
+
+void profileSample(uint8_t stage, uint32_t value) {
+  /*
+   * Any task: one stage timing into its histogram (no-op while profiling is off)
+   */
+  if (!profilingEnabled) return;
+  portENTER_CRITICAL(&profileMux);
+  profileRecord(profileStages[stage], value);
+  portEXIT_CRITICAL(&profileMux);
+}
+
+void onAtTiming(AtResult result, uint32_t roundTripUs) {
+  // Timeouts are counted by the engine; their duration is just the timeout
+  if (result != AtResult::Timeout) profileSample(PROFILE_AT_COMMAND, roundTripUs);
+}
+
+static uint32_t heapFragmentationPercent(uint32_t freeHeap, uint32_t largestBlock) {
+  // Share of free heap not available as one block
+  return freeHeap ? 100 - (uint32_t)((uint64_t)largestBlock * 100 / freeHeap) : 0;
+}
+
+static void takeProfile(ProfileSummary (&out)[PROFILE_STAGES]) {
+  portENTER_CRITICAL(&profileMux);
+  for (size_t i = 0; i < PROFILE_STAGES; i++) profileSummarize(profileStages[i], out[i]);
+  portEXIT_CRITICAL(&profileMux);
+}
+
+bool appendProfile(JsonWriter& json) {
+  /*
+   * Diagnostics member for the window since the last acknowledged report
+   * (a failed one leaves it to the next):
+   *   "prof":{"<stage>":[n,min,avg,p99,max],...,
+   *           "heap":[free,largest_block,frag_pct,min_free],"stack":[scan,aggregation,uplink,sd]}
+   * Stages without samples are left out; units are in the key suffix.
+   */
+  ProfileSummary summaries[PROFILE_STAGES];
+  takeProfile(summaries);
+  
+  json.member("\"prof\":{");
+  for (size_t i = 0; i < PROFILE_STAGES; i++) {
+    const ProfileSummary& p = summaries[i];
+    if (p.count == 0) continue;
+    json.member("\"%s\":[%u,%u,%u,%u,%u]", kProfileStageKeys[i], p.count, p.min, p.avg, p.p99, p.max);
+  }
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largestBlock = ESP.getMaxAllocHeap();
+  json.member("\"heap\":[%u,%u,%u,%u]", freeHeap, largestBlock, heapFragmentationPercent(freeHeap, largestBlock),
+              ESP.getMinFreeHeap());
+  json.member("\"stack\":[%u,%u,%u,%u]", uxTaskGetStackHighWaterMark(scanTaskHandle),
+              uxTaskGetStackHighWaterMark(aggregationTaskHandle), uxTaskGetStackHighWaterMark(uplinkTaskHandle),
+              uxTaskGetStackHighWaterMark(sdTaskHandle));
+  json.append("}");
+  profileReported = json.ok();
+  return profileReported;
+}
+
+void resetProfile() {
+  /*
+   * Start a new window: the last one was delivered, or profiling just came on
+   */
+  portENTER_CRITICAL(&profileMux);
+  for (size_t i = 0; i < PROFILE_STAGES; i++) profileReset(profileStages[i]);
+  portEXIT_CRITICAL(&profileMux);
+  profileReported = false;
+}
+
+void printProfile() {
+  /*
+   * Serial view of the current window (not reset; the report ack does that)
+   */
+  if (!profilingEnabled) return;
+  
+  ProfileSummary summaries[PROFILE_STAGES];
+  takeProfile(summaries);
+  
+  Serial.println("⏱️  PROFILE (since last acked report: n / min / avg / p99 / max):");
+  for (size_t i = 0; i < PROFILE_STAGES; i++) {
+    const ProfileSummary& p = summaries[i];
+    Serial.printf("   ├─ %-28s%u / %u / %u / %u / %u\n", kProfileStageKeys[i], p.count, p.min, p.avg, p.p99, p.max);
+  }
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largestBlock = ESP.getMaxAllocHeap();
+  Serial.printf("   └─ Heap Free / Largest Block:  %u / %u B (%u%% fragmented)\n\n", freeHeap, largestBlock,
+                heapFragmentationPercent(freeHeap, largestBlock));
+}
+
+void loadProfilingSetting() {
+  /*
+   * NVS "diag"/"profile" overrides PROFILE_ENABLED_DEFAULT
+   */
+  Preferences prefs;
+  if (prefs.begin("diag", true)) {
+    profilingEnabled = prefs.getBool("profile", PROFILE_ENABLED_DEFAULT);
+    prefs.end();
+  }
+  runtimeConfig.profiling = profilingEnabled;
+  Serial.printf("⏱️  Stage profiling: %s\n\n", profilingEnabled ? "on" : "off");
+}
+
+void setProfiling(bool enabled) {
+  /*
+   * Runtime toggle, kept across restarts and echoed in device_info/config.
+   * Switching on starts a clean window.
+   */
+  if (enabled && !profilingEnabled) resetProfile();
+  profilingEnabled = enabled;
+  runtimeConfig.profiling = enabled;
+  deviceInfoUploaded = false;
+  
+  Preferences prefs;
+  if (prefs.begin("diag", false)) {
+    prefs.putBool("profile", enabled);
+    prefs.end();
+  }
+  Serial.printf("⏱️  Stage profiling switched %s\n", enabled ? "on" : "off");
+  LOG_INFO("Profiling: %s", enabled ? "on" : "off");
+}
+
+void serviceConsole() {
+  /*
+   * Uplink task: line commands on the USB serial port ("profile on|off",
+   * "ota check" for a manifest read at the next chance)
+   */
+  while (Serial.available() > 0) {
+    char c = (char)Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (consoleLength < sizeof(consoleLine) - 1) consoleLine[consoleLength++] = c;
+      continue;
+    }
+    consoleLine[consoleLength] = '\0';
+    if (strcmp(consoleLine, "profile on") == 0) {
+      setProfiling(true);
+    } else if (strcmp(consoleLine, "profile off") == 0) {
+      setProfiling(false);
+    } else if (strcmp(consoleLine, "ota check") == 0) {
+      otaCheckDue = true;
+    }
+    consoleLength = 0;
+  }
+}
+
+// ============ POWER MANAGEMENT ============
+
+void initPowerManagement() {
+  /*
+   * Dynamic frequency scaling plus automatic light sleep: with tickless
+   * idle the CPU sleeps whenever every task is blocked and no hold is
+   * active. The Arduino core's prebuilt sdkconfig may lack
+   * CONFIG_FREERTOS_USE_TICKLESS_IDLE; esp_pm_configure() then refuses
+   * light sleep and only DFS is applied. Probe capture needs the radio
+   * listening all the time, so it never light-sleeps.
+   */
+  esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "scan", &scanPmLock);
+  esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "modem", &modemPmLock);
+  powerAwakeSinceUs = esp_timer_get_time();
+  powerSampleUs = powerAwakeSinceUs;
+  
+#if POWER_SAVE_ENABLED
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_pm_config_t config;
+#else
+  esp_pm_config_esp32_t config;
+#endif
+  config.max_freq_mhz = POWER_CPU_MAX_MHZ;
+  config.min_freq_mhz = POWER_CPU_MIN_MHZ;
+  config.light_sleep_enable = CAPTURE_MODE != CAPTURE_MODE_PROBE;
+  
+  esp_err_t err = esp_pm_configure(&config);
+  if (err == ESP_ERR_NOT_SUPPORTED && config.light_sleep_enable) {
+    config.light_sleep_enable = false;
+    err = esp_pm_configure(&config);
+    Serial.println("⚠️  Light sleep unavailable (needs CONFIG_FREERTOS_USE_TICKLESS_IDLE) - frequency scaling only");
+    LOG_WARN("Power: light sleep not supported by this build, DFS only");
+  }
+  lightSleepActive = err == ESP_OK && config.light_sleep_enable;
+  if (lightSleepActive) WiFi.setSleep(true);  // Light sleep requires WiFi modem sleep
+  Serial.printf("⚡ Power: %u-%u MHz, light sleep %s\n\n", POWER_CPU_MIN_MHZ, POWER_CPU_MAX_MHZ,
+                lightSleepActive ? "ON" : "OFF");
+#endif
+  
+#if CAPTURE_MODE == CAPTURE_MODE_PROBE
+  powerHold(POWER_HOLD_SCAN, true);
+#endif
+}
+
+void powerHold(uint8_t source, bool held) {
+  /*
+   * Take or drop one reason to stay out of light sleep, and account the
+   * time with at least one reason held as ESP32 awake time
+   */
+  bool change;
+  portENTER_CRITICAL(&powerMux);
+  uint8_t before = powerHolds;
+  powerHolds = held ? (powerHolds | source) : (powerHolds & ~source);
+  change = (before & source) != (powerHolds & source);
+  if (change) {
+    uint64_t now = esp_timer_get_time();
+    if (before == 0 && powerHolds != 0) powerAwakeSinceUs = now;
+    if (before != 0 && powerHolds == 0) powerAwakeUs += now - powerAwakeSinceUs;
+  }
+  portEXIT_CRITICAL(&powerMux);
+  
+  if (!change) return;
+  esp_pm_lock_handle_t lock = source == POWER_HOLD_SCAN ? scanPmLock : modemPmLock;
+  if (lock == NULL) return;
+  if (held) {
+    esp_pm_lock_acquire(lock);
+  } else {
+    esp_pm_lock_release(lock);
+  }
+}
+
+void initModemPower() {
+  /*
+   * DTR low = modem awake. Also undoes a sleeping modem left behind by
+   * an ESP32 reset (the GPIO floats until it is driven again).
+   */
+#if MODEM_DTR_PIN >= 0
+  pinMode(MODEM_DTR_PIN, OUTPUT);
+  digitalWrite(MODEM_DTR_PIN, LOW);
+#endif
+  modemAwake = true;
+  modemAwakeSinceUs = esp_timer_get_time();
+  powerHold(POWER_HOLD_MODEM, true);
+}
+
+void enableModemSleep() {
+  /*
+   * AT+CSCLK=1: the SIM7600 may sleep its UART (and most of itself)
+   * while DTR is high, staying registered with the PDP context and
+   * sockets kept. The manual for this module has no AT+CPSMS / AT+CEDRXS,
+   * and PSM would detach the data context anyway.
+   */
+#if POWER_SAVE_ENABLED && MODEM_DTR_PIN >= 0
+  modemSleepEnabled = atEngine.run("AT+CSCLK=1", NULL, AT_DEFAULT_TIMEOUT_MS) == AtResult::Ok;
+  Serial.printf("⚡ Modem UART sleep (AT+CSCLK=1): %s\n", modemSleepEnabled ? "enabled" : "rejected");
+#endif
+}
+
+bool modemSleepAllowed() {
+  /*
+   * Only once everything a boot needs is done, and never mid-transfer
+   */
+  if (!modemSleepEnabled || !app.ready() || !atEngine.idle()) return false;
+  if (!deviceInfoUploaded || !reportUploadSent || timeSync.syncs == 0) return false;
+  // Still settling the position, for at most GPS_SLEEP_WAIT_MS: no sky view must not pin the modem awake
+  if (gpsTracker.state != GPS_TRACK_STABLE && millis() - gpsSearchStart < GPS_SLEEP_WAIT_MS) return false;
+  if (reportUploadPending || sketchUploadPending || seriesUploadPending || outboxInFlight() != 0) return false;
+  if (configPollDue || configPollPending) return false;
+  if (otaCheckDue || otaState != OTA_IDLE) return false;  // Download or flashing in progress
+  if (closedSketchHour >= 0 || closedSketchDay != TIME_NO_DAY) return false;
+  if (minuteSeries.pending() >= MINUTE_FLUSH_BATCH || outboxPending() > OUTBOX_BATCH) return false;
+  return true;
+}
+
+uint32_t msUntilModemWork() {
+  /*
+   * Time until the next planned use of the modem: the adaptive report
+   * window, the network time resync and (polling mode) the GPS check.
+   * Work that shows up early (a busy cycle, a closed hour) wakes it anyway.
+   */
+  uint32_t now = millis();
+  uint32_t sinceReport = now - lastReportUpload;
+  uint32_t gap = sinceReport >= uploadIntervalMs ? 0 : uploadIntervalMs - sinceReport;
+  
+  uint32_t sinceTime = now - lastTimeRefresh;
+  uint32_t untilTime = sinceTime >= TIME_RESYNC_INTERVAL_MS ? 0 : TIME_RESYNC_INTERVAL_MS - sinceTime;
+  if (untilTime < gap) gap = untilTime;
+  
+#if !GPS_NMEA_STREAMING
+  uint32_t sinceGps = now - lastGpsPoll;
+  uint32_t untilGps = sinceGps >= GPS_STABLE_POLL_MS ? 0 : GPS_STABLE_POLL_MS - sinceGps;
+  if (untilGps < gap) gap = untilGps;
+#endif
+  return gap;
+}
+
+void serviceModemPower() {
+  /*
+   * Uplink task, every turn: put an idle modem to sleep across a long
+   * enough gap, and wake it MODEM_WAKE_LEAD_MS before the planned work
+   * or as soon as unplanned work is waiting
+   */
+#if POWER_SAVE_ENABLED
+  if (modemAwake) {
+    if (!modemSleepAllowed()) return;
+    uint32_t gap = msUntilModemWork();
+    if (gap > MODEM_SLEEP_MIN_MS) modemSleep(gap);
+    return;
+  }
+  
+  if ((int32_t)(millis() - modemWakeAt) >= 0) {
+    modemWake("timer");
+  } else if (closedSketchHour >= 0 || closedSketchDay != TIME_NO_DAY) {
+    modemWake("sketch");
+  } else if (minuteSeries.pending() >= MINUTE_FLUSH_BATCH) {
+    modemWake("series");
+  } else if (outboxPending() > OUTBOX_BATCH) {
+    modemWake("backlog");
+  }
+#endif
+}
+
+void modemSleep(uint32_t gapMs) {
+#if MODEM_DTR_PIN >= 0
+  digitalWrite(MODEM_DTR_PIN, HIGH);
+#endif
+  uint64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&powerMux);
+  modemAwakeUs += now - modemAwakeSinceUs;
+  modemAwake = false;
+  portEXIT_CRITICAL(&powerMux);
+  
+  modemWakeAt = millis() + gapMs - MODEM_WAKE_LEAD_MS;
+  modemSleeps++;
+  powerHold(POWER_HOLD_MODEM, false);
+  Serial.printf("💤 Modem asleep for ~%u s\n", (gapMs - MODEM_WAKE_LEAD_MS) / 1000);
+}
+
+void modemWake(const char* reason) {
+  powerHold(POWER_HOLD_MODEM, true);
+#if MODEM_DTR_PIN >= 0
+  digitalWrite(MODEM_DTR_PIN, LOW);
+#endif
+  portENTER_CRITICAL(&powerMux);
+  modemAwakeSinceUs = esp_timer_get_time();
+  modemAwake = true;
+  portEXIT_CRITICAL(&powerMux);
+  
+  delay(MODEM_WAKE_SETTLE_MS);
+  if (atEngine.run("AT", NULL, AT_DEFAULT_TIMEOUT_MS) != AtResult::Ok) {
+    LOG_WARN("Power: modem did not answer after wake");
+  }
+  Serial.printf("⏰ Modem awake (%s)\n", reason);
+}
+
+void samplePowerCycle(PowerCycle& out) {
+  /*
+   * Awake times and estimated charge since the previous report. Without
+   * light sleep the ESP32 never sleeps, whatever the holds say.
+   */
+  uint64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&powerMux);
+  uint64_t awake = powerAwakeUs + (powerHolds ? now - powerAwakeSinceUs : 0);
+  uint64_t modem = modemAwakeUs + (modemAwake ? now - modemAwakeSinceUs : 0);
+  portEXIT_CRITICAL(&powerMux);
+  
+  uint64_t elapsedUs = now - powerSampleUs;
+  uint64_t awakeUs = lightSleepActive ? awake - powerSampleAwakeUs : elapsedUs;
+  uint64_t modemUs = modem - powerSampleModemUs;
+  powerSampleUs = now;
+  powerSampleAwakeUs = awake;
+  powerSampleModemUs = modem;
+  
+  out.elapsedMs = (uint32_t)(elapsedUs / 1000);
+  out.awakeMs = (uint32_t)(awakeUs / 1000);
+  out.modemAwakeMs = (uint32_t)(modemUs / 1000);
+  float mAms = (float)out.awakeMs * POWER_ESP32_AWAKE_MA + (float)(out.elapsedMs - out.awakeMs) * POWER_ESP32_SLEEP_MA +
+               (float)out.modemAwakeMs * POWER_MODEM_AWAKE_MA +
+               (float)(out.elapsedMs - out.modemAwakeMs) * POWER_MODEM_SLEEP_MA;
+  out.mAh = mAms / 3600000.0f;
+  powerTotalMah += out.mAh;
+}
+
+void restartSystem() {
+  /*
+   * ESP.restart() with buffered SD log lines written out first and the
+   * warm-restart state left in RTC memory
+   */
+  if (!modemAwake) modemWake("restart");
+  flushSketches();
+  flushMinuteSeries();
+  saveWarmState();
+  requestLogFlush(RESTART_LOG_FLUSH_TIMEOUT_MS);
+  ESP.restart();
+}
+
+uint32_t uptimeSeconds() {
+  // From esp_timer (64-bit): monotonic for weeks, unlike millis() / 1000, which wraps after 49.7 days
+  return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+void serviceHeapWatchdog() {
+  /*
+   * Uplink task: sample the heap every HEAP_WATCHDOG_CHECK_MS. A restart
+   * (warm: counters, clock and modem state survive it) happens only once
+   * the largest free block or the free heap has stayed below its floor
+   * for HEAP_WATCHDOG_STRIKES samples in a row.
+   */
+  if (millis() - lastHeapCheck < HEAP_WATCHDOG_CHECK_MS) return;
+  lastHeapCheck = millis();
+  
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largestBlock = ESP.getMaxAllocHeap();
+  bool restart = heapWatchdog.sample(freeHeap, largestBlock);
+  if (heapWatchdog.strikes() == 1) {
+    Serial.printf("⚠️  Heap low: %u B free, largest block %u B\n", freeHeap, largestBlock);
+    LOG_WARN("System: Heap low - %u B free, largest block %u B", freeHeap, largestBlock);
+  }
+  if (!restart) return;
+  
+  Serial.printf("\n🩺 Heap degraded for %u checks (%u B free, largest block %u B) - restarting...\n",
+                heapWatchdog.strikes(), freeHeap, largestBlock);
+  Serial.println("═══════════════════════════════════════════════════════\n");
+  LOG_ERROR("System: Heap watchdog restart - %u B free, largest block %u B", freeHeap, largestBlock);
+  delay(1000);
+  restartSystem();
+}
+
+void logScanToSD(int networksFound, int uniqueCount, int repeatedCount) {
+  /*
+   * Human-readable scan line (debug level; the binary archive is the record of scans)
+   */
+#if SD_LOG_LEVEL >= LOG_LEVEL_DEBUG
+  if (!sdCardAvailable) return;
   
-  logToSD(scanLog);
+  LOG_DEBUG("SCAN #%u: Found=%d, Unique=%d, Repeated=%d", aggregator.totalScans(), networksFound, uniqueCount,
+            repeatedCount);
+#endif
 }
   
\ No newline at end of file
@@ -0,0 +1,52 @@
+/*
+ * AllocCounter - counting global operator new/delete (see AllocCounter.h)
+ */
+
+#include "AllocCounter.h"
+
+#include <stdlib.h>
+
+#include <new>
+
+// Each block carries its size in front, padded to keep the payload aligned
+static const size_t kHeader = 16;
+
+static AllocStats total = {};
+static size_t baseline = 0;
+
+static void* countedAlloc(size_t size) {
+  unsigned char* block = (unsigned char*)malloc(size + kHeader);
+  if (block == NULL) throw std::bad_alloc();
+  *(size_t*)block = size;
+  total.allocations++;
+  total.bytesInUse += size;
+  if (total.bytesInUse > total.peakBytesInUse) total.peakBytesInUse = total.bytesInUse;
+  return block + kHeader;
+}
+
+static void countedFree(void* payload) {
+  if (payload == NULL) return;
+  unsigned char* block = (unsigned char*)payload - kHeader;
+  total.frees++;
+  total.bytesInUse -= *(size_t*)block;
+  free(block);
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* payload) noexcept { countedFree(payload); }
+void operator delete[](void* payload) noexcept { countedFree(payload); }
+
+void allocCounterReset() {
+  total.allocations = 0;
+  total.frees = 0;
+  baseline = total.bytesInUse;
+  total.peakBytesInUse = total.bytesInUse;
+}
+
+AllocStats allocCounterRead() {
+  AllocStats stats = total;
+  stats.bytesInUse -= baseline;
+  stats.peakBytesInUse -= baseline;
+  return stats;
+}
@@ -0,0 +1,25 @@
+/*
+ * AllocCounter - counts heap allocations made through operator new/delete
+ *
+ * Replaces the global allocation operators for the benchmark binary. The
+ * firmware modules under test never call malloc directly, so every heap
+ * use they could introduce (a String, a container, a new) shows up here.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct AllocStats {
+  uint64_t allocations;
+  uint64_t frees;
+  size_t bytesInUse;
+  size_t peakBytesInUse;  // Since the last allocCounterReset()
+};
+
+// Start a measurement window: counts go to zero, the peak to the bytes in use now
+void allocCounterReset();
+
+// Counts since the last reset; bytes are relative to the bytes in use at the reset
+AllocStats allocCounterRead();
@@ -0,0 +1,39 @@
+/*
+ * BenchConfig - synthetic trace and regression thresholds for the native benchmark
+ *
+ * The pipeline sizes come from include/PipelineConfig.h, the header the
+ * firmware itself builds with, so the benchmark measures the structures a
+ * board actually allocates. Those and the thresholds below can be
+ * overridden from build_flags (-D NAME=value) to try a change before it
+ * reaches a board.
+ *
+ * Thresholds are time on the host, not on the ESP32: compare runs on the
+ * same machine. Allocation and memory limits are exact on any host.
+ */
+
+#pragma once
+
+// Pipeline sizing: the firmware's own header, not a copy
+#include "PipelineConfig.h"
+
+// Synthetic trace, used when BENCH_TRACE names no archive file
+#define BENCH_SYNTHETIC_SCANS 17280        // One day at SCAN_INTERVAL_MS
+#define BENCH_SYNTHETIC_PEAK_DEVICES 120   // Detections per scan at the busiest hour
+#define BENCH_CHURN_PERCENT 20             // Share of a cycle's devices replaced in the next cycle
+
+// Regression thresholds
+#ifndef BENCH_MAX_NS_PER_SIGHTING
+#define BENCH_MAX_NS_PER_SIGHTING 150      // Scan task + aggregation work per sighting
+#endif
+#ifndef BENCH_MAX_NS_PER_REPORT_BODY
+#define BENCH_MAX_NS_PER_REPORT_BODY 60000 // One report body: visits, proximity and a full outbox batch
+#endif
+#ifndef BENCH_MAX_ALLOCS_PER_CYCLE
+#define BENCH_MAX_ALLOCS_PER_CYCLE 0       // Heap allocations per SCANS_PER_UPLOAD cycle
+#endif
+#ifndef BENCH_MAX_PEAK_HEAP_BYTES
+#define BENCH_MAX_PEAK_HEAP_BYTES 0        // Heap in use at any point of the replay
+#endif
+#ifndef BENCH_MAX_STATE_BYTES
+#define BENCH_MAX_STATE_BYTES 44000        // Static pipeline state (aggregator, sketches, minute series)
+#endif
@@ -0,0 +1,185 @@
+/*
+ * ScanTrace - archive loading, synthesis and expansion (see ScanTrace.h)
+ */
+
+#include "ScanTrace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "BenchConfig.h"
+#include "CivilTime.h"
+
+#define TRACE_SYNTHETIC_BOOT 0x5EED0001UL
+#define TRACE_ERROR_EVERY 997        // Synthetic scans that fail (found < 0), one in this many
+
+// xorshift32: deterministic, so every run replays the same sightings
+static uint32_t nextRandom(uint32_t& state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+bool scanTraceLoad(const char* path, std::vector<ScanRecord>& records) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) return false;
+
+  ScanFileHeader header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == SCAN_FILE_MAGIC &&
+            header.recordSize >= sizeof(ScanRecord);
+  if (ok) {
+    // Later versions may append fields; the leading ScanRecord layout is fixed
+    std::vector<uint8_t> raw(header.recordSize);
+    while (fread(raw.data(), raw.size(), 1, file) == 1) {
+      ScanRecord record;
+      memcpy(&record, raw.data(), sizeof(record));
+      records.push_back(record);
+    }
+  }
+  fclose(file);
+  return ok;
+}
+
+void scanTraceSynthesize(std::vector<ScanRecord>& records, uint32_t scans, uint32_t peakDevices) {
+  // Detections per scan by UTC hour, percent of the peak
+  static const uint8_t kTraffic[24] = {8,  5,  4,  4,  6,  12, 25, 45, 60, 55, 50, 55,
+                                       65, 60, 55, 60, 75, 90, 100, 95, 80, 60, 35, 15};
+  // Share of a scan's detections per RSSI bin, percent
+  static const uint8_t kRssiShape[SCAN_RSSI_BINS] = {6, 14, 22, 24, 18, 10, 4, 2};
+
+  uint32_t start = (uint32_t)daysFromCivil(2025, 12, 1) * SECONDS_PER_DAY;
+  uint32_t random = 0x2545F491;
+  uint32_t cycleSeen = 0;  // Detections so far in the cycle
+
+  for (uint32_t i = 0; i < scans; i++) {
+    ScanRecord record;
+    memset(&record, 0, sizeof(record));
+    record.uptimeMs = (i + 1) * SCAN_INTERVAL_MS;
+    record.timestamp = start + record.uptimeMs / 1000;
+    record.scanIndex = i + 1;
+    record.saltEpoch = TRACE_SYNTHETIC_BOOT;
+    if (i % SCANS_PER_UPLOAD == 0) cycleSeen = 0;
+
+    if (i % TRACE_ERROR_EVERY == TRACE_ERROR_EVERY - 1) {
+      record.found = -1;
+      records.push_back(record);
+      continue;
+    }
+
+    uint32_t hour = (record.timestamp % SECONDS_PER_DAY) / 3600;
+    int32_t found = (int32_t)(peakDevices * kTraffic[hour] / 100) + (int32_t)(nextRandom(random) % 11) - 5;
+    if (found < 0) found = 0;
+    record.found = (int16_t)found;
+
+    // The first detections of a cycle (cycleSeen) are all first sightings; later scans mostly repeat them
+    uint32_t unique = cycleSeen == 0 ? found : found * BENCH_CHURN_PERCENT / 100;
+    cycleSeen += found;
+    record.unique = (uint16_t)unique;
+    record.repeated = (uint16_t)(found - unique);
+
+    uint32_t assigned = 0;
+    for (size_t bin = 0; bin < SCAN_RSSI_BINS; bin++) {
+      uint32_t count = (bin + 1 == SCAN_RSSI_BINS) ? found - assigned : found * kRssiShape[bin] / 100;
+      if (count > (uint32_t)found - assigned) count = found - assigned;
+      assigned += count;
+      record.rssiHistogram[bin] = count > 0xFF ? 0xFF : (uint8_t)count;
+    }
+    records.push_back(record);
+  }
+}
+
+void scanTraceExpand(const std::vector<ScanRecord>& records, uint32_t scansPerCycle, uint32_t churnPercent,
+                     ScanTrace& trace) {
+  trace.scans.clear();
+  trace.sightings.clear();
+  trace.skipped = 0;
+  trace.boots = 0;
+  trace.cycles = 0;
+  trace.unplaceable = 0;
+
+  uint32_t random = 0x9E3779B9;
+  uint32_t boot = 0;
+  uint32_t lastIndex = 0;
+  bool aligned = false;
+  bool restart = false;
+  uint32_t windowStart = 0;  // Device ids of the cycle: windowStart .. windowStart + seen - 1
+  uint32_t seen = 0;
+
+  for (size_t r = 0; r < records.size(); r++) {
+    const ScanRecord& record = records[r];
+    if (!aligned || record.saltEpoch != boot || record.scanIndex != lastIndex + 1) {
+      aligned = false;
+      boot = record.saltEpoch;
+      lastIndex = record.scanIndex;
+      if ((record.scanIndex - 1) % scansPerCycle != 0) {
+        trace.skipped++;
+        continue;
+      }
+      aligned = true;
+      restart = true;
+      trace.boots++;
+      windowStart += seen;  // Nothing carries over into a new boot
+      seen = 0;
+    }
+    lastIndex = record.scanIndex;
+
+    bool cycleStart = (record.scanIndex - 1) % scansPerCycle == 0;
+    if (cycleStart && !restart) {
+      windowStart += seen * churnPercent / 100;
+      seen = 0;
+    }
+    if ((record.scanIndex % scansPerCycle) == 0) trace.cycles++;
+
+    TraceScan scan;
+    scan.record = record;
+    scan.firstSighting = (uint32_t)trace.sightings.size();
+    scan.sightings = record.found > 0 ? record.unique + record.repeated : 0;
+    scan.bootStart = restart;
+    restart = false;
+
+    // RSSI values from the histogram, bin centres; anything beyond its (saturated) counts at -70
+    uint8_t histogram[SCAN_RSSI_BINS];
+    memcpy(histogram, record.rssiHistogram, sizeof(histogram));
+    size_t bin = 0;
+
+    uint32_t uniqueLeft = scan.sightings ? record.unique : 0;
+    uint32_t repeatedLeft = scan.sightings ? record.repeated : 0;
+    while (uniqueLeft + repeatedLeft > 0) {
+      bool unique = repeatedLeft == 0 || (uniqueLeft > 0 && nextRandom(random) % (uniqueLeft + repeatedLeft) < uniqueLeft);
+
+      uint32_t id;
+      if (unique || seen == 0) {
+        id = windowStart + seen++;
+        if (unique) {
+          uniqueLeft--;
+        } else {
+          // A repeat with nothing to repeat (the archive lost sightings): replays as unique
+          repeatedLeft--;
+          trace.unplaceable++;
+        }
+      } else {
+        id = windowStart + nextRandom(random) % seen;
+        repeatedLeft--;
+      }
+
+      TraceSighting sighting;
+      sighting.mac[0] = 0x02;  // Locally administered, like a randomised phone MAC
+      sighting.mac[1] = 0;
+      sighting.mac[2] = (uint8_t)(id >> 24);
+      sighting.mac[3] = (uint8_t)(id >> 16);
+      sighting.mac[4] = (uint8_t)(id >> 8);
+      sighting.mac[5] = (uint8_t)id;
+      while (bin < SCAN_RSSI_BINS && histogram[bin] == 0) bin++;
+      if (bin < SCAN_RSSI_BINS) {
+        histogram[bin]--;
+        sighting.rssi = (int8_t)(-95 + 10 * (int)bin);
+      } else {
+        sighting.rssi = -70;
+      }
+      sighting.reserved = 0;
+      trace.sightings.push_back(sighting);
+    }
+    trace.scans.push_back(scan);
+  }
+}
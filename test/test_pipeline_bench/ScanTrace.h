@@ -0,0 +1,60 @@
+/*
+ * ScanTrace - scan traces for host replay of the aggregation pipeline
+ *
+ * The source is a sequence of ScanRecords: a day file from the SD card
+ * (/scans/YYYY-MM-DD.bin, see ScanRecord.h) or a synthetic day with a
+ * diurnal traffic curve. The archive keeps counts, not addresses, so each
+ * record is expanded into sightings that reproduce it: `unique` addresses
+ * not yet seen in the cycle and `repeated` ones that were, with RSSIs
+ * drawn from the record's histogram. Between cycles BENCH_CHURN_PERCENT
+ * of the devices are replaced, so the previous-cycle generation, the
+ * visit engine and the sketches see realistic overlap.
+ *
+ * Cycles follow the firmware: SCANS_PER_UPLOAD scans from the first scan
+ * of a boot. Records before the first cycle boundary of a boot (or of a
+ * gap in scanIndex) cannot be placed in a cycle and are skipped.
+ *
+ * Expansion happens up front, so a replay loop only runs firmware code.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "ScanRecord.h"
+
+struct TraceSighting {
+  uint8_t mac[6];
+  int8_t rssi;
+  uint8_t reserved;
+};
+
+struct TraceScan {
+  ScanRecord record;        // As archived (or synthesised)
+  uint32_t firstSighting;   // Index into ScanTrace::sightings
+  uint32_t sightings;       // record.unique + record.repeated
+  bool bootStart;           // The pipeline restarts here (new boot or realigned after a gap)
+};
+
+struct ScanTrace {
+  std::vector<TraceScan> scans;
+  std::vector<TraceSighting> sightings;
+  uint32_t skipped;         // Records outside a complete cycle alignment
+  uint32_t boots;
+  uint32_t cycles;          // Complete cycles in `scans`
+  uint32_t unplaceable;     // Repeats expanded as unique because nothing could be repeated yet
+};
+
+// Append the records of a day file. Returns false if it cannot be read.
+bool scanTraceLoad(const char* path, std::vector<ScanRecord>& records);
+
+// Append `scans` synthetic records starting at 00:00 UTC, peaking at
+// `peakDevices` detections per scan in the evening
+void scanTraceSynthesize(std::vector<ScanRecord>& records, uint32_t scans, uint32_t peakDevices);
+
+// Expand records into sightings that reproduce their unique/repeated counts
+void scanTraceExpand(const std::vector<ScanRecord>& records, uint32_t scansPerCycle, uint32_t churnPercent,
+                     ScanTrace& trace);
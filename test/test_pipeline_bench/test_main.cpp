@@ -0,0 +1,381 @@
+/*
+ * Native replay benchmark of the scan -> aggregation -> upload pipeline
+ *
+ *   pio test -e native -v
+ *   BENCH_TRACE=/path/2025-12-02.bin,/path/2025-12-03.bin pio test -e native -v
+ *
+ * Replays a scan trace (SD day files from BENCH_TRACE, else one synthetic
+ * day) through the firmware's own modules - MacHash, Proximity,
+ * CycleAggregator, HyperLogLog, MinuteSeries - in the order the scan and
+ * aggregation tasks run them, then checks the results against the
+ * archive and the timings, allocations and memory against the
+ * thresholds in BenchConfig.h. Figures are printed with -v.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+
+#include "AllocCounter.h"
+#include "BenchConfig.h"
+#include "CycleAggregator.h"
+#include "GpsParser.h"
+#include "HyperLogLog.h"
+#include "JsonWriter.h"
+#include "MacHash.h"
+#include "MinuteSeries.h"
+#include "Proximity.h"
+#include "RemoteConfig.h"
+#include "ReportJson.h"
+#include "ScanTrace.h"
+#include "TimeService.h"
+
+#define BENCH_TIMED_RUNS 5          // Replays per timing; the fastest counts
+#define BENCH_BODY_ITERATIONS 2000  // Report bodies built per timing
+#define BENCH_PARSE_ITERATIONS 100000
+
+// Firmware state under test, static like on the board
+static CycleAggregator<DEDUP_TABLE_CAPACITY, VISIT_TRACKER_CAPACITY> aggregator(SCANS_PER_UPLOAD, VISIT_GAP_S,
+                                                                               VISIT_LINGER_S, VISIT_WINDOW_S);
+static HyperLogLog<HLL_HOUR_PRECISION> hourSketches[2];
+static HyperLogLog<HLL_DAY_PRECISION> daySketches[2];
+static MinuteSeries<MINUTE_SERIES_CAPACITY> minuteSeries;
+static ProximityTable proximityTable;
+static char uploadJson[UPLOAD_JSON_MAX];
+static JsonWriter uploadBody(uploadJson, sizeof(uploadJson));
+
+static ScanTrace trace;
+static const char* traceSource = "synthetic day";
+
+struct ReplayResult {
+  uint64_t elapsedNs;
+  uint64_t sightings;
+  uint32_t cycles;
+  uint32_t uniqueMismatches;    // Scans whose replayed unique count differs from the record
+  uint32_t repeatedMismatches;
+  uint32_t dedupOverflows;
+  uint64_t impressions;         // Sum over the cycle reports
+  uint32_t totalUnique;         // Last report of the trace
+  AllocStats heap;
+};
+
+static uint64_t nowNs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+__attribute__((format(printf, 1, 2))) static void bench(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  printf("[bench] ");
+  vprintf(format, args);
+  printf("\n");
+  va_end(args);
+}
+
+static uint32_t sketchKeyFor(uint32_t timestamp) {
+  // Same derivation as refreshSketchKey(), on the UTC day
+  if (timestamp == 0) return 0;
+  uint32_t day = timestamp / SECONDS_PER_DAY;
+  return (uint32_t)macHashAvalanche(((uint64_t)HLL_SKETCH_KEY << 32) | day) | 1;
+}
+
+static void replay(ReplayResult& result) {
+  memset(&result, 0, sizeof(result));
+  MinuteBucket drained[MINUTE_FLUSH_BATCH];
+  ScanTotals totals;
+  CycleReport report;
+  memset(&report, 0, sizeof(report));
+
+  allocCounterReset();
+  uint64_t start = nowNs();
+  for (size_t s = 0; s < trace.scans.size(); s++) {
+    const TraceScan& scan = trace.scans[s];
+    const ScanRecord& record = scan.record;
+    if (scan.bootStart) aggregator.clear();
+
+    uint32_t salt = record.saltEpoch;
+    uint32_t sketchKey = sketchKeyFor(record.timestamp);
+    uint32_t nowS = record.uptimeMs / 1000;
+    const TraceSighting* sighting = &trace.sightings[scan.firstSighting];
+
+    for (uint32_t i = 0; i < scan.sightings; i++) {
+      // Scan task: hashes and band, as in processScanResults() / sendScanEvent()
+      uint64_t hash = macHashSalted(sighting[i].mac, salt);
+      uint64_t sketchHash = sketchKey ? macHashSalted(sighting[i].mac, sketchKey) : 0;
+      uint8_t band = proximityClassify(proximityTable, sighting[i].rssi);
+
+      // Aggregation task, as in aggregationTask()
+      aggregator.sighting(hash, sighting[i].rssi, band, nowS);
+      minuteSeries.sighting(hash, sighting[i].rssi);
+      if (sketchHash) {
+        hourSketches[0].add(sketchHash);
+        daySketches[0].add(sketchHash);
+      }
+    }
+
+    bool cycleComplete = aggregator.scanEnded(record.found, nowS, totals);
+    minuteSeries.scanEnded(record.found < 0, record.timestamp / 60);
+    if (cycleComplete) {
+      aggregator.takeReport(report);
+      result.cycles++;
+      result.impressions += report.impressions;
+    }
+
+    // Uplink side of the minute ring
+    while (minuteSeries.pending() >= MINUTE_FLUSH_BATCH) minuteSeries.pop(drained, MINUTE_FLUSH_BATCH);
+
+    if (record.found > 0) {
+      if (totals.unique != record.unique) result.uniqueMismatches++;
+      if (totals.repeated != record.repeated) result.repeatedMismatches++;
+    }
+    result.sightings += scan.sightings;
+  }
+  result.elapsedNs = nowNs() - start;
+  result.heap = allocCounterRead();
+  result.dedupOverflows = aggregator.dedupOverflows();
+  result.totalUnique = report.totalUnique;
+}
+
+static void buildReportBody(const OutboxEntry* batch, const MinuteBucket* buckets, const VisitStats& visits,
+                            const uint32_t (&proximity)[PROXIMITY_BANDS]) {
+  // The shape of buildReportUpdate() plus one series batch: the largest bodies the uplink builds
+  JsonWriter& json = uploadBody;
+  json.reset();
+  json.append("{\"data/%s/last_updated\":\"%s\"", "2025-12-02", "2025-12-02 10:30:45 UTC");
+  reportJsonVisits(json, "2025-12-02", 0x5EED0001, visits);
+  reportJsonProximity(json, "2025-12-02", 0x5EED0001, proximity);
+  for (size_t i = 0; i < OUTBOX_BATCH; i++) reportJsonCycle(json, "cycles/", batch[i], batch[i].timestamp, true);
+  for (size_t i = 0; i < MINUTE_FLUSH_BATCH; i++) reportJsonMinute(json, 0x5EED0001, buckets[i], 5 * 3600);
+  json.append("}");
+}
+
+// ============ TESTS ============
+
+void setUp() {}
+void tearDown() {}
+
+static void test_replay_reproduces_archive() {
+  ReplayResult result;
+  replay(result);
+
+  bench("trace: %s, %u scans (%u skipped), %u boots, %u cycles, %llu sightings", traceSource,
+        (unsigned)trace.scans.size(), trace.skipped, trace.boots, trace.cycles,
+        (unsigned long long)result.sightings);
+  bench("replay: %llu impressions, %u new devices in the last boot, %u dedup overflows, %u unplaceable repeats",
+        (unsigned long long)result.impressions, result.totalUnique, result.dedupOverflows, trace.unplaceable);
+
+  TEST_ASSERT_TRUE_MESSAGE(result.sightings > 0, "trace has no sightings");
+  TEST_ASSERT_EQUAL_UINT32(trace.cycles, result.cycles);
+  if (result.dedupOverflows == 0 && trace.unplaceable == 0) {
+    // Without overflow the dedup verdicts are exact and must match what the archive recorded
+    TEST_ASSERT_EQUAL_UINT32(0, result.uniqueMismatches);
+    TEST_ASSERT_EQUAL_UINT32(0, result.repeatedMismatches);
+  } else {
+    bench("verdicts not compared: %u unique / %u repeated mismatches", result.uniqueMismatches,
+          result.repeatedMismatches);
+  }
+}
+
+static void test_ns_per_sighting() {
+  ReplayResult result;
+  uint64_t best = UINT64_MAX;
+  uint64_t sightings = 0;
+  for (int run = 0; run < BENCH_TIMED_RUNS; run++) {
+    replay(result);
+    if (result.elapsedNs < best) best = result.elapsedNs;
+    sightings = result.sightings;
+  }
+  double perSighting = (double)best / (double)sightings;
+  double perScan = (double)best / (double)trace.scans.size();
+  bench("%.1f ns/sighting, %.0f ns/scan (best of %d, limit %d ns/sighting)", perSighting, perScan, BENCH_TIMED_RUNS,
+        BENCH_MAX_NS_PER_SIGHTING);
+  TEST_ASSERT_TRUE_MESSAGE(perSighting <= BENCH_MAX_NS_PER_SIGHTING, "ns per sighting above BENCH_MAX_NS_PER_SIGHTING");
+}
+
+static void test_heap_per_cycle() {
+  ReplayResult result;
+  replay(result);
+  double perCycle = result.cycles ? (double)result.heap.allocations / result.cycles : 0;
+  bench("heap: %llu allocations (%.2f per cycle, limit %d), peak %u bytes (limit %d)",
+        (unsigned long long)result.heap.allocations, perCycle, BENCH_MAX_ALLOCS_PER_CYCLE,
+        (unsigned)result.heap.peakBytesInUse, BENCH_MAX_PEAK_HEAP_BYTES);
+  TEST_ASSERT_TRUE_MESSAGE(perCycle <= BENCH_MAX_ALLOCS_PER_CYCLE, "allocations per cycle above BENCH_MAX_ALLOCS_PER_CYCLE");
+  TEST_ASSERT_TRUE_MESSAGE(result.heap.peakBytesInUse <= BENCH_MAX_PEAK_HEAP_BYTES,
+                           "peak heap above BENCH_MAX_PEAK_HEAP_BYTES");
+}
+
+static void test_state_footprint() {
+  size_t state = sizeof(aggregator) + sizeof(hourSketches) + sizeof(daySketches) + sizeof(minuteSeries) +
+                 sizeof(proximityTable);
+  bench("state: %u bytes = aggregator %u + hour sketches %u + day sketches %u + minute series %u + proximity %u "
+        "(limit %d)",
+        (unsigned)state, (unsigned)sizeof(aggregator), (unsigned)sizeof(hourSketches), (unsigned)sizeof(daySketches),
+        (unsigned)sizeof(minuteSeries), (unsigned)sizeof(proximityTable), BENCH_MAX_STATE_BYTES);
+  TEST_ASSERT_TRUE_MESSAGE(state <= BENCH_MAX_STATE_BYTES, "pipeline state above BENCH_MAX_STATE_BYTES");
+}
+
+static void test_report_body() {
+  static OutboxEntry batch[OUTBOX_BATCH];
+  static MinuteBucket buckets[MINUTE_FLUSH_BATCH];
+  VisitStats visits;
+  memset(&visits, 0xAB, sizeof(visits));  // Wide values: the longest text
+  uint32_t proximity[PROXIMITY_BANDS] = {123456, 654321, 999999};
+  for (size_t i = 0; i < OUTBOX_BATCH; i++) {
+    OutboxEntry& e = batch[i];
+    e.timestamp = 1764653445 + i * 50;
+    e.uptimeMs = 0;
+    e.bootId = 0x5EED0001;
+    e.cycle = 100000 + i;
+    e.impressions = e.networks = 65535;
+    e.unique = e.repeated = 32767;
+  }
+  for (size_t i = 0; i < MINUTE_FLUSH_BATCH; i++) {
+    memset(&buckets[i], 0xFF, sizeof(buckets[i]));
+    buckets[i].minute = 1764653445 / 60 + i;
+  }
+
+  buildReportBody(batch, buckets, visits, proximity);
+  TEST_ASSERT_TRUE_MESSAGE(uploadBody.ok(), "worst-case report body exceeds UPLOAD_JSON_MAX");
+  size_t length = uploadBody.length();
+
+  allocCounterReset();
+  uint64_t start = nowNs();
+  for (int i = 0; i < BENCH_BODY_ITERATIONS; i++) buildReportBody(batch, buckets, visits, proximity);
+  double perBody = (double)(nowNs() - start) / BENCH_BODY_ITERATIONS;
+  AllocStats heap = allocCounterRead();
+
+  bench("report body: %u of %u bytes, %.0f ns, %llu allocations (limit %d ns)", (unsigned)length,
+        (unsigned)UPLOAD_JSON_MAX, perBody, (unsigned long long)heap.allocations, BENCH_MAX_NS_PER_REPORT_BODY);
+  TEST_ASSERT_EQUAL_UINT64(0, heap.allocations);
+  TEST_ASSERT_TRUE_MESSAGE(perBody <= BENCH_MAX_NS_PER_REPORT_BODY, "report body above BENCH_MAX_NS_PER_REPORT_BODY");
+}
+
+static void test_parsers() {
+  static const char* kCgpsInfo = "+CGPSINFO: 3336.657000,N,07303.679980,E,021225,103045.0,512.3,0.0,";
+  static const char* kGga = "$GPGGA,103045.00,3336.65700,N,07303.67998,E,1,08,0.9,512.3,M,-39.0,M,,*43";
+  static const char* kRmc = "$GPRMC,103045.00,A,3336.65700,N,07303.67998,E,0.0,0.0,021225,,,A*54";
+  static const char* kCclk = "+CCLK: \"25/12/02,10:30:45+20\"";
+
+  GpsFix fix;
+  memset(&fix, 0, sizeof(fix));
+  TEST_ASSERT_TRUE(parseCgpsInfo(kCgpsInfo, fix));
+  TEST_ASSERT_EQUAL_INT32(336109500, fix.latE7);
+  TEST_ASSERT_EQUAL_INT32(730613330, fix.lonE7);
+  memset(&fix, 0, sizeof(fix));
+  TEST_ASSERT_TRUE(parseNmea(kGga, fix));
+  TEST_ASSERT_EQUAL_UINT8(8, fix.satellites);
+  TEST_ASSERT_TRUE(parseNmea(kRmc, fix));
+  TEST_ASSERT_EQUAL_UINT16(2025, fix.year);
+  uint32_t epoch = 0;
+  int16_t tz = 0;
+  TEST_ASSERT_TRUE(parseCclk(kCclk, &epoch, &tz));
+  TEST_ASSERT_EQUAL_UINT32(1764653445, epoch);  // 10:30:45 at UTC+5
+  TEST_ASSERT_EQUAL_INT16(20, tz);
+
+  const char* lines[] = {kCgpsInfo, kGga, kRmc, kCclk};
+  const char* names[] = {"CGPSINFO", "GGA", "RMC", "CCLK"};
+  for (size_t l = 0; l < 4; l++) {
+    allocCounterReset();
+    uint64_t start = nowNs();
+    bool valid = true;
+    for (int i = 0; i < BENCH_PARSE_ITERATIONS; i++) {
+      if (l == 0) valid &= parseCgpsInfo(lines[l], fix);
+      if (l == 1 || l == 2) valid &= parseNmea(lines[l], fix);
+      if (l == 3) valid &= parseCclk(lines[l], &epoch, &tz);
+    }
+    double perLine = (double)(nowNs() - start) / BENCH_PARSE_ITERATIONS;
+    AllocStats heap = allocCounterRead();
+    bench("%s: %.0f ns/line, %llu allocations", names[l], perLine, (unsigned long long)heap.allocations);
+    TEST_ASSERT_TRUE(valid);
+    TEST_ASSERT_EQUAL_UINT64(0, heap.allocations);
+  }
+}
+
+static void test_remote_config() {
+  // What the device runs with: an NVS calibration and profiling toggled off
+  // over serial, neither equal to the compile-time values
+  RuntimeConfig current = {SCAN_INTERVAL_MS, SCANS_PER_UPLOAD, 900, 0, {-45, 30, 20, 60}, false};
+  RuntimeConfig next;
+
+  // A member absent or null keeps the value in use, not the default
+  RemoteConfigResult result = remoteConfigParse("{\"scan_interval_ms\":6000,\"rssi_1m\":null}", current, next);
+  TEST_ASSERT_TRUE(result.valid);
+  TEST_ASSERT_EQUAL_UINT16(CONFIG_SCAN_INTERVAL, result.changed);
+  TEST_ASSERT_EQUAL_UINT32(6000, next.scanIntervalMs);
+  TEST_ASSERT_EQUAL_INT8(-45, next.proximity.rssiAt1m);
+  TEST_ASSERT_EQUAL_UINT16(60, next.proximity.nearbyM);
+  TEST_ASSERT_FALSE(next.profiling);
+
+  // No node at all changes nothing
+  result = remoteConfigParse("null", current, next);
+  TEST_ASSERT_TRUE(result.valid);
+  TEST_ASSERT_EQUAL_UINT16(0, result.changed);
+
+  // An explicit value wins, one out of range is rejected and kept
+  result = remoteConfigParse("{\"profiling\":true,\"scans_per_upload\":0}", current, next);
+  TEST_ASSERT_EQUAL_UINT16(CONFIG_PROFILING, result.changed);
+  TEST_ASSERT_EQUAL_UINT8(1, result.rejected);
+  TEST_ASSERT_EQUAL_UINT32(SCANS_PER_UPLOAD, next.scansPerUpload);
+
+  // Not an object: `next` is current
+  result = remoteConfigParse("[1]", current, next);
+  TEST_ASSERT_FALSE(result.valid);
+  TEST_ASSERT_EQUAL_UINT16(0, remoteConfigDiff(current, next));
+}
+
+// ============ TRACE ============
+
+static void loadTrace() {
+  std::vector<ScanRecord> records;
+  const char* paths = getenv("BENCH_TRACE");
+  static std::string loaded;
+
+  if (paths != NULL && paths[0] != '\0') {
+    std::string list(paths);
+    size_t begin = 0;
+    while (begin <= list.size()) {
+      size_t end = list.find(',', begin);
+      if (end == std::string::npos) end = list.size();
+      std::string path = list.substr(begin, end - begin);
+      if (!path.empty()) {
+        if (scanTraceLoad(path.c_str(), records)) {
+          loaded += (loaded.empty() ? "" : ", ") + path;
+        } else {
+          bench("cannot read %s - skipped", path.c_str());
+        }
+      }
+      begin = end + 1;
+    }
+  }
+
+  if (records.empty()) {
+    scanTraceSynthesize(records, BENCH_SYNTHETIC_SCANS, BENCH_SYNTHETIC_PEAK_DEVICES);
+  } else {
+    traceSource = loaded.c_str();
+  }
+  scanTraceExpand(records, SCANS_PER_UPLOAD, BENCH_CHURN_PERCENT, trace);
+}
+
+int main() {
+  ProximityCalibration calibration = {PROXIMITY_RSSI_AT_1M, PROXIMITY_PATH_LOSS_X10, PROXIMITY_VIEWING_M,
+                                      PROXIMITY_NEARBY_M};
+  proximityTableBuild(proximityTable, calibration);
+  loadTrace();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_replay_reproduces_archive);
+  RUN_TEST(test_ns_per_sighting);
+  RUN_TEST(test_heap_per_cycle);
+  RUN_TEST(test_state_footprint);
+  RUN_TEST(test_report_body);
+  RUN_TEST(test_parsers);
+  RUN_TEST(test_remote_config);
+  return UNITY_END();
+}
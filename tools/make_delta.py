@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""
+make_delta.py - build a delta OTA patch (TDP1, see include/DeltaPatch.h)
+
+    python3 tools/make_delta.py OLD.bin NEW.bin OUT.tdp [--version NEW_VERSION --path STORAGE_PATH]
+
+OLD.bin must be byte for byte the image the devices run (.pio/build/esp32dev/
+firmware.bin of that release), NEW.bin the image to install. The patch is
+applied back in memory and checked against NEW.bin before it is written.
+With --version and --path the manifest to store under /firmware/updates/
+<running version> is printed as well (see README, "Firmware Updates").
+"""
+
+import argparse
+import hashlib
+import json
+import struct
+import sys
+
+MAGIC = b"TDP1"
+OP_END, OP_COPY, OP_INSERT = 0, 1, 2
+KEY = 8          # Bytes hashed per index entry
+STRIDE = 4       # Source positions indexed (every STRIDE-th)
+CANDIDATES = 8   # Source positions kept per key
+MIN_RUN = 4      # Shortest copy that continues at the source cursor
+MIN_MATCH = 12   # Shortest copy from anywhere else (costs an offset)
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return value * 2 if value >= 0 else -value * 2 - 1
+
+
+def match_length(source, s, target, t):
+    length = 0
+    limit = min(len(source) - s, len(target) - t)
+    while length + 64 <= limit and source[s + length:s + length + 64] == target[t + length:t + length + 64]:
+        length += 64
+    while length < limit and source[s + length] == target[t + length]:
+        length += 1
+    return length
+
+
+def build(source, target):
+    index = {}
+    for s in range(0, len(source) - KEY + 1, STRIDE):
+        bucket = index.setdefault(source[s:s + KEY], [])
+        if len(bucket) < CANDIDATES:
+            bucket.append(s)
+
+    ops = bytearray()
+    literal = bytearray()
+    cursor = 0
+    t = 0
+
+    def flush_literal():
+        if literal:
+            ops.append(OP_INSERT)
+            ops.extend(varint(len(literal)))
+            ops.extend(literal)
+            del literal[:]
+
+    while t < len(target):
+        best_source, best_length = cursor, 0
+        if cursor < len(source):
+            best_length = match_length(source, cursor, target, t)
+            if best_length < MIN_RUN:
+                best_length = 0
+        for s in index.get(target[t:t + KEY], ()):
+            length = match_length(source, s, target, t)
+            if length >= MIN_MATCH and length > best_length:
+                best_source, best_length = s, length
+
+        if best_length == 0:
+            literal.append(target[t])
+            t += 1
+            continue
+
+        flush_literal()
+        ops.append(OP_COPY)
+        ops.extend(varint(zigzag(best_source - cursor)))
+        ops.extend(varint(best_length))
+        cursor = best_source + best_length
+        t += best_length
+
+    flush_literal()
+    ops.append(OP_END)
+
+    header = MAGIC + struct.pack("<I", len(source)) + hashlib.sha256(source).digest() + \
+        struct.pack("<I", len(target)) + hashlib.sha256(target).digest()
+    return header + bytes(ops)
+
+
+def read_varint(patch, p):
+    value, shift = 0, 0
+    while True:
+        byte = patch[p]
+        p += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, p
+
+
+def apply(source, patch):
+    p = 76
+    cursor = 0
+    out = bytearray()
+    while True:
+        op = patch[p]
+        p += 1
+        if op == OP_END:
+            return bytes(out)
+        if op == OP_COPY:
+            offset, p = read_varint(patch, p)
+            length, p = read_varint(patch, p)
+            cursor += offset >> 1 if not offset & 1 else -(offset >> 1) - 1
+            out.extend(source[cursor:cursor + length])
+            cursor += length
+        else:
+            length, p = read_varint(patch, p)
+            out.extend(patch[p:p + length])
+            p += length
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build a TDP1 delta OTA patch")
+    parser.add_argument("old")
+    parser.add_argument("new")
+    parser.add_argument("out")
+    parser.add_argument("--version", help="FIRMWARE_VERSION of NEW.bin (prints the manifest)")
+    parser.add_argument("--path", help="Storage object path the patch is uploaded to")
+    args = parser.parse_args()
+
+    with open(args.old, "rb") as f:
+        source = f.read()
+    with open(args.new, "rb") as f:
+        target = f.read()
+
+    patch = build(source, target)
+    if apply(source, patch) != target:
+        sys.exit("patch does not reproduce NEW.bin")
+    with open(args.out, "wb") as f:
+        f.write(patch)
+
+    print("%s: %u -> %u bytes, patch %u bytes (%.1f%%)" %
+          (args.out, len(source), len(target), len(patch), 100.0 * len(patch) / len(target)))
+    if args.version and args.path:
+        print(json.dumps({"version": args.version, "path": args.path, "size": len(patch),
+                          "sha256": hashlib.sha256(target).hexdigest()}))
+
+
+if __name__ == "__main__":
+    main()